@@ -0,0 +1,263 @@
+// Microbenchmarks of the per-message CPU work: RPC request encoding, response decoding, event
+// parsing/decoding and the full event dispatch path, on recorded frames from bench/fixtures.
+// Every benchmark reports ns/op and allocs/op (global operator new calls per iteration);
+// BM_EventDispatch, one 10k-frame replay per iteration, reports allocs/frame instead.
+#include "EventListener.h"
+#include "EventLog.h"
+#include "Miracast.h"
+#include "MiracastEvents.h"
+#include "RpcMethods.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <unistd.h>
+
+#ifndef MCAST_BENCH_FIXTURES
+#define MCAST_BENCH_FIXTURES "bench/fixtures"
+#endif
+
+static std::atomic<uint64_t> allocations(0);
+
+// counting replacements of the global allocation functions (malloc/free pairing is intended)
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(std::size_t n) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t n) { return operator new(n); }
+void *operator new(std::size_t n, const std::nothrow_t&) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+void *operator new[](std::size_t n, const std::nothrow_t &t) noexcept { return operator new(n, t); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, std::size_t) noexcept { operator delete(p); }
+
+// allocations made while a benchmark loop runs, by any thread, reported per iteration or, when an
+// iteration handles several items, per item under their own name
+class AllocCounter {
+public:
+    explicit AllocCounter(benchmark::State &s, const char *name = "allocs/op", int itemsPerIteration = 1)
+        : state(s), counter(name), items(itemsPerIteration), start(allocations.load()) {}
+    ~AllocCounter() {
+        state.counters[counter] = benchmark::Counter((double)(allocations.load() - start) / items, benchmark::Counter::kAvgIterations);
+    }
+private:
+    benchmark::State &state;
+    const char *counter;
+    int items;
+    uint64_t start;
+};
+
+static std::string fixture(const char *name) {
+    std::string path = std::string(MCAST_BENCH_FIXTURES) + "/" + name + ".json";
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "missing fixture " << path << "\n";
+        std::exit(1);
+    }
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+static Json::Value parse(const std::string &s) {
+    Json::Value v;
+    decode_rpc_response(s, v);
+    return v;
+}
+
+static DeviceParameters sample_device() {
+    DeviceParameters d;
+    d.source_dev_ip = "192.168.49.165";
+    d.source_dev_mac = "96:52:44:b6:7d:14";
+    d.source_dev_name = "Galaxy S22 Ultra";
+    d.sink_dev_ip = "192.168.49.1";
+    return d;
+}
+
+/* requests */
+
+static void BM_EncodePlayRequest(benchmark::State &state) {
+    DeviceParameters dev = sample_device();
+    VideoRectangle rect{0, 0, 1920, 1080};
+    AllocCounter allocs(state);
+    int id = 1;
+    for (auto _ : state) {
+        std::string body = encode_rpc_request(id++, "org.rdk.MiracastPlayer.playRequest", play_request_params(dev, rect));
+        benchmark::DoNotOptimize(body);
+    }
+}
+BENCHMARK(BM_EncodePlayRequest);
+
+static void BM_EncodeUpdatePlayerState(benchmark::State &state) {
+    AllocCounter allocs(state);
+    int id = 1;
+    for (auto _ : state) {
+        std::string body = encode_rpc_request(id++, "org.rdk.MiracastService.updatePlayerState",
+                                              player_state_params("96:52:44:b6:7d:14", "PLAYING", 200, "SUCCESS"));
+        benchmark::DoNotOptimize(body);
+    }
+}
+BENCHMARK(BM_EncodeUpdatePlayerState);
+
+// the same requests through the typed descriptors, written into a reused buffer (as rpc_call does)
+static void BM_EncodePlayRequestTyped(benchmark::State &state) {
+    PlayRequestParams params{sample_device(), VideoRectangle{0, 0, 1920, 1080}};
+    std::string body;
+    AllocCounter allocs(state);
+    int id = 1;
+    for (auto _ : state) {
+        rpc_encode(body, id++, kPlayRequest, params);
+        benchmark::DoNotOptimize(body);
+    }
+}
+BENCHMARK(BM_EncodePlayRequestTyped);
+
+static void BM_EncodeUpdatePlayerStateTyped(benchmark::State &state) {
+    std::string body;
+    AllocCounter allocs(state);
+    int id = 1;
+    for (auto _ : state) {
+        rpc_encode(body, id++, kUpdatePlayerState, PlayerStateParams{"96:52:44:b6:7d:14", "PLAYING", 200, "SUCCESS"});
+        benchmark::DoNotOptimize(body);
+    }
+}
+BENCHMARK(BM_EncodeUpdatePlayerStateTyped);
+
+/* responses */
+
+static void BM_DecodeResponse(benchmark::State &state, const char *name) {
+    std::string body = fixture(name);
+    AllocCounter allocs(state);
+    for (auto _ : state) {
+        Json::Value v;
+        benchmark::DoNotOptimize(decode_rpc_response(body, v));
+    }
+    state.SetBytesProcessed((int64_t)(state.iterations() * body.size()));
+}
+BENCHMARK_CAPTURE(BM_DecodeResponse, set_enable, "response_set_enable");
+BENCHMARK_CAPTURE(BM_DecodeResponse, get_enable, "response_get_enable");
+BENCHMARK_CAPTURE(BM_DecodeResponse, error, "response_error");
+
+template <typename R>
+static void decode_typed(benchmark::State &state, const char *name) {
+    std::string body = fixture(name);
+    AllocCounter allocs(state);
+    for (auto _ : state) {
+        R result;
+        RpcError error;
+        benchmark::DoNotOptimize(rpc_decode(body, result, error));
+    }
+    state.SetBytesProcessed((int64_t)(state.iterations() * body.size()));
+}
+static void BM_DecodeSetEnableTyped(benchmark::State &s) { decode_typed<RpcNone>(s, "response_set_enable"); }
+static void BM_DecodeGetEnableTyped(benchmark::State &s) { decode_typed<EnableResult>(s, "response_get_enable"); }
+static void BM_DecodeErrorTyped(benchmark::State &s) { decode_typed<RpcNone>(s, "response_error"); }
+BENCHMARK(BM_DecodeSetEnableTyped);
+BENCHMARK(BM_DecodeGetEnableTyped);
+BENCHMARK(BM_DecodeErrorTyped);
+
+/* events: parse a frame with a reused reader (as a dispatch worker does), then the typed decode */
+
+template <typename Event>
+static void parse_event(benchmark::State &state, const char *name) {
+    std::string frame = fixture(name);
+    Json::CharReaderBuilder b;
+    std::unique_ptr<Json::CharReader> reader(b.newCharReader());
+    std::string errs;
+    AllocCounter allocs(state);
+    for (auto _ : state) {
+        Json::Value j;
+        reader->parse(frame.data(), frame.data() + frame.size(), &j, &errs);
+        Event ev;
+        benchmark::DoNotOptimize(decode_event(j["params"], ev));
+    }
+    state.SetBytesProcessed((int64_t)(state.iterations() * frame.size()));
+}
+static void BM_ParseClientConnectionRequest(benchmark::State &s) { parse_event<ClientConnectionRequest>(s, "client_connection_request"); }
+static void BM_ParseLaunchRequest(benchmark::State &s) { parse_event<LaunchRequest>(s, "launch_request"); }
+static void BM_ParseStateChange(benchmark::State &s) { parse_event<PlayerStateChange>(s, "state_change_playing"); }
+BENCHMARK(BM_ParseClientConnectionRequest);
+BENCHMARK(BM_ParseLaunchRequest);
+BENCHMARK(BM_ParseStateChange);
+
+// typed decode alone, from already parsed params (field lookup replaced the old find_mac_name scan)
+template <typename Event>
+static void decode_only(benchmark::State &state, const char *name) {
+    Json::Value params = parse(fixture(name))["params"];
+    AllocCounter allocs(state);
+    for (auto _ : state) {
+        Event ev;
+        benchmark::DoNotOptimize(decode_event(params, ev));
+    }
+}
+static void BM_DecodeClientConnectionRequest(benchmark::State &s) { decode_only<ClientConnectionRequest>(s, "client_connection_request"); }
+static void BM_DecodeLaunchRequest(benchmark::State &s) { decode_only<LaunchRequest>(s, "launch_request"); }
+static void BM_DecodeStateChange(benchmark::State &s) { decode_only<PlayerStateChange>(s, "state_change_playing"); }
+BENCHMARK(BM_DecodeClientConnectionRequest);
+BENCHMARK(BM_DecodeLaunchRequest);
+BENCHMARK(BM_DecodeStateChange);
+
+static void BM_HttpToWs(benchmark::State &state) {
+    std::string url = "http://127.0.0.1:9998/jsonrpc";
+    AllocCounter allocs(state);
+    for (auto _ : state) benchmark::DoNotOptimize(http_to_ws(url));
+}
+BENCHMARK(BM_HttpToWs);
+
+/* whole dispatch path: queue -> worker -> method peek -> parse -> typed handler, via replay */
+
+static void BM_EventDispatch(benchmark::State &state) {
+    const int frames = 10000;
+    char path[] = "/tmp/mcastbench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) { state.SkipWithError("mkstemp failed"); return; }
+    close(fd);
+    unlink(path);
+    {
+        // the recorded mix: mostly player state changes, some unhandled controller events
+        const char *names[] = {"client_connection_request", "launch_request", "state_change_playing",
+                               "state_change_playing", "controller_statechange"};
+        std::string mix[5];
+        for (int i = 0; i < 5; ++i) mix[i] = fixture(names[i]);
+        EventLogWriter w;
+        std::string error;
+        if (!w.open(path, error)) { state.SkipWithError(error.c_str()); return; }
+        for (int i = 0; i < frames; ++i) w.append((uint64_t)i, mix[i % 5].data(), mix[i % 5].size());
+    }
+    EventListener listener("ws://127.0.0.1:9/jsonrpc");
+    DispatchOptions opts;
+    opts.overflow = DispatchOptions::Overflow::Block;
+    listener.setDispatchOptions(opts);
+    std::atomic<uint64_t> handled(0);
+    on_client_connection_request(listener, [&](const ClientConnectionRequest&){ ++handled; });
+    on_launch_request(listener, [&](const LaunchRequest&){ ++handled; });
+    on_player_state_change(listener, [&](const PlayerStateChange&){ ++handled; });
+
+    AllocCounter allocs(state, "allocs/frame", frames);
+    for (auto _ : state) {
+        ReplayStats st;
+        std::string error;
+        if (!listener.replay(path, 0, st, error)) { state.SkipWithError(error.c_str()); break; }
+    }
+    unlink(path);
+    state.SetItemsProcessed(state.iterations() * frames);
+    state.counters["handled/op"] = benchmark::Counter((double)handled.load(), benchmark::Counter::kAvgIterations);
+}
+// the work happens on the dispatch worker: measure wall time, not this thread's CPU time
+BENCHMARK(BM_EventDispatch)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,399 @@
+// mockthunder - local stand-in for a Thunder controller running MiracastService / MiracastPlayer.
+// Answers JSON-RPC over HTTP POST and WebSocket on the same port (like Thunder) and emits synthetic
+// Miracast events so mcasttester can be exercised and benchmarked without a device.
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+#include <json/json.h>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+typedef websocketpp::server<websocketpp::config::asio> ws_server;
+
+struct MockOptions {
+    uint16_t port = 9998;
+    long latencyMs = 0;            // injected delay before every RPC reply
+    long jitterMs = 0;             // +/- random jitter added to latencyMs
+    long requestIntervalMs = 0;    // period of onClientConnectionRequest (0 = off)
+    long launchDelayMs = 50;       // acceptClientConnection("Accept") -> onLaunchRequest
+    long playDelayMs = 100;        // playRequest -> onStateChange PLAYING
+    double stateEventRate = 0;     // extra onStateChange events per second (burst load)
+};
+
+static const char *kService = "org.rdk.MiracastService";
+static const char *kPlayer = "org.rdk.MiracastPlayer";
+
+static std::string jsonToString(const Json::Value &v) {
+    Json::StreamWriterBuilder w;
+    w["indentation"] = "";
+    return Json::writeString(w, v);
+}
+
+static bool parseJson(const std::string &s, Json::Value &out) {
+    Json::CharReaderBuilder b;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(b.newCharReader());
+    return reader->parse(s.c_str(), s.c_str() + s.size(), &out, &errs);
+}
+
+// split "org.rdk.MiracastService.1.setEnable" into callsign and method (version dropped)
+static void split_method(const std::string &full, std::string &callsign, std::string &method) {
+    auto dot = full.rfind('.');
+    if (dot == std::string::npos) { callsign.clear(); method = full; return; }
+    method = full.substr(dot + 1);
+    callsign = full.substr(0, dot);
+    auto vdot = callsign.rfind('.');
+    if (vdot != std::string::npos && vdot + 1 < callsign.size() &&
+        callsign.find_first_not_of("0123456789", vdot + 1) == std::string::npos) {
+        callsign = callsign.substr(0, vdot);
+    }
+}
+
+class MockThunder {
+public:
+    explicit MockThunder(const MockOptions &o): opts(o), rng(std::random_device{}()) {
+        server.clear_access_channels(websocketpp::log::alevel::all);
+        server.clear_error_channels(websocketpp::log::elevel::all);
+        server.init_asio();
+        server.set_reuse_addr(true);
+        server.set_open_handler([this](websocketpp::connection_hdl h){ clients[h]; });
+        server.set_close_handler([this](websocketpp::connection_hdl h){ clients.erase(h); });
+        server.set_message_handler([this](websocketpp::connection_hdl h, ws_server::message_ptr msg){
+            on_ws_message(h, msg->get_payload());
+        });
+        server.set_http_handler([this](websocketpp::connection_hdl h){ on_http(h); });
+    }
+
+    bool run() {
+        websocketpp::lib::error_code ec;
+        server.listen(opts.port, ec);
+        if (!ec) server.start_accept(ec);
+        if (ec) {
+            std::cerr << "[mockthunder] listen on port " << opts.port << " failed: " << ec.message() << "\n";
+            return false;
+        }
+        boost::asio::signal_set signals(server.get_io_service(), SIGINT, SIGTERM);
+        signals.async_wait([this](const boost::system::error_code&, int){ shutdown(); });
+
+        if (opts.requestIntervalMs > 0) schedule_connection_request();
+        if (opts.stateEventRate > 0) schedule_state_event();
+
+        std::cout << "[mockthunder] listening on port " << opts.port << " (HTTP + WebSocket /jsonrpc)\n";
+        server.run();
+        std::cout << "[mockthunder] requests=" << requestsServed << " events=" << eventsSent << "\n";
+        return true;
+    }
+
+private:
+    // per WebSocket connection: "callsign.event" -> designator given in register
+    typedef std::map<std::string, std::string> Subscriptions;
+    struct Session {
+        std::string name;
+        bool accepted = false;
+    };
+
+    MockOptions opts;
+    ws_server server;
+    std::map<websocketpp::connection_hdl, Subscriptions, std::owner_less<websocketpp::connection_hdl>> clients;
+    std::map<std::string, Session> sessions;  // by source MAC
+    std::string pendingMac;                   // last connection request not yet answered
+    std::mt19937 rng;
+    bool serviceActive = false;
+    bool playerActive = false;
+    bool enabled = false;
+    unsigned sessionSeq = 0;
+    unsigned long requestsServed = 0;
+    unsigned long eventsSent = 0;
+    bool stopping = false;
+
+    void shutdown() {
+        stopping = true;
+        websocketpp::lib::error_code ec;
+        server.stop_listening(ec);
+        for (auto &c : clients) server.close(c.first, websocketpp::close::status::going_away, "shutdown", ec);
+        server.stop();
+    }
+
+    long reply_delay() {
+        if (opts.jitterMs <= 0) return opts.latencyMs;
+        std::uniform_int_distribution<long> d(-opts.jitterMs, opts.jitterMs);
+        return std::max(0L, opts.latencyMs + d(rng));
+    }
+
+    // run f now or after the injected latency
+    void after(long ms, std::function<void()> f) {
+        if (ms <= 0) { f(); return; }
+        server.set_timer(ms, [f](const websocketpp::lib::error_code &ec){ if (!ec) f(); });
+    }
+
+    /* events */
+
+    void emit(const std::string &callsign, const std::string &event, const Json::Value &params) {
+        std::string key = callsign + "." + event;
+        for (auto &c : clients) {
+            // clients that never registered get every event under the callsign as designator
+            std::string designator = callsign;
+            if (!c.second.empty()) {
+                auto it = c.second.find(key);
+                if (it == c.second.end()) continue;
+                designator = it->second;
+            }
+            Json::Value n;
+            n["jsonrpc"] = "2.0";
+            n["method"] = designator + "." + event;
+            n["params"] = params;
+            websocketpp::lib::error_code ec;
+            server.send(c.first, jsonToString(n), websocketpp::frame::opcode::text, ec);
+            if (!ec) ++eventsSent;
+        }
+    }
+
+    void emit_player_state(const std::string &mac, const std::string &name, const std::string &state, int reasonCode) {
+        Json::Value p;
+        p["name"] = name;
+        p["mac"] = mac;
+        p["state"] = state;
+        p["reason_code"] = reasonCode;
+        p["reason"] = reasonCode == 0 ? "SUCCESS" : "PLAYER_STOPPED";
+        emit(kPlayer, "onStateChange", p);
+    }
+
+    void schedule_connection_request() {
+        server.set_timer(opts.requestIntervalMs, [this](const websocketpp::lib::error_code &ec){
+            if (ec || stopping) return;
+            if (enabled) {
+                char mac[18];
+                unsigned n = ++sessionSeq;
+                snprintf(mac, sizeof(mac), "02:00:00:%02x:%02x:%02x", (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff);
+                if (!pendingMac.empty()) sessions.erase(pendingMac);  // previous request never answered
+                Session s;
+                s.name = "MockSource-" + std::to_string(n);
+                sessions[mac] = s;
+                pendingMac = mac;
+                Json::Value p;
+                p["mac"] = mac;
+                p["name"] = s.name;
+                emit(kService, "onClientConnectionRequest", p);
+            }
+            schedule_connection_request();
+        });
+    }
+
+    void schedule_state_event() {
+        std::exponential_distribution<double> d(opts.stateEventRate);
+        long us = std::max(1L, (long)(d(rng) * 1e6));
+        auto timer = std::make_shared<boost::asio::steady_timer>(server.get_io_service(), std::chrono::microseconds(us));
+        timer->async_wait([this, timer](const boost::system::error_code &ec){
+            if (ec || stopping) return;
+            emit_player_state("02:00:00:ff:ff:ff", "MockNoise", "INPROGRESS", 0);
+            schedule_state_event();
+        });
+    }
+
+    /* RPC handling */
+
+    Json::Value error_reply(const Json::Value &id, int code, const std::string &message) {
+        Json::Value r;
+        r["jsonrpc"] = "2.0";
+        r["id"] = id;
+        r["error"]["code"] = code;
+        r["error"]["message"] = message;
+        return r;
+    }
+
+    bool is_active(const std::string &callsign) const {
+        return callsign == kService ? serviceActive : playerActive;
+    }
+
+    Json::Value success() {
+        Json::Value r;
+        r["success"] = true;
+        return r;
+    }
+
+    // handle one request object; returns the response (null for notifications)
+    Json::Value handle(const Json::Value &req, Subscriptions *subs) {
+        ++requestsServed;
+        if (!req.isObject() || !req["method"].isString()) return error_reply(Json::Value(), -32600, "Invalid Request");
+        const Json::Value &id = req["id"];
+        const Json::Value &params = req["params"];
+        std::string callsign, method;
+        split_method(req["method"].asString(), callsign, method);
+
+        Json::Value result;
+        bool known = callsign == "Controller" || callsign == kService || callsign == kPlayer;
+        if (known && (method == "register" || method == "unregister")) {
+            if (callsign != "Controller" && !is_active(callsign)) return error_reply(id, 2, "Service is not active");
+            if (!subs) return error_reply(id, -32601, "Events need a WebSocket");
+            std::string key = callsign + "." + params["event"].asString();
+            if (method == "register") (*subs)[key] = params["id"].asString();
+            else subs->erase(key);
+            result = 0;
+        } else if (callsign == "Controller" && (method == "activate" || method == "deactivate")) {
+            std::string target = params["callsign"].asString();
+            bool on = method == "activate";
+            if (target == kService) serviceActive = on;
+            else if (target == kPlayer) playerActive = on;
+            else return error_reply(id, 2, "Unknown callsign");
+            if (!on && target == kService) enabled = false;
+            if (!on) {
+                // like Thunder, a deactivated plugin forgets its event registrations
+                for (auto &c : clients) {
+                    for (auto it = c.second.begin(); it != c.second.end();) {
+                        if (it->first.compare(0, target.size() + 1, target + ".") == 0) it = c.second.erase(it);
+                        else ++it;
+                    }
+                }
+            }
+            Json::Value sc;
+            sc["callsign"] = target;
+            sc["state"] = on ? "Activated" : "Deactivated";
+            emit("Controller", "statechange", sc);
+        } else if (callsign == kService || callsign == kPlayer) {
+            if (!is_active(callsign)) return error_reply(id, 2, "Service is not active");
+            if (!handle_miracast(callsign, method, params, result)) {
+                return error_reply(id, -32601, "Unknown method");
+            }
+        } else {
+            return error_reply(id, -32601, "Unknown method");
+        }
+        if (id.isNull()) return Json::Value();
+        Json::Value r;
+        r["jsonrpc"] = "2.0";
+        r["id"] = id;
+        r["result"] = result;
+        return r;
+    }
+
+    bool handle_miracast(const std::string &callsign, const std::string &method, const Json::Value &params, Json::Value &result) {
+        result = success();
+        if (callsign == kService) {
+            if (method == "setEnable") {
+                enabled = params["enabled"].asBool();
+            } else if (method == "getEnable") {
+                result["enabled"] = enabled;
+            } else if (method == "acceptClientConnection") {
+                std::string mac = pendingMac;
+                pendingMac.clear();
+                auto it = sessions.find(mac);
+                if (it == sessions.end()) return true;
+                if (params["requestStatus"].asString() != "Accept") { sessions.erase(it); return true; }
+                it->second.accepted = true;
+                std::string name = it->second.name;
+                after(opts.launchDelayMs, [this, mac, name]{
+                    Json::Value dev;
+                    dev["source_dev_ip"] = "192.168.49.100";
+                    dev["source_dev_mac"] = mac;
+                    dev["source_dev_name"] = name;
+                    dev["sink_dev_ip"] = "192.168.49.1";
+                    Json::Value p;
+                    p["device_parameters"] = dev;
+                    emit(kService, "onLaunchRequest", p);
+                });
+            } else if (method == "stopClientConnection") {
+                sessions.erase(params["mac"].asString());
+            } else if (method != "updatePlayerState" && method != "setLogging") {
+                return false;
+            }
+        } else {
+            if (method == "playRequest") {
+                const Json::Value &dev = params["device_parameters"];
+                std::string mac = dev["source_dev_mac"].asString();
+                std::string name = dev["source_dev_name"].asString();
+                emit_player_state(mac, name, "INITIATED", 0);
+                after(opts.playDelayMs, [this, mac, name]{ emit_player_state(mac, name, "PLAYING", 0); });
+            } else if (method == "stopRequest") {
+                std::string mac = params["mac"].asString();
+                std::string name = params["name"].asString();
+                after(1, [this, mac, name]{ emit_player_state(mac, name, "STOPPED", 0); });
+            } else if (method != "setVideoRectangle" && method != "setLogging") {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // single request or JSON-RPC 2.0 batch array; empty string if nothing to send back
+    std::string process(const std::string &body, Subscriptions *subs) {
+        Json::Value req;
+        if (!parseJson(body, req)) return jsonToString(error_reply(Json::Value(), -32700, "Parse error"));
+        if (req.isArray()) {
+            Json::Value out(Json::arrayValue);
+            for (const auto &r : req) {
+                Json::Value resp = handle(r, subs);
+                if (!resp.isNull()) out.append(resp);
+            }
+            return out.empty() ? std::string() : jsonToString(out);
+        }
+        Json::Value resp = handle(req, subs);
+        return resp.isNull() ? std::string() : jsonToString(resp);
+    }
+
+    void on_ws_message(websocketpp::connection_hdl h, const std::string &payload) {
+        auto it = clients.find(h);
+        std::string reply = process(payload, it == clients.end() ? nullptr : &it->second);
+        if (reply.empty()) return;
+        after(reply_delay(), [this, h, reply]{
+            websocketpp::lib::error_code ec;
+            server.send(h, reply, websocketpp::frame::opcode::text, ec);
+        });
+    }
+
+    void on_http(websocketpp::connection_hdl h) {
+        ws_server::connection_ptr con = server.get_con_from_hdl(h);
+        if (con->get_request().get_method() != "POST") {
+            con->set_status(websocketpp::http::status_code::method_not_allowed);
+            return;
+        }
+        std::string reply = process(con->get_request_body(), nullptr);
+        con->append_header("Content-Type", "application/json");
+        con->set_status(websocketpp::http::status_code::ok);
+        con->set_body(reply);
+        long delay = reply_delay();
+        if (delay <= 0) return;
+        if (con->defer_http_response()) return;
+        after(delay, [con]{
+            websocketpp::lib::error_code sec;
+            con->send_http_response(sec);
+        });
+    }
+};
+
+static void usage() {
+    std::cout << "Usage: mockthunder [options]\n"
+              << "  --port N                 listen port (default 9998)\n"
+              << "  --latency-ms N           delay before every RPC reply\n"
+              << "  --jitter-ms N            +/- random jitter on the reply delay\n"
+              << "  --request-interval-ms N  emit onClientConnectionRequest every N ms while enabled\n"
+              << "  --launch-delay-ms N      accept -> onLaunchRequest delay (default 50)\n"
+              << "  --play-delay-ms N        playRequest -> PLAYING delay (default 100)\n"
+              << "  --state-event-rate R     extra onStateChange events per second\n";
+}
+
+int main(int argc, char **argv) {
+    MockOptions o;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (a == "-h" || a == "--help") { usage(); return 0; }
+        if (!v) { usage(); return 1; }
+        if (a == "--port") o.port = (uint16_t)std::atoi(v);
+        else if (a == "--latency-ms") o.latencyMs = std::atol(v);
+        else if (a == "--jitter-ms") o.jitterMs = std::atol(v);
+        else if (a == "--request-interval-ms") o.requestIntervalMs = std::atol(v);
+        else if (a == "--launch-delay-ms") o.launchDelayMs = std::atol(v);
+        else if (a == "--play-delay-ms") o.playDelayMs = std::atol(v);
+        else if (a == "--state-event-rate") o.stateEventRate = std::atof(v);
+        else { usage(); return 1; }
+        ++i;
+    }
+    MockThunder mock(o);
+    return mock.run() ? 0 : 1;
+}
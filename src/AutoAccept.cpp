@@ -0,0 +1,226 @@
+#include "AutoAccept.h"
+#include "Log.h"
+#include "Miracast.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+typedef std::chrono::steady_clock clock_type;
+
+static const size_t kMaxRecords = 10000;
+
+static std::string lower(const std::string &s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c){ return (char)std::tolower(c); });
+    return out;
+}
+
+// '*' glob, iterative with single backtrack point
+static bool glob(const std::string &p, const std::string &s) {
+    size_t pi = 0, si = 0, star = std::string::npos, mark = 0;
+    while (si < s.size()) {
+        if (pi < p.size() && p[pi] == s[si]) { ++pi; ++si; }
+        else if (pi < p.size() && p[pi] == '*') { star = pi++; mark = si; }
+        else if (star != std::string::npos) { pi = star + 1; si = ++mark; }
+        else return false;
+    }
+    while (pi < p.size() && p[pi] == '*') ++pi;
+    return pi == p.size();
+}
+
+static bool matches(const std::string &pattern, const std::string &mac, const std::string &name) {
+    return glob(lower(pattern), lower(mac)) || glob(pattern, name);
+}
+
+static bool matches_any(const std::vector<std::string> &patterns, const std::string &mac, const std::string &name) {
+    for (const auto &p : patterns) if (matches(p, mac, name)) return true;
+    return false;
+}
+
+static uint64_t us_since(EventTime t) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - t).count();
+}
+
+struct AutoAcceptor::Impl {
+    std::string controllerUrl;
+    std::atomic<bool> enabled;
+    mutable std::mutex mtx;
+    AutoAcceptRules rules;
+    std::set<std::string> sessions;  // MACs of accepted, still running sessions
+    double tokens;
+    clock_type::time_point lastRefill;
+    std::deque<AcceptRecord> records;
+    uint64_t accepted, rejected, failed;
+    unsigned inFlight = 0;           // answers sent, reply pending
+    std::condition_variable idle;
+
+    Impl(const std::string &url, const AutoAcceptRules &r)
+        : controllerUrl(url), enabled(false), rules(r), tokens(0), lastRefill(clock_type::now()),
+          accepted(0), rejected(0), failed(0) {
+        tokens = burst();
+    }
+
+    double burst() const { return std::max(1.0, rules.ratePerSec); }
+
+    ~Impl() {
+        // callbacks hold this; the transport timeout bounds the wait
+        std::unique_lock<std::mutex> lk(mtx);
+        idle.wait(lk, [this]{ return inFlight == 0; });
+    }
+
+    // decide under the lock; a positive decision reserves the session slot and a token (tookToken)
+    bool decide(const ClientConnectionRequest &ev, std::string &reason, bool &tookToken) {
+        tookToken = false;
+        std::lock_guard<std::mutex> g(mtx);
+        if (matches_any(rules.deny, ev.mac, ev.name)) { reason = "deny"; return false; }
+        if (!rules.allow.empty() && !matches_any(rules.allow, ev.mac, ev.name)) { reason = "not allowed"; return false; }
+        if (rules.maxSessions && sessions.size() >= rules.maxSessions && !sessions.count(lower(ev.mac))) {
+            reason = "max sessions";
+            return false;
+        }
+        if (rules.ratePerSec > 0) {
+            auto now = clock_type::now();
+            tokens = std::min(burst(), tokens + std::chrono::duration<double>(now - lastRefill).count() * rules.ratePerSec);
+            lastRefill = now;
+            if (tokens < 1.0) { reason = "rate limit"; return false; }
+            tokens -= 1.0;
+            tookToken = true;
+        }
+        sessions.insert(lower(ev.mac));
+        ++inFlight;
+        return true;
+    }
+
+    // dispatch thread: decide and send the answer without waiting for the reply, so other events
+    // on this worker are not held up for the round trip
+    void on_request(const ClientConnectionRequest &ev) {
+        if (!enabled) return;
+        AcceptRecord rec;
+        rec.mac = ev.mac;
+        rec.name = ev.name;
+        bool tookToken = false;
+        rec.accepted = decide(ev, rec.reason, tookToken);
+        if (!rec.accepted) {
+            std::lock_guard<std::mutex> g(mtx);
+            ++inFlight;
+        }
+        Json::Value params;
+        params["requestStatus"] = rec.accepted ? "Accept" : "Reject";
+        auto rpcStart = clock_type::now();
+        EventTime received = ev.received;
+        Impl *p = this;
+        json_rpc_async(controllerUrl, "org.rdk.MiracastService.acceptClientConnection", params,
+                       [p, rec, tookToken, rpcStart, received](bool ok, const Json::Value &, const RpcTiming &) mutable {
+            rec.rpcOk = ok;
+            rec.rpcUs = us_since(rpcStart);
+            rec.requestToReplyUs = us_since(received);
+            p->answered(rec, tookToken);
+        });
+    }
+
+    // transport thread
+    void answered(const AcceptRecord &rec, bool tookToken) {
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            if (!rec.rpcOk) {
+                ++failed;
+                if (rec.accepted) sessions.erase(lower(rec.mac));
+                // a transient error does not count against the rate limit
+                if (tookToken) tokens = std::min(burst(), tokens + 1.0);
+            } else if (rec.accepted) {
+                ++accepted;
+            } else {
+                ++rejected;
+            }
+            records.push_back(rec);
+            if (records.size() > kMaxRecords) records.pop_front();
+        }
+        {
+            LogLine line(rec.rpcOk ? LogLevel::Info : LogLevel::Warn, "AutoAccept");
+            line << (rec.accepted ? "Accept " : "Reject ") << rec.mac << " / " << rec.name;
+            if (!rec.accepted) line << " (" << rec.reason << ")";
+            if (!rec.rpcOk) line << " RPC FAILED";
+            line << " request->reply " << rec.requestToReplyUs << "us (rpc " << rec.rpcUs << "us)";
+        }
+        std::lock_guard<std::mutex> g(mtx);
+        --inFlight;
+        idle.notify_all();
+    }
+
+    void end_session(const std::string &mac) {
+        std::lock_guard<std::mutex> g(mtx);
+        sessions.erase(lower(mac));
+    }
+};
+
+AutoAcceptor::AutoAcceptor(const std::string &controllerUrl, const AutoAcceptRules &rules) : pimpl(new Impl(controllerUrl, rules)) {}
+AutoAcceptor::~AutoAcceptor() { delete pimpl; }
+
+void AutoAcceptor::attach(EventListener &listener) {
+    Impl *p = pimpl;
+    on_client_connection_request(listener, [p](const ClientConnectionRequest &ev){ p->on_request(ev); });
+    on_client_connection_error(listener, [p](const ClientConnectionError &ev){ p->end_session(ev.mac); });
+    on_player_state_change(listener, [p](const PlayerStateChange &ev){
+        if (ev.state == "STOPPED") p->end_session(ev.mac);
+    });
+}
+
+void AutoAcceptor::setEnabled(bool enabled) { pimpl->enabled = enabled; }
+bool AutoAcceptor::isEnabled() const { return pimpl->enabled; }
+
+void AutoAcceptor::setRules(const AutoAcceptRules &rules) {
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    pimpl->rules = rules;
+    pimpl->tokens = pimpl->burst();
+    pimpl->lastRefill = clock_type::now();
+}
+
+AutoAcceptRules AutoAcceptor::getRules() const {
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    return pimpl->rules;
+}
+
+void AutoAcceptor::sessionEnded(const std::string &mac) { pimpl->end_session(mac); }
+
+AutoAcceptStats AutoAcceptor::getStats() const {
+    AutoAcceptStats st;
+    std::vector<uint64_t> lat;
+    {
+        std::lock_guard<std::mutex> g(pimpl->mtx);
+        st.accepted = pimpl->accepted;
+        st.rejected = pimpl->rejected;
+        st.failed = pimpl->failed;
+        st.activeSessions = (unsigned)pimpl->sessions.size();
+        for (const auto &r : pimpl->records) if (r.accepted && r.rpcOk) lat.push_back(r.requestToReplyUs);
+    }
+    if (!lat.empty()) {
+        std::sort(lat.begin(), lat.end());
+        st.minUs = lat.front();
+        st.maxUs = lat.back();
+        st.p50Us = lat[(lat.size() - 1) / 2];
+        st.p99Us = lat[(lat.size() - 1) * 99 / 100];
+    }
+    return st;
+}
+
+std::vector<AcceptRecord> AutoAcceptor::getRecords() const {
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    return std::vector<AcceptRecord>(pimpl->records.begin(), pimpl->records.end());
+}
+
+bool AutoAcceptor::writeRecordsCsv(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "mac,name,decision,reason,rpc_ok,request_to_reply_us,rpc_us\n";
+    for (const auto &r : getRecords()) {
+        out << r.mac << "," << r.name << "," << (r.accepted ? "Accept" : "Reject") << "," << r.reason << ","
+            << (r.rpcOk ? 1 : 0) << "," << r.requestToReplyUs << "," << r.rpcUs << "\n";
+    }
+    return (bool)out;
+}
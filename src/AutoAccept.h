@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MiracastEvents.h"
+
+// Rules for answering onClientConnectionRequest without an operator.
+// Patterns match the source MAC (case-insensitive) or name; '*' matches any run of characters.
+struct AutoAcceptRules {
+    std::vector<std::string> allow;  // empty = allow everyone not denied
+    std::vector<std::string> deny;   // checked first
+    unsigned maxSessions = 0;        // concurrent accepted sessions, 0 = unlimited
+    double ratePerSec = 0;           // accepts per second (token bucket, burst = max(1, rate)), 0 = unlimited
+};
+
+// one answered connection request
+struct AcceptRecord {
+    std::string mac;
+    std::string name;
+    bool accepted = false;     // Accept (true) or Reject (false) was sent
+    bool rpcOk = false;        // acceptClientConnection call succeeded
+    std::string reason;        // why it was rejected ("deny", "not allowed", "max sessions", "rate limit")
+    uint64_t requestToReplyUs = 0;  // event read from socket -> acceptClientConnection reply received
+    uint64_t rpcUs = 0;             // acceptClientConnection round trip only
+};
+
+struct AutoAcceptStats {
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+    uint64_t failed = 0;         // RPC errors
+    unsigned activeSessions = 0;
+    uint64_t minUs = 0, p50Us = 0, p99Us = 0, maxUs = 0;  // request -> accept latency of accepted sessions
+};
+
+// Answers connection requests directly on the event dispatch thread as soon as they arrive.
+class AutoAcceptor {
+public:
+    AutoAcceptor(const std::string &controllerUrl, const AutoAcceptRules &rules);
+    ~AutoAcceptor();
+
+    // register on listener's connection request / error / player state events (before start())
+    void attach(EventListener &listener);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void setRules(const AutoAcceptRules &rules);
+    AutoAcceptRules getRules() const;
+
+    // the session for mac ended outside of the events we watch
+    void sessionEnded(const std::string &mac);
+
+    AutoAcceptStats getStats() const;
+    std::vector<AcceptRecord> getRecords() const;  // in arrival order, last 10000 kept
+    bool writeRecordsCsv(const std::string &path) const;
+
+private:
+    AutoAcceptor(const AutoAcceptor&) = delete;
+    AutoAcceptor &operator=(const AutoAcceptor&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
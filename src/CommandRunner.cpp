@@ -0,0 +1,217 @@
+#include "CommandRunner.h"
+#include "Log.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+typedef std::chrono::steady_clock clock_type;
+
+static const long kDefaultTimeoutMs = 6000;
+static const size_t kTimingHistory = 64;
+
+static std::string compact(const Json::Value &v) {
+    Json::StreamWriterBuilder w;
+    w["indentation"] = "";
+    return Json::writeString(w, v);
+}
+
+struct Command {
+    int id = 0;
+    std::string label;
+    std::vector<RpcCall> calls;
+    CommandRunner::Formatter describe;
+    long timeoutMs = 0;
+    clock_type::time_point start, deadline;
+    size_t step = 0;
+    uint64_t rpcId = 0;     // transport id of the step in flight
+    bool cancelled = false;
+    bool timed = false;     // timing holds the latest answered step
+    RpcTiming timing;
+};
+
+struct CommandRunner::Impl {
+    std::string url;
+    mutable std::mutex mtx;
+    std::condition_variable changed;
+    std::map<int, std::shared_ptr<Command>> running;  // by id, so oldest first
+    std::deque<std::pair<int, RpcTiming>> timings;    // of finished commands, oldest first
+    int nextId = 1;
+
+    explicit Impl(const std::string &u): url(u) {}
+
+    // send the current step with what is left of the deadline
+    void issue(const std::shared_ptr<Command> &cmd, size_t step) {
+        long leftMs = (long)std::chrono::duration_cast<std::chrono::milliseconds>(cmd->deadline - clock_type::now()).count();
+        if (leftMs <= 0) {
+            finish(cmd, "timeout", Json::Value());
+            return;
+        }
+        const RpcCall &call = cmd->calls[step];
+        uint64_t rpcId = json_rpc_async(url, call.method, call.params, [this, cmd](bool ok, const Json::Value &resp, const RpcTiming &timing) {
+            completed(cmd, ok, resp, timing);
+        }, leftMs);
+        bool cancelNow = false;
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            // the reply may already have arrived and moved the command on
+            if (cmd->step == step && running.count(cmd->id)) {
+                cmd->rpcId = rpcId;
+                cancelNow = cmd->cancelled;
+            }
+        }
+        if (cancelNow) cancel_rpc(rpcId);
+    }
+
+    // transport thread
+    void completed(const std::shared_ptr<Command> &cmd, bool ok, const Json::Value &resp, const RpcTiming &timing) {
+        size_t next = 0;
+        bool cancelled;
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            cmd->timing = timing;
+            cmd->timed = true;
+            cancelled = cmd->cancelled;
+            if (!cancelled && ok && cmd->step + 1 < cmd->calls.size()) next = ++cmd->step;
+        }
+        if (next) {
+            issue(cmd, next);
+            return;
+        }
+        if (cancelled) finish(cmd, "cancelled", resp);
+        else if (ok) finish(cmd, "ok", resp);
+        else if (clock_type::now() >= cmd->deadline) finish(cmd, "timeout", resp);
+        else finish(cmd, "FAILED", resp);
+    }
+
+    void finish(const std::shared_ptr<Command> &cmd, const char *outcome, const Json::Value &resp) {
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - cmd->start).count() / 1000.0;
+        std::ostringstream line;
+        line << "#" << cmd->id << " " << cmd->label << " " << outcome << " " << std::fixed << std::setprecision(1) << ms << " ms";
+        if (cmd->calls.size() > 1 && std::string(outcome) != "ok") {
+            line << " at " << cmd->calls[cmd->step].method << " (" << cmd->step + 1 << "/" << cmd->calls.size() << ")";
+        }
+        if (std::string(outcome) == "ok") line << " " << (cmd->describe ? cmd->describe(resp) : compact(resp));
+        else if (resp.isObject() && resp.isMember("error")) line << " " << compact(resp["error"]);
+        log_write(std::string(outcome) == "ok" ? LogLevel::Info : LogLevel::Warn, "cmd", line.str());
+        // notify under the lock: once running is empty the destructor may free this
+        std::lock_guard<std::mutex> g(mtx);
+        if (cmd->timed) {
+            timings.emplace_back(cmd->id, cmd->timing);
+            if (timings.size() > kTimingHistory) timings.pop_front();
+        }
+        running.erase(cmd->id);
+        changed.notify_all();
+    }
+
+    bool cancel(int id) {
+        uint64_t rpcId = 0;
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            auto it = running.find(id);
+            if (it == running.end() || it->second->cancelled) return false;
+            it->second->cancelled = true;
+            rpcId = it->second->rpcId;
+        }
+        if (rpcId) cancel_rpc(rpcId);
+        return true;
+    }
+};
+
+CommandRunner::CommandRunner(const std::string &controllerUrl) : pimpl(new Impl(controllerUrl)) {}
+
+CommandRunner::~CommandRunner() {
+    cancelAll();
+    wait(0);
+    delete pimpl;
+}
+
+int CommandRunner::submit(const std::string &label, const std::vector<RpcCall> &calls, long timeoutMs, Formatter describe) {
+    auto cmd = std::make_shared<Command>();
+    cmd->label = label;
+    cmd->calls = calls;
+    cmd->describe = std::move(describe);
+    cmd->timeoutMs = timeoutMs > 0 ? timeoutMs : kDefaultTimeoutMs;
+    cmd->start = clock_type::now();
+    cmd->deadline = cmd->start + std::chrono::milliseconds(cmd->timeoutMs);
+    {
+        std::lock_guard<std::mutex> g(pimpl->mtx);
+        cmd->id = pimpl->nextId++;
+        pimpl->running[cmd->id] = cmd;
+    }
+    int id = cmd->id;
+    if (calls.empty()) pimpl->finish(cmd, "ok", Json::Value());
+    else pimpl->issue(cmd, 0);
+    return id;
+}
+
+bool CommandRunner::cancel(int id) {
+    return pimpl->cancel(id);
+}
+
+size_t CommandRunner::cancelAll() {
+    std::vector<int> ids;
+    {
+        std::lock_guard<std::mutex> g(pimpl->mtx);
+        for (const auto &kv : pimpl->running) ids.push_back(kv.first);
+    }
+    size_t n = 0;
+    for (int id : ids) n += pimpl->cancel(id) ? 1 : 0;
+    return n;
+}
+
+std::vector<CommandInfo> CommandRunner::list() const {
+    std::vector<CommandInfo> out;
+    auto now = clock_type::now();
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    for (const auto &kv : pimpl->running) {
+        const Command &c = *kv.second;
+        CommandInfo info;
+        info.id = c.id;
+        info.label = c.label;
+        info.step = c.step;
+        info.steps = c.calls.size();
+        info.elapsedUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - c.start).count();
+        info.timeoutMs = c.timeoutMs;
+        out.push_back(info);
+    }
+    return out;
+}
+
+bool CommandRunner::timing(int id, RpcTiming &out) const {
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    if (id == 0) {
+        if (pimpl->timings.empty()) return false;
+        out = pimpl->timings.back().second;
+        return true;
+    }
+    auto it = pimpl->running.find(id);
+    if (it != pimpl->running.end()) {
+        if (!it->second->timed) return false;
+        out = it->second->timing;
+        return true;
+    }
+    for (const auto &t : pimpl->timings) {
+        if (t.first == id) { out = t.second; return true; }
+    }
+    return false;
+}
+
+size_t CommandRunner::pending() const {
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    return pimpl->running.size();
+}
+
+bool CommandRunner::wait(int id, long timeoutMs) {
+    std::unique_lock<std::mutex> lk(pimpl->mtx);
+    auto done = [&]{ return id ? pimpl->running.count(id) == 0 : pimpl->running.empty(); };
+    if (timeoutMs < 0) {
+        pimpl->changed.wait(lk, done);
+        return true;
+    }
+    return pimpl->changed.wait_for(lk, std::chrono::milliseconds(timeoutMs), done);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <json/json.h>
+#include "Miracast.h"
+
+// one command still running
+struct CommandInfo {
+    int id = 0;
+    std::string label;
+    size_t step = 0, steps = 0;   // RPC being waited on, of the command's sequence
+    uint64_t elapsedUs = 0;
+    long timeoutMs = 0;
+};
+
+// Runs interactive commands without blocking the prompt. A command is a sequence of RPCs sent in order
+// with json_rpc_async; the sequence stops at the first failure. Each command has its own deadline over
+// the whole sequence and can be cancelled. When it ends a line with its id, outcome and latency is
+// logged: "[cmd] #3 set_enable ok 4.1 ms {...}".
+class CommandRunner {
+public:
+    // summary printed on success instead of the compact last response
+    typedef std::function<std::string(const Json::Value &response)> Formatter;
+
+    explicit CommandRunner(const std::string &controllerUrl);
+    // cancels what is still running and waits for the callbacks
+    ~CommandRunner();
+
+    // returns the command id (> 0); timeoutMs <= 0 uses 6 s
+    int submit(const std::string &label, const std::vector<RpcCall> &calls, long timeoutMs, Formatter describe = nullptr);
+
+    // false if id is not running
+    bool cancel(int id);
+    size_t cancelAll();
+
+    // oldest first
+    std::vector<CommandInfo> list() const;
+    size_t pending() const;
+
+    // DNS/connect/first-byte/total of the latest answered RPC of command id (0 = the last finished
+    // command); kept for the last 64 finished commands. False if unknown or nothing answered yet.
+    bool timing(int id, RpcTiming &out) const;
+
+    // until command id (0 = all) has finished; false if timeoutMs (< 0 = no limit) elapsed first
+    bool wait(int id, long timeoutMs = -1);
+
+private:
+    CommandRunner(const CommandRunner&) = delete;
+    CommandRunner &operator=(const CommandRunner&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
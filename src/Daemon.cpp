@@ -0,0 +1,624 @@
+#include "Daemon.h"
+#include "Log.h"
+#include "Miracast.h"
+#include "StateCache.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+static const uint32_t kMaxFrame = 1u << 20;
+static const size_t kRetainedEvents = 1024;
+static const size_t kMaxPending = 8u << 20;   // per client; further events are dropped for it
+
+static std::string compact(const Json::Value &v) {
+    Json::StreamWriterBuilder w;
+    w["indentation"] = "";
+    return Json::writeString(w, v);
+}
+
+static bool parse(const std::string &s, Json::Value &out) {
+    Json::CharReaderBuilder b;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(b.newCharReader());
+    return reader->parse(s.data(), s.data() + s.size(), &out, &errs) && out.isObject();
+}
+
+static void append_frame(std::string &out, const std::string &payload) {
+    uint32_t n = (uint32_t)payload.size();
+    char len[4] = {(char)(n >> 24), (char)(n >> 16), (char)(n >> 8), (char)n};
+    out.append(len, 4);
+    out.append(payload);
+}
+
+// 1 = payload holds the next frame, 0 = incomplete, -1 = oversized
+static int take_frame(std::string &buf, std::string &payload) {
+    if (buf.size() < 4) return 0;
+    const unsigned char *p = (const unsigned char*)buf.data();
+    uint32_t n = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+    if (n > kMaxFrame) return -1;
+    if (buf.size() < 4 + (size_t)n) return 0;
+    payload.assign(buf, 4, n);
+    buf.erase(0, 4 + (size_t)n);
+    return 1;
+}
+
+static bool fill_address(const std::string &path, sockaddr_un &addr, std::string &error) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        error = "socket path empty or too long: " + path;
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// event name alone or the full "<callsign>.<event>" method
+static bool matches(const std::vector<std::string> &filter, const std::string &method) {
+    if (filter.empty()) return true;
+    size_t dot = method.rfind('.');
+    for (const auto &f : filter) {
+        if (f == method) return true;
+        if (dot != std::string::npos && method.compare(dot + 1, std::string::npos, f) == 0) return true;
+    }
+    return false;
+}
+
+struct DaemonConn {
+    uint64_t id = 0;
+    int fd = -1;
+    std::string in;                    // loop thread only
+    std::string out;                   // guarded by Daemon::Impl::mtx
+    bool subscribed = false;
+    std::vector<std::string> filter;
+    uint64_t dropped = 0;
+};
+
+struct RetainedEvent {
+    uint64_t seq;
+    std::string method;
+    std::string frame;   // length prefix included
+};
+
+struct Daemon::Impl {
+    std::string url;
+    std::string path;
+    EventListener &listener;
+    const StateCache *state = nullptr;
+    int listenFd = -1;
+    int wake[2] = {-1, -1};
+    std::thread runner;
+    std::atomic<bool> running{false};
+    std::atomic<bool> shutdown{false};
+    clock_type::time_point started;
+    std::function<void(const Json::Value&)> previousCallback;  // the listener's catch-all before start()
+
+    mutable std::mutex mtx;                 // everything below, and the write end of wake
+    std::condition_variable callsDone;
+    std::map<uint64_t, std::shared_ptr<DaemonConn>> conns;
+    uint64_t nextConn = 1;
+    std::deque<RetainedEvent> retained;
+    uint64_t seq = 0;
+    uint64_t droppedEvents = 0;
+    std::map<uint64_t, uint64_t> calls;     // call key -> transport id (0 until known)
+    uint64_t nextCall = 1;
+    uint64_t callsTotal = 0, callsFailed = 0;
+
+    Impl(const std::string &u, EventListener &l): url(u), listener(l) {}
+
+    // with mtx held
+    void wake_locked() {
+        if (wake[1] >= 0) {
+            ssize_t r = write(wake[1], "x", 1);
+            (void)r;  // a full pipe already wakes the loop
+        }
+    }
+
+    void send_locked(DaemonConn &c, const Json::Value &frame) {
+        append_frame(c.out, compact(frame));
+    }
+
+    // dispatch worker thread
+    void on_notification(const Json::Value &j) {
+        const Json::Value &m = j["method"];
+        if (!m.isString()) return;
+        std::string method = m.asString();
+        Json::Value ev;
+        ev["event"] = method;
+        ev["params"] = j["params"];
+        std::lock_guard<std::mutex> g(mtx);
+        if (!running) return;
+        ev["seq"] = (Json::UInt64)++seq;
+        RetainedEvent r{seq, method, std::string()};
+        append_frame(r.frame, compact(ev));
+        bool queued = false;
+        for (auto &kv : conns) {
+            DaemonConn &c = *kv.second;
+            if (!c.subscribed || !matches(c.filter, method)) continue;
+            if (c.out.size() > kMaxPending) {
+                ++c.dropped;
+                ++droppedEvents;
+                continue;
+            }
+            c.out += r.frame;
+            queued = true;
+        }
+        retained.push_back(std::move(r));
+        if (retained.size() > kRetainedEvents) retained.pop_front();
+        if (queued) wake_locked();
+    }
+
+    void call(const std::shared_ptr<DaemonConn> &conn, const Json::Value &id, const Json::Value &req) {
+        const Json::Value &method = req["method"];
+        if (!method.isString() || method.asString().empty()) {
+            error_reply(*conn, id, "missing method");
+            return;
+        }
+        Json::Value params = req.isMember("params") ? req["params"] : Json::Value(Json::objectValue);
+        long timeoutMs = req.isMember("timeout_ms") && req["timeout_ms"].isIntegral() ? (long)req["timeout_ms"].asInt64() : 0;
+        uint64_t key, connId = conn->id;
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            key = nextCall++;
+            calls[key] = 0;
+        }
+        auto start = clock_type::now();
+        uint64_t rpcId = json_rpc_async(url, method.asString(), params, [this, key, connId, id, start](bool ok, const Json::Value &resp, const RpcTiming &) {
+            Json::Value r;
+            r["id"] = id;
+            r["ok"] = ok;
+            r["response"] = resp;
+            r["latency_us"] = (Json::UInt64)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count();
+            std::lock_guard<std::mutex> g(mtx);
+            calls.erase(key);
+            ++callsTotal;
+            if (!ok) ++callsFailed;
+            auto it = conns.find(connId);
+            if (it != conns.end()) {
+                send_locked(*it->second, r);
+                wake_locked();
+            }
+            callsDone.notify_all();
+        }, timeoutMs);
+        std::lock_guard<std::mutex> g(mtx);
+        auto it = calls.find(key);
+        if (it != calls.end()) it->second = rpcId;
+    }
+
+    void error_reply(DaemonConn &c, const Json::Value &id, const std::string &error) {
+        Json::Value r;
+        r["id"] = id;
+        r["ok"] = false;
+        r["error"] = error;
+        std::lock_guard<std::mutex> g(mtx);
+        send_locked(c, r);
+    }
+
+    void subscribe(const std::shared_ptr<DaemonConn> &conn, const Json::Value &id, const Json::Value &req) {
+        std::vector<std::string> filter;
+        for (const auto &e : req["events"]) {
+            if (!e.isString()) continue;
+            std::string name = e.asString();
+            filter.push_back(name);
+            // a full "<callsign>.<event>" is also registered with Thunder
+            size_t dot = name.rfind('.');
+            if (dot != std::string::npos && dot > 0) listener.subscribe(name.substr(0, dot), name.substr(dot + 1));
+        }
+        bool replay = req.isMember("since") && req["since"].isIntegral();
+        uint64_t since = replay ? req["since"].asUInt64() : 0;
+        // reply, backlog and live events go out under one lock: nothing is missed or sent twice
+        std::lock_guard<std::mutex> g(mtx);
+        conn->subscribed = true;
+        conn->filter = filter;
+        Json::Value r;
+        r["id"] = id;
+        r["ok"] = true;
+        r["seq"] = (Json::UInt64)seq;
+        send_locked(*conn, r);
+        if (!replay) return;
+        for (const auto &ev : retained) {
+            if (ev.seq > since && matches(conn->filter, ev.method)) conn->out += ev.frame;
+        }
+    }
+
+    Json::Value stats() const {
+        Json::Value s;
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            unsigned subscribers = 0;
+            for (const auto &kv : conns) subscribers += kv.second->subscribed ? 1 : 0;
+            s["clients"] = (Json::UInt64)conns.size();
+            s["subscribers"] = subscribers;
+            s["calls"]["total"] = (Json::UInt64)callsTotal;
+            s["calls"]["failed"] = (Json::UInt64)callsFailed;
+            s["calls"]["in_flight"] = (Json::UInt64)calls.size();
+            s["events"]["seq"] = (Json::UInt64)seq;
+            s["events"]["retained"] = (Json::UInt64)retained.size();
+            s["events"]["dropped"] = (Json::UInt64)droppedEvents;
+        }
+        s["uptime_ms"] = (Json::UInt64)std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - started).count();
+        DispatchStats d = listener.getDispatchStats();
+        s["dispatch"]["received"] = (Json::UInt64)d.received;
+        s["dispatch"]["dispatched"] = (Json::UInt64)d.dispatched;
+        s["dispatch"]["dropped"] = (Json::UInt64)d.dropped;
+        s["dispatch"]["parse_errors"] = (Json::UInt64)d.parseErrors;
+        s["dispatch"]["handler_errors"] = (Json::UInt64)d.handlerErrors;
+        s["dispatch"]["max_latency_us"] = (Json::UInt64)d.maxLatencyUs;
+        ConnectionStats c = listener.getConnectionStats();
+        s["connection"]["connected"] = c.connected;
+        s["connection"]["reconnects"] = (Json::UInt64)c.reconnects;
+        s["connection"]["total_gap_us"] = (Json::UInt64)c.totalGapUs;
+        s["connection"]["handshake_us"] = (Json::UInt64)c.lastHandshake.totalUs;
+        if (c.secure) {
+            s["connection"]["tls_us"] = (Json::UInt64)c.lastHandshake.tlsUs;
+            s["connection"]["tls_resumed"] = (Json::UInt64)c.tlsResumed;
+            s["connection"]["tls_full"] = (Json::UInt64)c.tlsFull;
+        }
+        s["connection"]["deflate"] = c.deflate;
+        return s;
+    }
+
+    // loop thread
+    void handle(const std::shared_ptr<DaemonConn> &conn, const std::string &payload) {
+        Json::Value req;
+        if (!parse(payload, req)) {
+            error_reply(*conn, Json::Value(), "request is not a JSON object");
+            return;
+        }
+        const Json::Value &id = req["id"];
+        std::string cmd = req["cmd"].isString() ? req["cmd"].asString() : std::string();
+        if (cmd == "call") {
+            call(conn, id, req);
+        } else if (cmd == "subscribe") {
+            subscribe(conn, id, req);
+        } else if (cmd == "state") {
+            if (!state) {
+                error_reply(*conn, id, "no state cache");
+                return;
+            }
+            Json::Value r;
+            r["id"] = id;
+            r["ok"] = true;
+            r["state"] = state->toJson();
+            std::lock_guard<std::mutex> g(mtx);
+            send_locked(*conn, r);
+        } else if (cmd == "ping" || cmd == "unsubscribe" || cmd == "stats" || cmd == "shutdown") {
+            Json::Value r;
+            if (cmd == "stats") r = stats();
+            r["id"] = id;
+            r["ok"] = true;
+            if (cmd == "ping") {
+                r["uptime_ms"] = (Json::UInt64)std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - started).count();
+            }
+            std::lock_guard<std::mutex> g(mtx);
+            if (cmd == "unsubscribe") {
+                conn->subscribed = false;
+                conn->filter.clear();
+            }
+            send_locked(*conn, r);
+            if (cmd == "shutdown") shutdown = true;
+        } else {
+            error_reply(*conn, id, "unknown cmd '" + cmd + "'");
+        }
+    }
+
+    void accept_clients() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    LogLine(LogLevel::Warn, "daemon") << "accept: " << strerror(errno);
+                }
+                return;
+            }
+            auto c = std::make_shared<DaemonConn>();
+            c->fd = fd;
+            std::lock_guard<std::mutex> g(mtx);
+            c->id = nextConn++;
+            conns[c->id] = c;
+        }
+    }
+
+    // false if the connection should be closed
+    bool read_client(const std::shared_ptr<DaemonConn> &c) {
+        char buf[16384];
+        while (true) {
+            ssize_t n = read(c->fd, buf, sizeof(buf));
+            if (n > 0) {
+                c->in.append(buf, (size_t)n);
+                continue;
+            }
+            if (n == 0) return false;
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        std::string payload;
+        while (true) {
+            int r = take_frame(c->in, payload);
+            if (r < 0) return false;
+            if (r == 0) return true;
+            handle(c, payload);
+        }
+    }
+
+    // with mtx held; false if the connection broke
+    bool flush_locked(DaemonConn &c) {
+        while (!c.out.empty()) {
+            ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) {
+                c.out.erase(0, (size_t)n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        return true;
+    }
+
+    void close_client(uint64_t id) {
+        std::lock_guard<std::mutex> g(mtx);
+        auto it = conns.find(id);
+        if (it == conns.end()) return;
+        close(it->second->fd);
+        conns.erase(it);
+    }
+
+    void run() {
+        std::vector<pollfd> fds;
+        std::vector<std::shared_ptr<DaemonConn>> polled;
+        while (running) {
+            fds.clear();
+            polled.clear();
+            fds.push_back(pollfd{wake[0], POLLIN, 0});
+            fds.push_back(pollfd{listenFd, POLLIN, 0});
+            {
+                std::lock_guard<std::mutex> g(mtx);
+                for (auto &kv : conns) {
+                    short events = POLLIN;
+                    if (!kv.second->out.empty()) events |= POLLOUT;
+                    fds.push_back(pollfd{kv.second->fd, events, 0});
+                    polled.push_back(kv.second);
+                }
+            }
+            if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+                LogLine(LogLevel::Error, "daemon") << "poll: " << strerror(errno);
+                break;
+            }
+            if (fds[0].revents & POLLIN) {
+                char drain[256];
+                while (read(wake[0], drain, sizeof(drain)) > 0) {}
+            }
+            if (fds[1].revents & POLLIN) accept_clients();
+            for (size_t i = 0; i < polled.size(); ++i) {
+                auto &c = polled[i];
+                bool alive = true;
+                if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) alive = read_client(c);
+                if (alive) {
+                    std::lock_guard<std::mutex> g(mtx);
+                    alive = flush_locked(*c);
+                }
+                if (!alive) close_client(c->id);
+            }
+        }
+        std::lock_guard<std::mutex> g(mtx);
+        for (auto &kv : conns) close(kv.second->fd);
+        conns.clear();
+    }
+};
+
+Daemon::Daemon(const std::string &controllerUrl, EventListener &listener) : pimpl(new Impl(controllerUrl, listener)) {}
+
+Daemon::~Daemon() {
+    stop();
+    delete pimpl;
+}
+
+bool Daemon::start(const std::string &socketPath, std::string &error) {
+    if (pimpl->running) {
+        error = "already running";
+        return false;
+    }
+    sockaddr_un addr;
+    if (!fill_address(socketPath, addr, error)) return false;
+
+    struct stat st;
+    if (lstat(socketPath.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            error = socketPath + " exists and is not a socket";
+            return false;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && connect(probe, (sockaddr*)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (live) {
+            error = "another daemon is serving " + socketPath;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        error = socketPath + ": " + strerror(errno);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    if (pipe2(pimpl->wake, O_NONBLOCK | O_CLOEXEC) != 0) {
+        error = std::string("pipe: ") + strerror(errno);
+        close(fd);
+        unlink(socketPath.c_str());
+        return false;
+    }
+    pimpl->listenFd = fd;
+    pimpl->path = socketPath;
+    pimpl->started = clock_type::now();
+    pimpl->shutdown = false;
+    pimpl->running = true;
+    Impl *impl = pimpl;
+    // chained, so --print-events keeps printing
+    pimpl->previousCallback = pimpl->listener.notificationCallback();
+    auto previous = pimpl->previousCallback;
+    pimpl->listener.setNotificationCallback([impl, previous](const Json::Value &j) {
+        impl->on_notification(j);
+        if (previous) previous(j);
+    });
+    pimpl->runner = std::thread([impl] { impl->run(); });
+    return true;
+}
+
+void Daemon::stop() {
+    if (!pimpl->running) return;
+    pimpl->listener.setNotificationCallback(std::move(pimpl->previousCallback));
+    {
+        std::lock_guard<std::mutex> g(pimpl->mtx);
+        pimpl->running = false;
+        pimpl->wake_locked();
+    }
+    if (pimpl->runner.joinable()) pimpl->runner.join();
+
+    // outstanding calls reply into the closed connections; wait so their callbacks are done with us
+    std::vector<uint64_t> ids;
+    {
+        std::lock_guard<std::mutex> g(pimpl->mtx);
+        for (const auto &kv : pimpl->calls) {
+            if (kv.second) ids.push_back(kv.second);
+        }
+    }
+    for (uint64_t id : ids) cancel_rpc(id);
+    {
+        std::unique_lock<std::mutex> lk(pimpl->mtx);
+        pimpl->callsDone.wait(lk, [this] { return pimpl->calls.empty(); });
+        close(pimpl->wake[1]);
+        pimpl->wake[1] = -1;
+    }
+    close(pimpl->wake[0]);
+    pimpl->wake[0] = -1;
+    close(pimpl->listenFd);
+    pimpl->listenFd = -1;
+    unlink(pimpl->path.c_str());
+}
+
+void Daemon::setStateCache(const StateCache *cache) {
+    pimpl->state = cache;
+}
+
+bool Daemon::shutdownRequested() const {
+    return pimpl->shutdown;
+}
+
+Json::Value Daemon::stats() const {
+    return pimpl->stats();
+}
+
+/* client */
+
+DaemonClient::DaemonClient(): fd(-1), nextId(1) {}
+
+DaemonClient::~DaemonClient() {
+    if (fd >= 0) close(fd);
+}
+
+bool DaemonClient::connect(const std::string &socketPath, std::string &error) {
+    sockaddr_un addr;
+    if (!fill_address(socketPath, addr, error)) return false;
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        error = socketPath + ": " + strerror(errno);
+        if (fd >= 0) close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool DaemonClient::send(Json::Value request, std::string &error) {
+    if (fd < 0) {
+        error = "not connected";
+        return false;
+    }
+    if (!request.isMember("id")) request["id"] = nextId++;
+    std::string frame;
+    append_frame(frame, compact(request));
+    size_t off = 0;
+    while (off < frame.size()) {
+        ssize_t n = ::send(fd, frame.data() + off, frame.size() - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            error = std::string("send: ") + strerror(errno);
+            return false;
+        }
+        off += (size_t)n;
+    }
+    return true;
+}
+
+bool DaemonClient::receive(Json::Value &frame, long timeoutMs, std::string &error) {
+    auto deadline = clock_type::now() + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+    std::string payload;
+    while (true) {
+        int r = take_frame(inbuf, payload);
+        if (r < 0) {
+            error = "oversized frame";
+            return false;
+        }
+        if (r > 0) {
+            if (parse(payload, frame)) return true;
+            error = "bad frame: " + payload;
+            return false;
+        }
+        int waitMs = -1;
+        if (timeoutMs >= 0) {
+            waitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock_type::now()).count();
+            if (waitMs <= 0) {
+                error = "timeout";
+                return false;
+            }
+        }
+        pollfd p{fd, POLLIN, 0};
+        int pr = poll(&p, 1, waitMs);
+        if (pr < 0 && errno == EINTR) continue;
+        if (pr == 0) continue;
+        char buf[16384];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            error = n == 0 ? "daemon closed the connection" : std::string("read: ") + strerror(errno);
+            return false;
+        }
+        inbuf.append(buf, (size_t)n);
+    }
+}
+
+bool DaemonClient::request(Json::Value req, Json::Value &reply, long timeoutMs, std::string &error) {
+    if (!req.isMember("id")) req["id"] = nextId++;
+    Json::Value id = req["id"];
+    if (!send(req, error)) return false;
+    auto deadline = clock_type::now() + std::chrono::milliseconds(timeoutMs);
+    while (true) {
+        long left = timeoutMs < 0 ? -1 : (long)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock_type::now()).count();
+        if (timeoutMs >= 0 && left <= 0) {
+            error = "timeout";
+            return false;
+        }
+        if (!receive(reply, left, error)) return false;
+        if (!reply.isMember("event") && reply["id"] == id) return true;
+    }
+}
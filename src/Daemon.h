@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <json/json.h>
+#include "EventListener.h"
+
+class StateCache;
+
+// Resident mode: one long-lived process keeps the controller connections and the event subscription
+// open and serves local clients on a Unix domain socket.
+//
+// Framing, both directions: u32 payload length (big endian) | UTF-8 JSON object. Frames over 1 MiB
+// close the connection. Requests carry an "id" that is echoed in their reply:
+//
+//   {"id":1,"cmd":"ping"}                                    -> {"id":1,"ok":true,"uptime_ms":..}
+//   {"id":2,"cmd":"call","method":"...","params":{..},"timeout_ms":6000}
+//                                                            -> {"id":2,"ok":..,"response":{..},"latency_us":..}
+//   {"id":3,"cmd":"subscribe","events":["onStateChange",..],"since":0}
+//                                                            -> {"id":3,"ok":true,"seq":<last event seq>}
+//   {"id":4,"cmd":"unsubscribe"}, {"id":5,"cmd":"stats"}, {"id":6,"cmd":"shutdown"}
+//   {"id":7,"cmd":"state"}                                   -> {"id":7,"ok":true,"state":{..}}  (StateCache, no RPC)
+//
+// After subscribe the connection also gets {"event":"<method>","seq":n,"params":{..}} for every
+// notification whose method (or its event name after the last '.') is listed; no "events" = all.
+// "since" first replays the retained events (last 1024) with a larger seq, so a client that
+// reconnects between test steps misses nothing. Calls run concurrently (json_rpc_async); replies
+// may come back out of order.
+class Daemon {
+public:
+    Daemon(const std::string &controllerUrl, EventListener &listener);
+    // stops if still running
+    ~Daemon();
+
+    // bind socketPath (a stale socket file is replaced, a live one is an error) and serve in the
+    // background. Sees every notification through listener's catch-all callback, calling the one already
+    // set (--print-events) after it; stop() puts that one back.
+    bool start(const std::string &socketPath, std::string &error);
+    // answer "state" from cache; call before start()
+    void setStateCache(const StateCache *cache);
+    // close every client, abort outstanding calls, remove the socket file
+    void stop();
+
+    // a client sent "shutdown"
+    bool shutdownRequested() const;
+
+    // {"clients":n,"subscribers":n,"calls":{"total","failed","in_flight"},"events":{"seq","dropped"},
+    //  "dispatch":{..},"connection":{..}}
+    Json::Value stats() const;
+
+private:
+    Daemon(const Daemon&) = delete;
+    Daemon &operator=(const Daemon&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
+
+// Blocking client side of the daemon protocol, for the --client mode.
+class DaemonClient {
+public:
+    DaemonClient();
+    ~DaemonClient();
+
+    bool connect(const std::string &socketPath, std::string &error);
+    // fills in a fresh "id" when request has none
+    bool send(Json::Value request, std::string &error);
+    // next frame (reply or event); false on timeout (timeoutMs < 0 = none), EOF or a bad frame
+    bool receive(Json::Value &frame, long timeoutMs, std::string &error);
+    // send + receive until the reply with the request's id arrives (events in between are dropped)
+    bool request(Json::Value request, Json::Value &reply, long timeoutMs, std::string &error);
+
+private:
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient &operator=(const DaemonClient&) = delete;
+
+    int fd;
+    int nextId;
+    std::string inbuf;
+};
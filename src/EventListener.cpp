@@ -1,71 +1,878 @@
 #include "EventListener.h"
+#include "Log.h"
+#include "BoundedQueue.h"
+#include "EventLog.h"
 #include <websocketpp/config/asio_no_tls_client.hpp>
+#ifdef MCAST_WITH_TLS
+#include <websocketpp/config/asio_client.hpp>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#endif
+#ifdef MCAST_WITH_DEFLATE
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#endif
 #include <websocketpp/client.hpp>
 #include <thread>
 #include <atomic>
-#include <iostream>
+#include <chrono>
+#include <condition_variable>
+#include <random>
+#include <set>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 using Json::Value;
+#ifdef MCAST_WITH_DEFLATE
+// Base plus the permessage-deflate extension: offered on every handshake, the server may decline
+template <typename Base>
+struct deflate_config : Base {
+    typedef deflate_config type;
+    typedef Base base;
+    typedef typename base::concurrency_type concurrency_type;
+    typedef typename base::request_type request_type;
+    typedef typename base::response_type response_type;
+    typedef typename base::message_type message_type;
+    typedef typename base::con_msg_manager_type con_msg_manager_type;
+    typedef typename base::endpoint_msg_manager_type endpoint_msg_manager_type;
+    typedef typename base::alog_type alog_type;
+    typedef typename base::elog_type elog_type;
+    typedef typename base::rng_type rng_type;
+    typedef typename base::transport_type transport_type;
+
+    struct permessage_deflate_config {};
+    typedef websocketpp::extensions::permessage_deflate::enabled<permessage_deflate_config> permessage_deflate_type;
+};
+typedef websocketpp::client<deflate_config<websocketpp::config::asio_client>> ws_client;
+#ifdef MCAST_WITH_TLS
+typedef websocketpp::client<deflate_config<websocketpp::config::asio_tls_client>> wss_client;
+#endif
+#else
 typedef websocketpp::client<websocketpp::config::asio_client> ws_client;
+#ifdef MCAST_WITH_TLS
+typedef websocketpp::client<websocketpp::config::asio_tls_client> wss_client;
+#endif
+#endif
+typedef std::chrono::steady_clock clock_type;
+
+// how often outstanding requests are checked for expiry
+static const long kRequestSweepMs = 20;
+// longest an idle dispatch worker sleeps before looking at the queue again
+static const long kWorkerIdleCheckMs = 50;
+// ids of requests the listener encodes itself; below are those encoded by the caller (next_rpc_id)
+static const uint32_t kOwnIdBase = 1u << 31;
+
+// set on threads that deliver callbacks; blocking on a reply there would deadlock
+static thread_local bool callbackThread = false;
+
+// Find the top-level "method" string of a JSON object without building a DOM.
+// Returns false if there is none (a response to one of our requests).
+static bool peek_method(const std::string &s, std::string &method) {
+    int depth = 0;
+    size_t i = 0, n = s.size();
+    while (i < n) {
+        char c = s[i];
+        if (c == '"') {
+            size_t start = ++i;
+            while (i < n && s[i] != '"') i += (s[i] == '\\') ? 2 : 1;
+            if (i >= n) return false;
+            size_t len = i - start;
+            ++i;
+            if (depth != 1 || len != 6 || s.compare(start, 6, "method") != 0) continue;
+            while (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) ++i;
+            if (i >= n || s[i] != ':') continue;  // "method" was a value, not a key
+            ++i;
+            while (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) ++i;
+            if (i >= n || s[i] != '"') return false;
+            size_t vstart = ++i;
+            while (i < n && s[i] != '"') i += (s[i] == '\\') ? 2 : 1;
+            if (i >= n) return false;
+            method.assign(s, vstart, i - vstart);
+            return true;
+        }
+        if (c == '{' || c == '[') ++depth;
+        else if (c == '}' || c == ']') --depth;
+        ++i;
+    }
+    return false;
+}
+
+struct EventLoop::Impl {
+    websocketpp::lib::asio::io_service ios;
+    std::unique_ptr<websocketpp::lib::asio::io_service::work> work;
+    std::thread runner;
+};
+
+EventLoop::EventLoop() : pimpl(new Impl()) {}
+EventLoop::~EventLoop() { stop(); delete pimpl; }
+
+void EventLoop::start() {
+    if (pimpl->runner.joinable()) return;
+    pimpl->ios.reset();
+    pimpl->work.reset(new websocketpp::lib::asio::io_service::work(pimpl->ios));
+    pimpl->runner = std::thread([this]{
+        callbackThread = true;
+        try {
+            pimpl->ios.run();
+        } catch (const std::exception &e) {
+            LogLine(LogLevel::Error, "EventLoop") << "run exception: " << e.what();
+        }
+    });
+}
+
+void EventLoop::stop() {
+    pimpl->work.reset();
+    pimpl->ios.stop();
+    if (pimpl->runner.joinable()) pimpl->runner.join();
+}
+
+void EventLoop::schedule(unsigned delayMs, std::function<void()> fn) {
+    auto timer = std::make_shared<websocketpp::lib::asio::steady_timer>(pimpl->ios, std::chrono::milliseconds(delayMs));
+    timer->async_wait([timer, fn](const auto &ec){
+        if (!ec) fn();
+    });
+}
 
 struct EventListener::Impl {
     std::string uri;
+    bool sharedLoop;          // I/O runs on an EventLoop owned by someone else
+    bool secure;              // wss://
+    std::string host;         // for SNI and certificate host name checks
     ws_client client;
+#ifdef MCAST_WITH_TLS
+    wss_client tlsClient;
+    TlsOptions tlsOpts;
+    std::mutex tlsMutex;
+    websocketpp::lib::shared_ptr<websocketpp::lib::asio::ssl::context> tlsContext;  // one per listener: keeps the session cache
+    SSL_SESSION *tlsSession = nullptr;   // last session/ticket the server issued
+#endif
     websocketpp::connection_hdl hdl;
     std::thread runner;
     std::atomic<bool> running;
-    std::function<void(const Value&)> callback;
+    std::atomic<bool> connected;
+    std::mutex connMutex;
+    std::condition_variable connCv;
+
+    // notification routing table; replaced copy-on-write so workers read it without locking
+    struct Routes {
+        std::function<void(const Value&)> catchAll;
+        std::unordered_map<std::string, std::vector<EventHandler>> byMethod;  // "callsign.event"
+    };
+    std::mutex routesMutex;  // serializes writers
+    std::shared_ptr<const Routes> routes;
+
+    // dispatch pipeline: I/O thread -> bounded queue -> worker threads
+    struct Frame {
+        std::string payload;
+        clock_type::time_point received;
+    };
+    DispatchOptions dispatchOpts;
+    std::unique_ptr<BoundedQueue<Frame>> queue;
+    std::vector<std::thread> workers;
+    std::mutex workMutex;
+    std::condition_variable workCv;
+    std::atomic<int> sleepers;
+    bool stopWorkers;
+    std::atomic<uint64_t> received, dispatched, dropped, skipped, parseErrors, handlerErrors;
+    std::atomic<uint64_t> latencySumUs, maxLatencyUs;
+    std::atomic<size_t> maxDepth;
+    std::mutex workersMutex;  // start()/stop() vs replay() bringing workers up and down
+
+    // capture / replay
+    std::shared_ptr<EventLogWriter> capture;  // read by the I/O thread with atomic_load
+    std::atomic<bool> replaying, stopReplay;
+
+    // reconnect / registration state
+    ReconnectOptions reconnectOpts;
+    unsigned backoffAttempt;                  // I/O thread only
+    std::minstd_rand rng;                     // I/O thread only
+    std::mutex timerMutex;
+    std::shared_ptr<websocketpp::lib::asio::steady_timer> reconnectTimer;  // backoff in progress, cancelled by stop()
+    std::mutex subsMutex;
+    std::set<std::string> subscriptions;      // "callsign.event" registered without a handler
+    std::mutex statsMutex;
+    ConnectionStats connStats;
+    uint64_t tlsFullSumUs = 0, tlsResumedSumUs = 0;
+    clock_type::time_point connectStart, tcpDone, tlsDone;   // I/O thread only
+    clock_type::time_point disconnectedAt;    // start of the current gap (epoch if none)
+    std::function<void(bool, uint64_t)> connectionCallback;
+
+    // outstanding requests keyed by JSON-RPC id
+    struct Pending {
+        std::function<void(const RpcReply&)> cb;
+        clock_type::time_point deadline;
+    };
+    std::atomic<uint32_t> nextId;
+    std::mutex pendingMutex;
+    std::unordered_map<uint32_t, Pending> pending;
 
-    Impl(const std::string &u): uri(u), running(false) {
+    Impl(const std::string &u, websocketpp::lib::asio::io_service *ios): uri(u), sharedLoop(ios != nullptr), running(false), connected(false), sleepers(0), stopWorkers(false),
+        received(0), dispatched(0), dropped(0), skipped(0), parseErrors(0), handlerErrors(0), latencySumUs(0), maxLatencyUs(0), maxDepth(0),
+        replaying(false), stopReplay(false), backoffAttempt(0), rng(std::random_device{}()), nextId(kOwnIdBase) {
+        secure = uri.compare(0, 6, "wss://") == 0;
+        host = uri_host(uri);
         client.clear_access_channels(websocketpp::log::alevel::all);
         client.clear_error_channels(websocketpp::log::elevel::all);
-        client.init_asio();
+        if (ios) client.init_asio(ios);
+        else client.init_asio();
+#ifdef MCAST_WITH_TLS
+        tlsClient.clear_access_channels(websocketpp::log::alevel::all);
+        tlsClient.clear_error_channels(websocketpp::log::elevel::all);
+        if (ios) tlsClient.init_asio(ios);
+        else tlsClient.init_asio();
+#endif
+        auto r = std::make_shared<Routes>();
+        // a plugin drops its registrations when deactivated: register again once it is back
+        r->byMethod["Controller.statechange"].push_back([this](const Value &params, EventTime){
+            if (!connected || params["state"].asString() != "Activated") return;
+            std::string prefix = params["callsign"].asString() + ".";
+            for (const auto &key : subscribed_keys()) {
+                if (key.compare(0, prefix.size(), prefix) == 0) register_event(key);
+            }
+        });
+        routes = r;
+    }
+
+    template <typename F>
+    void update_routes(F change) {
+        std::lock_guard<std::mutex> g(routesMutex);
+        auto next = std::make_shared<Routes>(*std::atomic_load(&routes));
+        change(*next);
+        std::atomic_store(&routes, std::shared_ptr<const Routes>(std::move(next)));
+    }
+
+    // handlers for a notification method, or nullptr. "callsign.N.event" (versioned designator) is
+    // the only alias; the event name alone would catch other plugins' events of the same name
+    static const std::vector<EventHandler> *find_handlers(const Routes &r, const std::string &method) {
+        auto it = r.byMethod.find(method);
+        if (it != r.byMethod.end()) return &it->second;
+        size_t dot = method.rfind('.');
+        if (dot == std::string::npos || dot == 0) return nullptr;
+        size_t ver = method.rfind('.', dot - 1);
+        if (ver == std::string::npos || ver + 1 == dot) return nullptr;
+        for (size_t i = ver + 1; i < dot; ++i) {
+            if (method[i] < '0' || method[i] > '9') return nullptr;
+        }
+        it = r.byMethod.find(method.substr(0, ver) + method.substr(dot));
+        return it != r.byMethod.end() ? &it->second : nullptr;
     }
 
     ~Impl() {
         stop();
+#ifdef MCAST_WITH_TLS
+        if (tlsSession) SSL_SESSION_free(tlsSession);
+#endif
+    }
+
+    // ws://host:port/path -> host ([v6] without brackets)
+    static std::string uri_host(const std::string &u) {
+        size_t b = u.find("://");
+        b = b == std::string::npos ? 0 : b + 3;
+        if (b < u.size() && u[b] == '[') {
+            size_t e = u.find(']', b);
+            return u.substr(b + 1, e == std::string::npos ? std::string::npos : e - b - 1);
+        }
+        size_t e = u.find_first_of(":/", b);
+        return u.substr(b, e == std::string::npos ? std::string::npos : e - b);
+    }
+
+    // run f on the client matching the URI scheme
+    template <typename F>
+    void with_client(F f) {
+#ifdef MCAST_WITH_TLS
+        if (secure) {
+            f(tlsClient);
+            return;
+        }
+#endif
+        f(client);
+    }
+
+    static bool tls_reused(ws_client &, websocketpp::connection_hdl) { return false; }
+
+#ifdef MCAST_WITH_TLS
+    static bool tls_reused(wss_client &c, websocketpp::connection_hdl h) {
+        websocketpp::lib::error_code ec;
+        auto con = c.get_con_from_hdl(h, ec);
+        return con && SSL_session_reused(con->get_socket().native_handle());
+    }
+
+    // OpenSSL new-session callback (client cache mode): keep the newest session for the next connect
+    static int on_new_session(SSL *ssl, SSL_SESSION *session) {
+        Impl *self = static_cast<Impl*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        std::lock_guard<std::mutex> g(self->tlsMutex);
+        if (self->tlsSession) SSL_SESSION_free(self->tlsSession);
+        self->tlsSession = session;
+        return 1;  // we own the reference now
+    }
+
+    websocketpp::lib::shared_ptr<websocketpp::lib::asio::ssl::context> tls_context() {
+        namespace ssl = websocketpp::lib::asio::ssl;
+        std::lock_guard<std::mutex> g(tlsMutex);
+        if (tlsContext) return tlsContext;
+        auto ctx = websocketpp::lib::make_shared<ssl::context>(ssl::context::tls_client);
+        ctx->set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 | ssl::context::no_sslv3
+                         | ssl::context::no_tlsv1 | ssl::context::no_tlsv1_1);
+        boost::system::error_code ec;
+        if (tlsOpts.verifyPeer) {
+            ctx->set_verify_mode(ssl::verify_peer, ec);
+            if (tlsOpts.caFile.empty()) ctx->set_default_verify_paths(ec);
+            else ctx->load_verify_file(tlsOpts.caFile, ec);
+            if (ec) LogLine(LogLevel::Error, "EventListener") << "TLS trust store " << tlsOpts.caFile << ": " << ec.message();
+        } else {
+            ctx->set_verify_mode(ssl::verify_none, ec);
+        }
+        if (tlsOpts.sessionResumption) {
+            SSL_CTX *native = ctx->native_handle();
+            SSL_CTX_set_app_data(native, this);
+            SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(native, &Impl::on_new_session);
+        }
+        tlsContext = ctx;
+        return ctx;
     }
 
-    void on_message(websocketpp::connection_hdl, ws_client::message_ptr msg) {
-        std::string payload = msg->get_payload();
+    // before the handshake: SNI, host name check, last session
+    void init_tls_socket(SSL *ssl) {
+        unsigned char addr[16];
+        bool literal = inet_pton(AF_INET, host.c_str(), addr) == 1 || inet_pton(AF_INET6, host.c_str(), addr) == 1;
+        if (!literal) SSL_set_tlsext_host_name(ssl, host.c_str());
+        if (tlsOpts.verifyPeer) {
+            if (literal) X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), host.c_str());
+            else SSL_set1_host(ssl, host.c_str());
+        }
+        std::lock_guard<std::mutex> g(tlsMutex);
+        if (tlsOpts.sessionResumption && tlsSession) SSL_set_session(ssl, tlsSession);
+    }
+#endif
+
+    void set_connected(bool c) {
+        {
+            std::lock_guard<std::mutex> g(connMutex);
+            connected = c;
+        }
+        connCv.notify_all();
+    }
+
+    // remove and return the pending entry for id (empty cb if unknown / already completed)
+    std::function<void(const RpcReply&)> take_pending(uint32_t id) {
+        std::lock_guard<std::mutex> g(pendingMutex);
+        auto it = pending.find(id);
+        if (it == pending.end()) return nullptr;
+        auto cb = std::move(it->second.cb);
+        pending.erase(it);
+        return cb;
+    }
+
+    // complete every outstanding request with an error
+    void fail_all_pending(const std::string &why) {
+        std::unordered_map<uint32_t, Pending> drained;
+        {
+            std::lock_guard<std::mutex> g(pendingMutex);
+            drained.swap(pending);
+        }
+        RpcReply r;
+        r.error = why;
+        for (auto &p : drained) if (p.second.cb) p.second.cb(r);
+    }
+
+    void expire_pending() {
+        std::vector<std::function<void(const RpcReply&)>> expired;
+        auto now = clock_type::now();
+        {
+            std::lock_guard<std::mutex> g(pendingMutex);
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (it->second.deadline <= now) {
+                    expired.push_back(std::move(it->second.cb));
+                    it = pending.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        RpcReply r;
+        r.error = "timeout";
+        for (auto &cb : expired) if (cb) cb(r);
+    }
+
+    void schedule_sweep() {
+        with_client([this](auto &c) {
+            c.set_timer(kRequestSweepMs, [this](const websocketpp::lib::error_code &ec) {
+                if (ec || !running) return;
+                expire_pending();
+                schedule_sweep();
+            });
+        });
+    }
+
+    // I/O thread: only move the raw frame into the queue
+    template <typename MessagePtr>
+    void on_message(websocketpp::connection_hdl, MessagePtr msg) {
+        Frame f;
+        f.payload = std::move(msg->get_raw_payload());
+        f.received = clock_type::now();
+        auto cap = std::atomic_load(&capture);
+        if (cap) {
+            uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(f.received.time_since_epoch()).count();
+            if (!cap->append(ns, f.payload.data(), f.payload.size())) {
+                LogLine(LogLevel::Error, "EventListener") << "capture write failed, capture stopped";
+                std::shared_ptr<EventLogWriter> none;
+                std::atomic_store(&capture, none);
+            }
+        }
+        enqueue(std::move(f));
+    }
+
+    void enqueue(Frame &&f) {
+        received.fetch_add(1, std::memory_order_relaxed);
+        while (!queue->try_push(std::move(f))) {
+            if (dispatchOpts.overflow == DispatchOptions::Overflow::DropNewest) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else if (dispatchOpts.overflow == DispatchOptions::Overflow::DropOldest) {
+                Frame old;
+                if (queue->try_pop(old)) dropped.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                // Block: stall socket reads until a worker frees a slot; a frame abandoned on shutdown
+                // counts as dropped, or replay() would wait for it forever
+                if (!running && !replaying) {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+        size_t depth = queue->size();
+        size_t prevMax = maxDepth.load(std::memory_order_relaxed);
+        while (depth > prevMax && !maxDepth.compare_exchange_weak(prevMax, depth, std::memory_order_relaxed)) {}
+        // pairs with the fence in worker_loop: the push must be visible before sleepers is read, or a
+        // worker that just checked an empty queue goes to sleep unnotified
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> g(workMutex);
+            workCv.notify_one();
+        }
+    }
+
+    void worker_loop() {
+        callbackThread = true;
+        // one reader per worker, reused for every frame
         Json::CharReaderBuilder b;
-        std::string errs;
-        Value j;
         std::unique_ptr<Json::CharReader> reader(b.newCharReader());
-        if (reader->parse(payload.c_str(), payload.c_str() + payload.size(), &j, &errs)) {
-            if (callback) callback(j);
-        } else {
-            std::cerr << "[EventListener] JSON parse error: " << errs << "\n";
+        std::string errs;
+        std::string method;
+        Frame f;
+        while (true) {
+            if (!queue->try_pop(f)) {
+                std::unique_lock<std::mutex> lk(workMutex);
+                ++sleepers;
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                // bounded, in case a wakeup is missed anyway
+                workCv.wait_for(lk, std::chrono::milliseconds(kWorkerIdleCheckMs), [this]{ return !queue->empty() || stopWorkers; });
+                --sleepers;
+                if (stopWorkers) return;
+                continue;
+            }
+            uint64_t waitUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - f.received).count();
+            latencySumUs.fetch_add(waitUs, std::memory_order_relaxed);
+            uint64_t prevMax = maxLatencyUs.load(std::memory_order_relaxed);
+            while (waitUs > prevMax && !maxLatencyUs.compare_exchange_weak(prevMax, waitUs, std::memory_order_relaxed)) {}
+
+            // look at the top-level "method" before building a DOM: unrouted notifications are dropped here
+            auto r = std::atomic_load(&routes);
+            const std::vector<EventHandler> *handlers = nullptr;
+            bool notification = peek_method(f.payload, method);
+            if (notification) {
+                handlers = find_handlers(*r, method);
+                if (!handlers && !r->catchAll) {
+                    skipped.fetch_add(1, std::memory_order_relaxed);
+                    dispatched.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+            }
+
+            Value j;
+            errs.clear();
+            if (reader->parse(f.payload.data(), f.payload.data() + f.payload.size(), &j, &errs)) {
+                if (!notification) {
+                    deliver_reply(j, f.payload);
+                } else {
+                    if (handlers) {
+                        const Value &params = j["params"];
+                        for (const auto &h : *handlers) guarded(method, [&]{ h(params, f.received); });
+                    }
+                    if (r->catchAll) guarded(method, [&]{ r->catchAll(j); });
+                }
+            } else {
+                parseErrors.fetch_add(1, std::memory_order_relaxed);
+                LogLine(LogLevel::Warn, "EventListener") << "JSON parse error: " << errs;
+            }
+            dispatched.fetch_add(1, std::memory_order_relaxed);
         }
     }
 
-    bool start() {
-        if (running.exchange(true)) return true;
+    // a throwing callback is logged and counted; it must not take the worker, and the tool, down
+    template <typename F>
+    void guarded(const std::string &what, F &&call) {
         try {
-            client.set_message_handler([this](websocketpp::connection_hdl h, ws_client::message_ptr msg){
-                this->on_message(h, msg);
+            call();
+        } catch (const std::exception &e) {
+            handlerErrors.fetch_add(1, std::memory_order_relaxed);
+            LogLine(LogLevel::Error, "EventListener") << "handler for " << what << " threw: " << e.what();
+        } catch (...) {
+            handlerErrors.fetch_add(1, std::memory_order_relaxed);
+            LogLine(LogLevel::Error, "EventListener") << "handler for " << what << " threw";
+        }
+    }
+
+    // responses carry our id and no method
+    void deliver_reply(Value &j, std::string &text) {
+        if (j.isObject() && j.isMember("id") && j["id"].isUInt()) {
+            auto cb = take_pending(j["id"].asUInt());
+            if (cb) {
+                RpcReply r;
+                r.ok = true;
+                r.response = std::move(j);
+                r.text = std::move(text);
+                guarded("reply", [&]{ cb(r); });
+            }
+        }
+    }
+
+    void start_workers() {
+        if (!workers.empty()) return;
+        queue.reset(new BoundedQueue<Frame>(dispatchOpts.queueCapacity));
+        stopWorkers = false;
+        unsigned n = dispatchOpts.workers ? dispatchOpts.workers : 1;
+        for (unsigned i = 0; i < n; ++i) workers.emplace_back([this]{ worker_loop(); });
+    }
+
+    void stop_workers() {
+        {
+            std::lock_guard<std::mutex> g(workMutex);
+            stopWorkers = true;
+        }
+        workCv.notify_all();
+        for (auto &w : workers) if (w.joinable()) w.join();
+        workers.clear();
+    }
+
+    DispatchStats stats() const {
+        DispatchStats st;
+        st.received = received.load();
+        st.dispatched = dispatched.load();
+        st.dropped = dropped.load();
+        st.skipped = skipped.load();
+        st.parseErrors = parseErrors.load();
+        st.handlerErrors = handlerErrors.load();
+        st.queueDepth = queue ? queue->size() : 0;
+        st.maxQueueDepth = maxDepth.load();
+        st.avgLatencyUs = st.dispatched ? (double)latencySumUs.load() / st.dispatched : 0.0;
+        st.maxLatencyUs = maxLatencyUs.load();
+        return st;
+    }
+
+    void request(const std::string &method, const Value &params,
+                 std::function<void(const RpcReply&)> cb, unsigned timeoutMs) {
+        uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+        Value payload;
+        payload["jsonrpc"] = "2.0";
+        payload["id"] = id;
+        payload["method"] = method;
+        payload["params"] = params;
+        Json::StreamWriterBuilder w;
+        w["indentation"] = "";
+        send_request(id, Json::writeString(w, payload), std::move(cb), timeoutMs);
+    }
+
+    void send_request(uint32_t id, const std::string &payloadStr, std::function<void(const RpcReply&)> cb, unsigned timeoutMs) {
+        if (!connected) {
+            RpcReply r;
+            r.error = "not connected";
+            if (cb) cb(r);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> g(pendingMutex);
+            pending[id] = Pending{std::move(cb), clock_type::now() + std::chrono::milliseconds(timeoutMs)};
+        }
+        websocketpp::lib::error_code ec;
+        {
+            std::lock_guard<std::mutex> g(connMutex);
+            with_client([&](auto &c) { c.send(hdl, payloadStr, websocketpp::frame::opcode::text, ec); });
+        }
+        if (ec) {
+            auto failed = take_pending(id);
+            if (failed) {
+                RpcReply r;
+                r.error = "send failed: " + ec.message();
+                failed(r);
+            }
+        }
+    }
+
+    // "callsign.event" keys we register for on every (re)connect
+    std::set<std::string> subscribed_keys() {
+        std::set<std::string> keys;
+        {
+            std::lock_guard<std::mutex> g(subsMutex);
+            keys = subscriptions;
+        }
+        auto r = std::atomic_load(&routes);
+        for (const auto &m : r->byMethod) keys.insert(m.first);
+        return keys;
+    }
+
+    // Thunder "register": events then arrive as "<id>.<event>"; we use the callsign as id so
+    // notifications match the "<callsign>.<event>" routing keys exactly
+    void register_event(const std::string &key) {
+        auto dot = key.rfind('.');
+        if (dot == std::string::npos) return;
+        std::string callsign = key.substr(0, dot);
+        Value params;
+        params["event"] = key.substr(dot + 1);
+        params["id"] = callsign;
+        request(callsign + ".1.register", params, [key](const RpcReply &r){
+            if (!r.ok || r.response.isMember("error")) {
+                LogLine(LogLevel::Warn, "EventListener") << "register " << key << " failed: "
+                    << (r.ok ? r.response["error"]["message"].asString() : r.error)
+                    << " (retried when the plugin is activated)";
+            }
+        }, 3000);
+    }
+
+    template <typename Client>
+    void on_open(Client &c, websocketpp::connection_hdl h) {
+        auto now = clock_type::now();
+        auto us = [](clock_type::time_point from, clock_type::time_point to) {
+            return from == clock_type::time_point() || to < from ? (uint64_t)0
+                : (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+        };
+        HandshakeTiming t;
+        t.tcpUs = us(connectStart, tcpDone);
+        if (secure) t.tlsUs = us(tcpDone, tlsDone);
+        t.wsUs = us(tlsDone != clock_type::time_point() ? tlsDone : tcpDone, now);
+        t.totalUs = us(connectStart, now);
+        bool resumed = tls_reused(c, h);
+        bool deflate = false;
+        {
+            websocketpp::lib::error_code ec;
+            auto con = c.get_con_from_hdl(h, ec);
+            if (con) deflate = con->get_response_header("Sec-WebSocket-Extensions").find("permessage-deflate") != std::string::npos;
+        }
+        uint64_t gapUs = 0;
+        {
+            std::lock_guard<std::mutex> g(statsMutex);
+            connStats.secure = secure;
+            connStats.deflate = deflate;
+            connStats.lastHandshake = t;
+            if (secure && resumed) {
+                ++connStats.tlsResumed;
+                tlsResumedSumUs += t.tlsUs;
+            } else if (secure) {
+                ++connStats.tlsFull;
+                tlsFullSumUs += t.tlsUs;
+            }
+            ++connStats.connects;
+            if (disconnectedAt != clock_type::time_point()) {
+                gapUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - disconnectedAt).count();
+                ++connStats.reconnects;
+                connStats.lastGapUs = gapUs;
+                connStats.totalGapUs += gapUs;
+                connStats.maxGapUs = std::max(connStats.maxGapUs, gapUs);
+                disconnectedAt = clock_type::time_point();
+            }
+        }
+        backoffAttempt = 0;
+        set_connected(true);
+        if (gapUs) {
+            LogLine(LogLevel::Info, "EventListener") << "reconnected after " << gapUs / 1000 << "ms without events (handshake "
+                << t.totalUs / 1000.0 << "ms" << (secure ? (resumed ? ", TLS resumed" : ", full TLS") : "") << ")";
+        }
+        for (const auto &key : subscribed_keys()) register_event(key);
+        auto cb = connectionCallback;
+        if (cb) cb(true, gapUs);
+    }
+
+    void on_disconnect(const char *why) {
+        bool wasConnected = connected.exchange(false);
+        if (wasConnected) {
+            std::lock_guard<std::mutex> g(statsMutex);
+            disconnectedAt = clock_type::now();
+        }
+        set_connected(false);
+        fail_all_pending(why);
+        if (wasConnected) {
+            if (running) LogLine(LogLevel::Warn, "EventListener") << why << (reconnectOpts.enabled ? ", reconnecting" : "");
+            auto cb = connectionCallback;
+            if (cb) cb(false, 0);
+        }
+        if (running && reconnectOpts.enabled) schedule_reconnect();
+    }
+
+    // jittered exponential backoff: uniform in [d/2, d], d = initial * multiplier^attempt capped at max
+    void schedule_reconnect() {
+        double d = reconnectOpts.initialBackoffMs;
+        for (unsigned i = 0; i < backoffAttempt && d < reconnectOpts.maxBackoffMs; ++i) d *= reconnectOpts.multiplier;
+        d = std::min(d, (double)reconnectOpts.maxBackoffMs);
+        std::uniform_real_distribution<double> jitter(d / 2, d);
+        long delayMs = std::max(1L, (long)jitter(rng));
+        ++backoffAttempt;
+        with_client([this, delayMs](auto &c) {
+            auto timer = c.set_timer(delayMs, [this](const websocketpp::lib::error_code &ec){
+                if (ec || !running) return;
+                connect_once();
             });
+            std::lock_guard<std::mutex> g(timerMutex);
+            reconnectTimer = timer;
+        });
+        // stop() may have looked for the timer before it was stored
+        if (!running) cancel_reconnect();
+    }
+
+    // a backoff can be up to maxBackoffMs; without this the I/O loop (and stop) would wait it out
+    void cancel_reconnect() {
+        std::shared_ptr<websocketpp::lib::asio::steady_timer> timer;
+        {
+            std::lock_guard<std::mutex> g(timerMutex);
+            timer.swap(reconnectTimer);
+        }
+        if (!timer) return;
+        // on the I/O thread, which owns the timer
+        with_client([timer](auto &c) {
+            c.get_io_service().post([timer]{
+                boost::system::error_code ec;
+                timer->cancel(ec);
+            });
+        });
+    }
 
+    bool connect_once() {
+        bool ok = false;
+        connectStart = clock_type::now();
+        tcpDone = tlsDone = clock_type::time_point();
+        with_client([&](auto &c) {
             websocketpp::lib::error_code ec;
-            ws_client::connection_ptr con = client.get_connection(uri, ec);
+            auto con = c.get_connection(uri, ec);
             if (ec) {
-                std::cerr << "[EventListener] get_connection failed: " << ec.message() << "\n";
+                LogLine(LogLevel::Warn, "EventListener") << "get_connection failed: " << ec.message();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> g(connMutex);
+                hdl = con->get_handle();
+            }
+            c.connect(con);
+            ok = true;
+        });
+        return ok;
+    }
+
+    bool replay(const std::string &path, double speed, ReplayStats &st, std::string &error) {
+        EventLogReader log;
+        if (!log.open(path, error)) return false;
+        if (replaying.exchange(true)) { error = "a replay is already running"; return false; }
+        stopReplay = false;
+        {
+            std::lock_guard<std::mutex> g(workersMutex);
+            start_workers();
+        }
+        st = ReplayStats();
+        uint64_t droppedBefore = dropped.load();
+        EventLogRecord rec;
+        uint64_t prevNs = 0, offsetNs = 0;  // recorded time since the first frame; gaps never go backwards
+        auto t0 = clock_type::now();
+        while (!stopReplay && log.next(rec)) {
+            if (st.frames) offsetNs += rec.steadyNs > prevNs ? rec.steadyNs - prevNs : 0;
+            prevNs = rec.steadyNs;
+            if (speed > 0) {
+                auto due = t0 + std::chrono::nanoseconds((uint64_t)(offsetNs / speed));
+                while (!stopReplay && clock_type::now() < due) {
+                    std::this_thread::sleep_until(std::min(due, clock_type::now() + std::chrono::milliseconds(100)));
+                }
+                if (stopReplay) break;
+                uint64_t lagUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - due).count();
+                st.maxLagUs = std::max(st.maxLagUs, lagUs);
+            }
+            Frame f;
+            f.payload.assign(rec.data, rec.len);
+            f.received = clock_type::now();
+            enqueue(std::move(f));
+            ++st.frames;
+            st.bytes += rec.len;
+        }
+        // wait for the workers to catch up
+        while (!stopReplay && (!queue->empty() || dispatched.load() + dropped.load() < received.load())) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        st.elapsedS = std::chrono::duration<double>(clock_type::now() - t0).count();
+        st.dropped = dropped.load() - droppedBefore;
+        {
+            std::lock_guard<std::mutex> g(workersMutex);
+            if (!running) stop_workers();
+        }
+        replaying = false;
+        return true;
+    }
+
+    bool start() {
+        if (running.exchange(true)) return true;
+#ifndef MCAST_WITH_TLS
+        if (secure) {
+            LogLine(LogLevel::Error, "EventListener") << uri << ": wss:// needs a build with -DWITH_TLS=ON";
+            running = false;
+            return false;
+        }
+#else
+        if (secure) {
+            tlsClient.set_tls_init_handler([this](websocketpp::connection_hdl) { return tls_context(); });
+            tlsClient.set_socket_init_handler([this](websocketpp::connection_hdl,
+                    websocketpp::lib::asio::ssl::stream<websocketpp::lib::asio::ip::tcp::socket> &s) {
+                init_tls_socket(s.native_handle());
+            });
+        }
+#endif
+        try {
+            with_client([this](auto &c) {
+                typedef typename std::decay<decltype(c)>::type client_type;
+                client_type *cp = &c;
+                c.set_message_handler([this](websocketpp::connection_hdl h, typename client_type::message_ptr msg){
+                    this->on_message(h, msg);
+                });
+                // TCP connected, then (wss) TLS handshake done; the upgrade completes in the open handler
+                c.set_tcp_pre_init_handler([this](websocketpp::connection_hdl){ tcpDone = clock_type::now(); });
+                c.set_tcp_post_init_handler([this](websocketpp::connection_hdl){ tlsDone = clock_type::now(); });
+                c.set_open_handler([this, cp](websocketpp::connection_hdl h){ on_open(*cp, h); });
+                c.set_close_handler([this](websocketpp::connection_hdl){ on_disconnect("disconnected"); });
+                c.set_fail_handler([this](websocketpp::connection_hdl){ on_disconnect("connection failed"); });
+
+                // keep run() alive between connections so reconnects happen on the same thread
+                if (!sharedLoop) c.start_perpetual();
+            });
+            if (!connect_once()) {
+                if (!sharedLoop) with_client([](auto &c) { c.stop_perpetual(); });
                 running = false;
                 return false;
             }
-            hdl = con->get_handle();
-            client.connect(con);
+            {
+                std::lock_guard<std::mutex> g(workersMutex);
+                start_workers();
+            }
+            schedule_sweep();
 
+            if (sharedLoop) return true;
             runner = std::thread([this](){
+                callbackThread = true;
                 try {
-                    client.run();
+                    with_client([](auto &c) { c.run(); });
                 } catch (const std::exception &e) {
-                    std::cerr << "[EventListener] client.run exception: " << e.what() << "\n";
+                    LogLine(LogLevel::Error, "EventListener") << "client.run exception: " << e.what();
                 }
             });
             return true;
         } catch (const std::exception &e) {
-            std::cerr << "[EventListener] start exception: " << e.what() << "\n";
+            LogLine(LogLevel::Error, "EventListener") << "start exception: " << e.what();
             running = false;
             return false;
         }
@@ -75,19 +882,137 @@ struct EventListener::Impl {
         if (!running.exchange(false)) return;
         try {
             websocketpp::lib::error_code ec;
-            client.stop_perpetual();
-            client.close(hdl, websocketpp::close::status::normal, "shutdown", ec);
+            with_client([&](auto &c) {
+                if (!sharedLoop) c.stop_perpetual();
+                c.close(hdl, websocketpp::close::status::normal, "shutdown", ec);
+            });
+            cancel_reconnect();
             if (ec) {
                 // may fail if not connected
             }
         } catch (...) {}
         if (runner.joinable()) runner.join();
+        {
+            std::lock_guard<std::mutex> g(workersMutex);
+            if (!replaying) stop_workers();
+        }
+        set_connected(false);
+        fail_all_pending("stopped");
     }
 };
 
-EventListener::EventListener(const std::string &controllerWsUrl) : pimpl(new Impl(controllerWsUrl)) {}
+EventListener::EventListener(const std::string &controllerWsUrl) : pimpl(new Impl(controllerWsUrl, nullptr)) {}
+EventListener::EventListener(const std::string &controllerWsUrl, EventLoop &loop)
+    : pimpl(new Impl(controllerWsUrl, &loop.pimpl->ios)) {}
 EventListener::~EventListener() { delete pimpl; }
 
 bool EventListener::start() { return pimpl->start(); }
 void EventListener::stop() { pimpl->stop(); }
-void EventListener::setNotificationCallback(std::function<void(const Json::Value&)> cb) { pimpl->callback = cb; }
\ No newline at end of file
+bool EventListener::isConnected() const { return pimpl->connected; }
+bool EventListener::onCallbackThread() { return callbackThread; }
+
+void EventListener::setNotificationCallback(std::function<void(const Json::Value&)> cb) {
+    pimpl->update_routes([&](Impl::Routes &r){ r.catchAll = std::move(cb); });
+}
+
+std::function<void(const Json::Value&)> EventListener::notificationCallback() const {
+    return std::atomic_load(&pimpl->routes)->catchAll;
+}
+
+void EventListener::addEventHandler(const std::string &callsign, const std::string &event, EventHandler handler) {
+    std::string key = callsign + "." + event;
+    bool isNew = false;
+    pimpl->update_routes([&](Impl::Routes &r){
+        auto &list = r.byMethod[key];
+        isNew = list.empty();
+        list.push_back(std::move(handler));
+    });
+    if (isNew && pimpl->connected) pimpl->register_event(key);
+}
+
+void EventListener::subscribe(const std::string &callsign, const std::string &event) {
+    std::string key = callsign + "." + event;
+    bool isNew;
+    {
+        std::lock_guard<std::mutex> g(pimpl->subsMutex);
+        isNew = pimpl->subscriptions.insert(key).second;
+    }
+    if (isNew && pimpl->connected) pimpl->register_event(key);
+}
+
+void EventListener::setReconnectOptions(const ReconnectOptions &opts) { pimpl->reconnectOpts = opts; }
+
+void EventListener::setTlsOptions(const TlsOptions &opts) {
+#ifdef MCAST_WITH_TLS
+    pimpl->tlsOpts = opts;
+#else
+    (void)opts;
+#endif
+}
+
+bool EventListener::tlsSupported() {
+#ifdef MCAST_WITH_TLS
+    return true;
+#else
+    return false;
+#endif
+}
+void EventListener::setConnectionCallback(std::function<void(bool, uint64_t)> cb) { pimpl->connectionCallback = cb; }
+
+ConnectionStats EventListener::getConnectionStats() const {
+    std::lock_guard<std::mutex> g(pimpl->statsMutex);
+    ConnectionStats st = pimpl->connStats;
+    st.connected = pimpl->connected;
+    if (st.tlsFull) st.tlsFullAvgUs = pimpl->tlsFullSumUs / st.tlsFull;
+    if (st.tlsResumed) st.tlsResumedAvgUs = pimpl->tlsResumedSumUs / st.tlsResumed;
+    if (!st.connected && pimpl->disconnectedAt != clock_type::time_point()) {
+        st.currentGapUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - pimpl->disconnectedAt).count();
+    }
+    return st;
+}
+
+void EventListener::setDispatchOptions(const DispatchOptions &opts) { pimpl->dispatchOpts = opts; }
+DispatchStats EventListener::getDispatchStats() const { return pimpl->stats(); }
+
+bool EventListener::waitConnected(unsigned timeoutMs) {
+    std::unique_lock<std::mutex> lk(pimpl->connMutex);
+    pimpl->connCv.wait_for(lk, std::chrono::milliseconds(timeoutMs), [this]{ return pimpl->connected.load(); });
+    return pimpl->connected;
+}
+
+void EventListener::request(const std::string &method, const Json::Value &params,
+                            std::function<void(const RpcReply&)> cb, unsigned timeoutMs) {
+    pimpl->request(method, params, std::move(cb), timeoutMs);
+}
+
+bool EventListener::startCapture(const std::string &path, std::string &error) {
+    auto w = std::make_shared<EventLogWriter>();
+    if (!w->open(path, error)) return false;
+    std::atomic_store(&pimpl->capture, w);
+    return true;
+}
+
+void EventListener::stopCapture() {
+    std::shared_ptr<EventLogWriter> none;
+    std::atomic_store(&pimpl->capture, none);
+}
+
+bool EventListener::replay(const std::string &path, double speed, ReplayStats &stats, std::string &error) {
+    return pimpl->replay(path, speed, stats, error);
+}
+
+void EventListener::stopReplay() { pimpl->stopReplay = true; }
+
+std::future<RpcReply> EventListener::request(const std::string &method, const Json::Value &params, unsigned timeoutMs) {
+    auto promise = std::make_shared<std::promise<RpcReply>>();
+    std::future<RpcReply> f = promise->get_future();
+    pimpl->request(method, params, [promise](const RpcReply &r){ promise->set_value(r); }, timeoutMs);
+    return f;
+}
+
+std::future<RpcReply> EventListener::request(uint32_t id, const std::string &encoded, unsigned timeoutMs) {
+    auto promise = std::make_shared<std::promise<RpcReply>>();
+    std::future<RpcReply> f = promise->get_future();
+    pimpl->send_request(id, encoded, [promise](const RpcReply &r){ promise->set_value(r); }, timeoutMs);
+    return f;
+}
@@ -1,25 +1,197 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <string>
 #include <json/json.h>
 
+// reply to a JSON-RPC request sent over the event socket
+struct RpcReply {
+    bool ok = false;       // a response with the matching id arrived (it may still carry a JSON-RPC "error")
+    Json::Value response;  // full response object
+    std::string text;      // the response frame as received
+    std::string error;     // transport-level failure: "timeout", "not connected", ...
+};
+
+// how incoming frames are handed from the socket thread to callback workers
+struct DispatchOptions {
+    enum class Overflow {
+        DropNewest,  // discard the frame that does not fit
+        DropOldest,  // discard the oldest queued frame to make room
+        Block        // stall socket reads until there is room (backpressure)
+    };
+    size_t queueCapacity = 1024;  // rounded up to a power of two
+    unsigned workers = 1;         // parse/callback threads; >1 may reorder notifications
+    Overflow overflow = Overflow::DropOldest;
+};
+
+struct DispatchStats {
+    uint64_t received = 0;     // frames read from the socket
+    uint64_t dispatched = 0;   // frames parsed and delivered (or failed to parse)
+    uint64_t dropped = 0;      // frames discarded by the overflow policy
+    uint64_t skipped = 0;      // notifications nobody handles, dropped before parsing
+    uint64_t parseErrors = 0;
+    uint64_t handlerErrors = 0;   // handler or catch-all threw (logged, the frame counts as dispatched)
+    size_t queueDepth = 0;
+    size_t maxQueueDepth = 0;
+    double avgLatencyUs = 0;   // socket read -> worker pickup
+    uint64_t maxLatencyUs = 0;
+};
+
+// automatic reconnect after the socket drops (Thunder restart, plugin reactivation, ...)
+struct ReconnectOptions {
+    bool enabled = true;
+    unsigned initialBackoffMs = 50;   // first retry delay, jittered to [d/2, d]
+    unsigned maxBackoffMs = 5000;
+    double multiplier = 2.0;
+};
+
+// wss:// event sockets (builds with -DWITH_TLS=ON); call setTlsOptions before start()
+struct TlsOptions {
+    std::string caFile;            // PEM bundle; empty = system default paths
+    bool verifyPeer = true;        // certificate chain and host name
+    bool sessionResumption = true; // offer the last session (ticket) again on reconnect
+};
+
+// phases of the last opening handshake; tls is 0 on ws://
+struct HandshakeTiming {
+    uint64_t tcpUs = 0;     // connect start (including DNS) -> TCP connected
+    uint64_t tlsUs = 0;     // -> TLS handshake done
+    uint64_t wsUs = 0;      // -> WebSocket upgrade done
+    uint64_t totalUs = 0;
+};
+
+struct ConnectionStats {
+    bool connected = false;
+    uint64_t connects = 0;       // successful handshakes, including the first
+    uint64_t reconnects = 0;
+    uint64_t lastGapUs = 0;      // time without a connection before the last reconnect
+    uint64_t maxGapUs = 0;
+    uint64_t totalGapUs = 0;
+    uint64_t currentGapUs = 0;   // ongoing gap while disconnected
+    bool secure = false;         // wss://
+    bool deflate = false;        // permessage-deflate negotiated on the current connection
+    HandshakeTiming lastHandshake;
+    uint64_t tlsFull = 0, tlsResumed = 0;                 // TLS handshakes by kind
+    uint64_t tlsFullAvgUs = 0, tlsResumedAvgUs = 0;       // mean TLS phase of each kind
+};
+
+struct ReplayStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;     // discarded by the overflow policy while replaying
+    double elapsedS = 0;      // first frame injected -> last frame dispatched
+    uint64_t maxLagUs = 0;    // worst delay behind the recorded schedule (paced replay)
+};
+
+typedef std::chrono::steady_clock::time_point EventTime;
+
+// receives the "params" of a routed notification and the time its frame was read from the socket
+typedef std::function<void(const Json::Value &params, EventTime received)> EventHandler;
+
+// One I/O thread shared by many listeners (fleet mode) instead of a thread per listener.
+// Start it before or after the listeners; stop it only after every listener on it was stopped.
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+
+    void start();
+    void stop();
+
+    // run fn on the loop thread after delayMs
+    void schedule(unsigned delayMs, std::function<void()> fn);
+
+private:
+    EventLoop(const EventLoop&) = delete;
+    EventLoop &operator=(const EventLoop&) = delete;
+
+    friend class EventListener;
+    struct Impl;
+    Impl* pimpl;
+};
+
 class EventListener {
 public:
     // controllerWsUrl - ws:// or wss:// URL to subscribe to (e.g. ws://127.0.0.1:9998/jsonrpc)
     explicit EventListener(const std::string &controllerWsUrl);
+    // same, with socket I/O and timers on loop instead of an own thread
+    EventListener(const std::string &controllerWsUrl, EventLoop &loop);
     ~EventListener();
 
-    // start WebSocket client in background thread
+    // start WebSocket client in background thread (or on the EventLoop); it reconnects on its own until stop()
     bool start();
 
     // stop and join
     void stop();
 
-    // callback called on any JSON notification from server (Json::Value)
+    // true once the WebSocket handshake has completed
+    bool isConnected() const;
+
+    // block until connected or timeout expires; returns isConnected()
+    bool waitConnected(unsigned timeoutMs);
+
+    // true when called from a thread that delivers listener callbacks (do not block on replies there)
+    static bool onCallbackThread();
+
+    // callback called on any JSON notification from server (Json::Value), on a dispatch worker thread.
+    // While no catch-all callback is set, notifications without a handler are skipped unparsed.
     void setNotificationCallback(std::function<void(const Json::Value&)> cb);
+    // the one currently set (empty if none), e.g. to chain to it
+    std::function<void(const Json::Value&)> notificationCallback() const;
+
+    // route notifications with method "<callsign>.<event>" to handler; the versioned designator
+    // "<callsign>.<N>.<event>" is the same event. Other designators carrying the same event name are not.
+    // Safe to call while running. An exception thrown by a handler or the catch-all is logged and counted
+    // in DispatchStats::handlerErrors.
+    void addEventHandler(const std::string &callsign, const std::string &event, EventHandler handler);
+
+    // register "<callsign>.<event>" with Thunder on every (re)connect without adding a handler
+    // (events with handlers are registered automatically)
+    void subscribe(const std::string &callsign, const std::string &event);
+
+    // reconnect policy; call before start()
+    void setReconnectOptions(const ReconnectOptions &opts);
+    // certificate checks and session resumption for wss://; call before start()
+    void setTlsOptions(const TlsOptions &opts);
+    // false if this build cannot open wss:// sockets
+    static bool tlsSupported();
+    // called on the I/O thread on connect (gapUs = time spent disconnected, 0 the first time) and disconnect;
+    // set before start()
+    void setConnectionCallback(std::function<void(bool connected, uint64_t gapUs)> cb);
+    ConnectionStats getConnectionStats() const;
+
+    // configure the dispatch pipeline; call before start()
+    void setDispatchOptions(const DispatchOptions &opts);
+    DispatchStats getDispatchStats() const;
+
+    // append every frame read from the socket, stamped with its receive time, to an EventLog file
+    // (see EventLog.h). Safe to call while running.
+    bool startCapture(const std::string &path, std::string &error);
+    void stopCapture();
+
+    // feed a captured log through the dispatch pipeline as if its frames had just been read, so handlers
+    // and stats see them like live traffic. speed: 1 = recorded timing, N = N times faster, 0 = as fast as
+    // possible. Works on a stopped listener; blocks until every frame was dispatched or stopReplay().
+    bool replay(const std::string &path, double speed, ReplayStats &stats, std::string &error);
+    void stopReplay();
+
+    // send a JSON-RPC request on the socket; the reply is matched by "id" and delivered to cb
+    // (on a listener thread) or cb gets ok=false on timeout/disconnect. Many may be in flight.
+    void request(const std::string &method, const Json::Value &params,
+                 std::function<void(const RpcReply&)> cb, unsigned timeoutMs = 6000);
+
+    // same as above, future based
+    std::future<RpcReply> request(const std::string &method, const Json::Value &params, unsigned timeoutMs = 6000);
+
+    // a request the caller already encoded (see RpcMethods.h), written as is; id is the one in its envelope.
+    // Ids below 2^31 are the caller's: the listener numbers its own requests above that.
+    std::future<RpcReply> request(uint32_t id, const std::string &encoded, unsigned timeoutMs = 6000);
 
 private:
     struct Impl;
     Impl* pimpl;
-};
\ No newline at end of file
+};
@@ -0,0 +1,151 @@
+#include "EventLog.h"
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kMagic[8] = {'M', 'C', 'E', 'V', 'L', 'O', 'G', '1'};
+static const uint32_t kVersion = 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t wallNs;
+    uint64_t steadyNs;
+};
+
+struct RecordHeader {
+    uint64_t steadyNs;
+    uint32_t len;
+    uint32_t reserved;
+};
+
+static size_t padded(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+static bool write_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+EventLogWriter::EventLogWriter(): fd(-1), count(0), written(0) {}
+EventLogWriter::~EventLogWriter() { close(); }
+
+bool EventLogWriter::open(const std::string &path, std::string &error) {
+    close();
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) { error = path + ": " + strerror(errno); return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0) { error = path + ": " + strerror(errno); close(); return false; }
+    if (st.st_size == 0) {
+        FileHeader h;
+        memcpy(h.magic, kMagic, sizeof(kMagic));
+        h.version = kVersion;
+        h.headerSize = sizeof(FileHeader);
+        h.wallNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        h.steadyNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (!write_all(fd, (const char*)&h, sizeof(h))) { error = path + ": " + strerror(errno); close(); return false; }
+    } else {
+        // appending: the file must already be a log and end on a record boundary
+        FileHeader h;
+        int rfd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        bool valid = rfd >= 0 && ::read(rfd, &h, sizeof(h)) == (ssize_t)sizeof(h) &&
+                     memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.version == kVersion;
+        if (rfd >= 0) ::close(rfd);
+        if (!valid) { error = path + ": exists and is not an event log"; close(); return false; }
+        if (st.st_size % 8 != 0) { error = path + ": ends in a partial record"; close(); return false; }
+    }
+    return true;
+}
+
+void EventLogWriter::close() {
+    std::lock_guard<std::mutex> g(mtx);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+bool EventLogWriter::append(uint64_t steadyNs, const char *data, size_t len) {
+    if (len > UINT32_MAX) return false;
+    std::lock_guard<std::mutex> g(mtx);
+    if (fd < 0) return false;
+    RecordHeader r;
+    r.steadyNs = steadyNs;
+    r.len = (uint32_t)len;
+    r.reserved = 0;
+    size_t total = sizeof(r) + padded(len);
+    buf.assign((const char*)&r, sizeof(r));
+    buf.append(data, len);
+    buf.resize(total, '\0');
+    if (!write_all(fd, buf.data(), buf.size())) return false;
+    ++count;
+    written += total;
+    return true;
+}
+
+EventLogReader::EventLogReader(): base(nullptr), size(0), pos(0), start(0), wallNs(0), steadyNs(0) {}
+EventLogReader::~EventLogReader() { close(); }
+
+bool EventLogReader::open(const std::string &path, std::string &error) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { error = path + ": " + strerror(errno); return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FileHeader)) {
+        error = path + ": not an event log";
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) { error = path + ": mmap: " + strerror(errno); return false; }
+    base = (const char*)p;
+    size = (size_t)st.st_size;
+    const FileHeader *h = (const FileHeader*)base;
+    if (memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kVersion ||
+        h->headerSize < sizeof(FileHeader) || padded(h->headerSize) > size) {
+        error = path + ": not an event log";
+        close();
+        return false;
+    }
+    madvise(p, size, MADV_SEQUENTIAL);
+    wallNs = h->wallNs;
+    steadyNs = h->steadyNs;
+    start = pos = padded(h->headerSize);
+    return true;
+}
+
+void EventLogReader::close() {
+    if (base) munmap((void*)base, size);
+    base = nullptr;
+    size = pos = start = 0;
+}
+
+bool EventLogReader::next(EventLogRecord &rec) {
+    if (!base || size - pos < sizeof(RecordHeader)) return false;
+    const RecordHeader *r = (const RecordHeader*)(base + pos);
+    if (padded(r->len) > size - pos - sizeof(RecordHeader)) return false;
+    rec.steadyNs = r->steadyNs;
+    rec.len = r->len;
+    rec.data = base + pos + sizeof(RecordHeader);
+    pos += sizeof(RecordHeader) + padded(r->len);
+    return true;
+}
+
+void EventLogReader::rewind() {
+    pos = start;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Append-only log of raw event frames. Native-endian layout, every record 8-byte aligned so a
+// mapped file can be walked in place:
+//
+//   header  "MCEVLOG1" | u32 version | u32 header size | u64 wall clock ns | u64 steady clock ns   (at creation)
+//   record  u64 steady clock ns | u32 payload length | u32 reserved | payload | zero pad to 8
+//
+// A record cut short by a crash ends the log; everything before it stays readable.
+
+struct EventLogRecord {
+    uint64_t steadyNs;
+    const char *data;
+    uint32_t len;
+};
+
+class EventLogWriter {
+public:
+    EventLogWriter();
+    ~EventLogWriter();
+
+    // create path, or append to it if it already holds a log
+    bool open(const std::string &path, std::string &error);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    // one write(2) per record; thread safe
+    bool append(uint64_t steadyNs, const char *data, size_t len);
+
+    uint64_t records() const { return count; }
+    uint64_t bytes() const { return written; }
+
+private:
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter &operator=(const EventLogWriter&) = delete;
+
+    int fd;
+    std::mutex mtx;
+    std::string buf;  // reused record buffer
+    uint64_t count, written;
+};
+
+class EventLogReader {
+public:
+    EventLogReader();
+    ~EventLogReader();
+
+    // map path read-only
+    bool open(const std::string &path, std::string &error);
+    void close();
+
+    // next complete record; false at the end of the log
+    bool next(EventLogRecord &rec);
+    void rewind();
+
+    uint64_t wallNsAtCreation() const { return wallNs; }
+    uint64_t steadyNsAtCreation() const { return steadyNs; }
+
+private:
+    EventLogReader(const EventLogReader&) = delete;
+    EventLogReader &operator=(const EventLogReader&) = delete;
+
+    const char *base;
+    size_t size, pos, start;
+    uint64_t wallNs, steadyNs;
+};
@@ -0,0 +1,307 @@
+#include "Fleet.h"
+#include "Log.h"
+#include "EventListener.h"
+#include "LatencyHistogram.h"
+#include "Miracast.h"
+#include "MiracastEvents.h"
+#include "SessionTracker.h"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+typedef std::chrono::steady_clock clock_type;
+
+// longest an async RPC can stay outstanding (transport timeout) plus slack
+static const long kDrainMs = 7000;
+
+struct Device {
+    std::string url;
+    std::unique_ptr<SessionTracker> tracker;
+    std::unique_ptr<EventListener> listener;
+    LatencyHistogram rpcLatency;
+
+    std::mutex mtx;
+    std::string state = "idle";   // idle, bringup, ready, accepting, launching, play_request, playing, stopping, failed
+    std::string mac, name;        // current session
+    uint64_t requests = 0, rejected = 0, accepted = 0, launched = 0, playing = 0, stopped = 0;
+    uint64_t rpcErrors = 0, clientErrors = 0;
+};
+
+struct Fleet::Impl {
+    FleetOptions opts;
+    EventLoop loop;  // declared before devices: outlives their listeners
+    std::vector<std::unique_ptr<Device>> devices;
+    std::atomic<bool> stopping;
+    std::atomic<int> outstanding;
+
+    Impl(const std::vector<std::string> &urls, const FleetOptions &o): opts(o), stopping(false), outstanding(0) {
+        for (const auto &url : urls) {
+            std::unique_ptr<Device> d(new Device());
+            d->url = url;
+            d->tracker.reset(new SessionTracker(url));
+            d->listener.reset(new EventListener(http_to_ws(url), loop));
+            devices.push_back(std::move(d));
+        }
+    }
+
+    void set_state(Device &d, const char *state) {
+        std::lock_guard<std::mutex> g(d.mtx);
+        d.state = state;
+    }
+
+    // json_rpc_async with per-device latency/error accounting; done gets ok
+    void rpc(Device &d, const std::string &method, const Json::Value &params, std::function<void(bool)> done) {
+        if (stopping) return;
+        ++outstanding;
+        auto start = clock_type::now();
+        Device *dp = &d;
+        json_rpc_async(d.url, method, params, [this, dp, start, done](bool ok, const Json::Value &, const RpcTiming &) {
+            dp->rpcLatency.record((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count());
+            if (!ok) {
+                std::lock_guard<std::mutex> g(dp->mtx);
+                ++dp->rpcErrors;
+            }
+            if (done && !stopping) done(ok);
+            --outstanding;
+        });
+    }
+
+    void bring_up(Device &d) {
+        set_state(d, "bringup");
+        Device *dp = &d;
+        Json::Value service, player, enable;
+        service["callsign"] = kMiracastService;
+        player["callsign"] = kMiracastPlayer;
+        enable["enabled"] = true;
+        rpc(d, "Controller.activate", service, [this, dp, player, enable](bool ok) {
+            if (!ok) { set_state(*dp, "failed"); return; }
+            rpc(*dp, "Controller.activate", player, [this, dp, enable](bool ok) {
+                if (!ok) { set_state(*dp, "failed"); return; }
+                rpc(*dp, std::string(kMiracastService) + ".setEnable", enable, [this, dp](bool ok) {
+                    set_state(*dp, ok ? "ready" : "failed");
+                });
+            });
+        });
+    }
+
+    void on_request(Device &d, const ClientConnectionRequest &ev) {
+        bool accept;
+        {
+            std::lock_guard<std::mutex> g(d.mtx);
+            ++d.requests;
+            accept = d.state == "ready" && (!opts.maxSessions || d.stopped < opts.maxSessions);
+            if (accept) {
+                d.state = "accepting";
+                d.mac = ev.mac;
+                d.name = ev.name;
+            } else {
+                ++d.rejected;
+            }
+        }
+        Json::Value params;
+        params["requestStatus"] = accept ? "Accept" : "Reject";
+        Device *dp = &d;
+        rpc(d, std::string(kMiracastService) + ".acceptClientConnection", params, [this, dp, accept](bool ok) {
+            if (!accept) return;
+            std::lock_guard<std::mutex> g(dp->mtx);
+            if (ok) {
+                ++dp->accepted;
+                if (dp->state == "accepting") dp->state = "launching";
+            } else {
+                dp->state = "ready";
+            }
+        });
+    }
+
+    void on_launch(Device &d, const LaunchRequest &ev) {
+        {
+            std::lock_guard<std::mutex> g(d.mtx);
+            ++d.launched;
+            d.state = "play_request";
+        }
+        Json::Value params, dev, rect;
+        dev["source_dev_ip"] = ev.device.source_dev_ip;
+        dev["source_dev_mac"] = ev.device.source_dev_mac;
+        dev["source_dev_name"] = ev.device.source_dev_name;
+        dev["sink_dev_ip"] = ev.device.sink_dev_ip;
+        rect["X"] = 0;
+        rect["Y"] = 0;
+        rect["W"] = 1920;
+        rect["H"] = 1080;
+        params["device_parameters"] = dev;
+        params["video_rectangle"] = rect;
+        Device *dp = &d;
+        rpc(d, std::string(kMiracastPlayer) + ".playRequest", params, [this, dp](bool ok) {
+            if (!ok) set_state(*dp, "ready");
+        });
+    }
+
+    void on_player_state(Device &d, const PlayerStateChange &ev) {
+        Device *dp = &d;
+        if (ev.state == "PLAYING") {
+            std::string mac, name;
+            {
+                std::lock_guard<std::mutex> g(d.mtx);
+                ++d.playing;
+                d.state = "playing";
+                mac = ev.mac;
+                name = ev.name;
+            }
+            loop.schedule(opts.holdMs, [this, dp, mac, name] {
+                set_state(*dp, "stopping");
+                Json::Value params;
+                params["mac"] = mac;
+                params["name"] = name;
+                params["reason_code"] = 1;
+                rpc(*dp, std::string(kMiracastPlayer) + ".stopRequest", params, nullptr);
+            });
+        } else if (ev.state == "STOPPED") {
+            std::lock_guard<std::mutex> g(d.mtx);
+            ++d.stopped;
+            d.state = "ready";
+            d.mac.clear();
+            d.name.clear();
+        }
+    }
+
+    void attach(Device &d) {
+        Device *dp = &d;
+        DispatchOptions dispatch;
+        dispatch.workers = opts.workers;
+        d.listener->setDispatchOptions(dispatch);
+        d.tracker->attach(*d.listener);
+        on_client_connection_request(*d.listener, [this, dp](const ClientConnectionRequest &ev){ on_request(*dp, ev); });
+        on_launch_request(*d.listener, [this, dp](const LaunchRequest &ev){ on_launch(*dp, ev); });
+        on_player_state_change(*d.listener, [this, dp](const PlayerStateChange &ev){ on_player_state(*dp, ev); });
+        on_client_connection_error(*d.listener, [this, dp](const ClientConnectionError &){
+            std::lock_guard<std::mutex> g(dp->mtx);
+            ++dp->clientErrors;
+            dp->state = "ready";
+        });
+    }
+
+    Json::Value device_json(Device &d) const {
+        Json::Value j;
+        {
+            std::lock_guard<std::mutex> g(d.mtx);
+            j["url"] = d.url;
+            j["state"] = d.state;
+            j["requests"] = (Json::UInt64)d.requests;
+            j["rejected"] = (Json::UInt64)d.rejected;
+            j["accepted"] = (Json::UInt64)d.accepted;
+            j["launched"] = (Json::UInt64)d.launched;
+            j["playing"] = (Json::UInt64)d.playing;
+            j["stopped"] = (Json::UInt64)d.stopped;
+            j["rpc_errors"] = (Json::UInt64)d.rpcErrors;
+            j["client_errors"] = (Json::UInt64)d.clientErrors;
+        }
+        ConnectionStats cs = d.listener->getConnectionStats();
+        j["connected"] = cs.connected;
+        j["reconnects"] = (Json::UInt64)cs.reconnects;
+        j["rpc_latency_us"] = d.rpcLatency.toJson();
+        Json::Value t = d.tracker->toJson();
+        j["sessions"] = t["sessions"];
+        j["phases"] = t["phases"];
+        return j;
+    }
+};
+
+Fleet::Fleet(const std::vector<std::string> &controllerUrls, const FleetOptions &opts)
+    : pimpl(new Impl(controllerUrls, opts)) {}
+
+Fleet::~Fleet() {
+    stop();
+    delete pimpl;
+}
+
+bool Fleet::start() {
+    pimpl->stopping = false;
+    pimpl->loop.start();
+    size_t started = 0;
+    for (auto &d : pimpl->devices) {
+        pimpl->attach(*d);
+        if (!d->listener->start()) {
+            LogLine(LogLevel::Error, "Fleet") << d->url << ": event listener failed to start";
+            pimpl->set_state(*d, "failed");
+            continue;
+        }
+        ++started;
+        if (pimpl->opts.bringUp) pimpl->bring_up(*d);
+        else pimpl->set_state(*d, "ready");
+    }
+    return started > 0;
+}
+
+void Fleet::stop() {
+    if (pimpl->stopping.exchange(true)) return;
+    for (auto &d : pimpl->devices) d->listener->stop();
+    pimpl->loop.stop();
+    auto deadline = clock_type::now() + std::chrono::milliseconds(kDrainMs);
+    while (pimpl->outstanding > 0 && clock_type::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+size_t Fleet::size() const {
+    return pimpl->devices.size();
+}
+
+Json::Value Fleet::report() const {
+    Json::Value j;
+    j["devices"] = Json::Value(Json::arrayValue);
+    static const char *const counters[] = {"requests", "rejected", "accepted", "launched", "playing", "stopped",
+                                           "rpc_errors", "client_errors"};
+    Json::Value totals;
+    for (const char *c : counters) totals[c] = (Json::UInt64)0;
+    totals["devices"] = (Json::UInt64)pimpl->devices.size();
+    totals["connected"] = (Json::UInt64)0;
+    totals["sessions_completed"] = (Json::UInt64)0;
+
+    LatencyHistogram rpc;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> phases;
+    for (auto &d : pimpl->devices) {
+        Json::Value dj = pimpl->device_json(*d);
+        for (const char *c : counters) totals[c] = totals[c].asUInt64() + dj[c].asUInt64();
+        if (dj["connected"].asBool()) totals["connected"] = totals["connected"].asUInt64() + 1;
+        totals["sessions_completed"] = totals["sessions_completed"].asUInt64() + dj["sessions"]["completed"].asUInt64();
+        rpc.merge(d->rpcLatency);
+        for (const auto &name : dj["phases"].getMemberNames()) {
+            auto &h = phases[name];
+            if (!h) h.reset(new LatencyHistogram());
+            const LatencyHistogram *src = d->tracker->phase(name);
+            if (src) h->merge(*src);
+        }
+        j["devices"].append(dj);
+    }
+    j["totals"] = totals;
+    j["rpc_latency_us"] = rpc.toJson();
+    for (const auto &p : phases) j["phases"][p.first] = p.second->toJson();
+    return j;
+}
+
+void Fleet::printReport(std::ostream &out) const {
+    Json::Value r = report();
+    out << std::left << std::setw(36) << "device" << std::setw(13) << "state" << "conn  req  acc play stop  err  connect p50/p99 ms\n";
+    for (const auto &d : r["devices"]) {
+        const Json::Value &c = d["phases"]["request_to_playing"];
+        out << std::left << std::setw(36) << d["url"].asString() << std::setw(13) << d["state"].asString()
+            << std::right << std::setw(4) << (d["connected"].asBool() ? "up" : "down")
+            << std::setw(5) << d["requests"].asUInt64() << std::setw(5) << d["accepted"].asUInt64()
+            << std::setw(5) << d["playing"].asUInt64() << std::setw(5) << d["stopped"].asUInt64()
+            << std::setw(5) << d["rpc_errors"].asUInt64() + d["client_errors"].asUInt64()
+            << "  " << c["p50"].asUInt64() / 1000.0 << "/" << c["p99"].asUInt64() / 1000.0 << "\n";
+    }
+    const Json::Value &t = r["totals"];
+    const Json::Value &c = r["phases"]["request_to_playing"];
+    out << "fleet: " << t["connected"].asUInt64() << "/" << t["devices"].asUInt64() << " connected, requests="
+        << t["requests"].asUInt64() << " played=" << t["playing"].asUInt64() << " completed=" << t["sessions_completed"].asUInt64()
+        << " errors=" << t["rpc_errors"].asUInt64() + t["client_errors"].asUInt64()
+        << " connect p50/p99=" << c["p50"].asUInt64() / 1000.0 << "/" << c["p99"].asUInt64() / 1000.0 << "ms"
+        << " rpc p50/p99=" << r["rpc_latency_us"]["p50"].asUInt64() / 1000.0 << "/"
+        << r["rpc_latency_us"]["p99"].asUInt64() / 1000.0 << "ms\n";
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <json/json.h>
+
+struct FleetOptions {
+    bool bringUp = true;        // activate both plugins and setEnable on start
+    unsigned holdMs = 2000;     // PLAYING -> stopRequest
+    unsigned maxSessions = 0;   // completed sessions per device before it rejects requests, 0 = unlimited
+    unsigned workers = 1;       // event dispatch threads per device
+};
+
+// Drives many sinks from one process: every device gets an EventListener on one shared EventLoop and
+// its RPCs go out non-blocking (json_rpc_async), so no device waits on another. Each device runs the
+// session cycle on its own: request -> accept -> launch -> playRequest -> PLAYING -> hold -> stopRequest.
+class Fleet {
+public:
+    Fleet(const std::vector<std::string> &controllerUrls, const FleetOptions &opts = FleetOptions());
+    ~Fleet();
+
+    // false if no device could be started
+    bool start();
+    // stop every device and wait for outstanding RPCs
+    void stop();
+
+    size_t size() const;
+
+    // {"devices":[{url,state,connected,counters...,"sessions":...}],"totals":{...},"phases":{merged histograms},
+    //  "rpc_latency_us":{...}}
+    Json::Value report() const;
+    // one line per device plus totals
+    void printReport(std::ostream &out) const;
+
+private:
+    Fleet(const Fleet&) = delete;
+    Fleet &operator=(const Fleet&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
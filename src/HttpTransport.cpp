@@ -0,0 +1,291 @@
+#include "HttpTransport.h"
+#include "Log.h"
+#include <curl/curl.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// helper for curl write callback
+static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    auto realSize = size * nmemb;
+    std::string *s = reinterpret_cast<std::string*>(userp);
+    s->append(reinterpret_cast<char*>(contents), realSize);
+    return realSize;
+}
+
+static bool global_init() {
+    static bool ok = (curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK);
+    return ok;
+}
+
+// options that stay the same for every call
+static void configure_handle(CURL *curl, struct curl_slist *headers) {
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 6L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 10L);
+}
+
+static void read_timing(CURL *curl, CURLcode res, RpcTiming &timing) {
+    curl_off_t t = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &t) == CURLE_OK) timing.dns_us = (long)t;
+    if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &t) == CURLE_OK) timing.connect_us = (long)t;
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &t) == CURLE_OK) timing.ttfb_us = (long)t;
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &t) == CURLE_OK) timing.total_us = (long)t;
+    long newConnects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &newConnects);
+    timing.reused = (res == CURLE_OK && newConnects == 0);
+}
+
+struct HttpTransport::Impl {
+    std::mutex mtx;
+    CURL *curl;
+    struct curl_slist *headers;
+
+    Impl(): curl(nullptr), headers(nullptr) {
+        curl = curl_easy_init();
+        if (!curl) {
+            LogLine(LogLevel::Error, "HttpTransport") << "curl_easy_init failed";
+            return;
+        }
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        configure_handle(curl, headers);
+    }
+
+    ~Impl() {
+        if (headers) curl_slist_free_all(headers);
+        if (curl) curl_easy_cleanup(curl);
+    }
+
+    bool post(const std::string &url, const std::string &body, std::string &response, long &httpCode, RpcTiming &timing) {
+        std::lock_guard<std::mutex> g(mtx);
+        httpCode = 0;
+        timing = RpcTiming();
+        if (!curl) return false;
+
+        response.clear();
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)body.size());
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+
+        CURLcode res = curl_easy_perform(curl);
+
+        read_timing(curl, res, timing);
+
+        if (res != CURLE_OK) {
+            LogLine(LogLevel::Warn, "HttpTransport") << "curl perform error: " << curl_easy_strerror(res);
+            return false;
+        }
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+        return true;
+    }
+};
+
+HttpTransport::HttpTransport() : pimpl(new Impl()) {}
+HttpTransport::~HttpTransport() { delete pimpl; }
+
+bool HttpTransport::post(const std::string &url, const std::string &body, std::string &response, long &httpCode, RpcTiming &timing) {
+    return pimpl->post(url, body, response, httpCode, timing);
+}
+
+HttpTransport &HttpTransport::shared() {
+    global_init();
+    static HttpTransport instance;
+    return instance;
+}
+
+struct AsyncHttpTransport::Impl {
+    struct Job {
+        uint64_t id = 0;
+        long timeoutMs = 0;
+        std::string url, body, response;
+        Callback done;
+        CURL *easy = nullptr;
+    };
+
+    CURLM *multi;
+    struct curl_slist *headers;
+    std::thread runner;
+    std::mutex mtx;               // incoming, cancels + stopping
+    std::deque<Job*> incoming;
+    std::vector<uint64_t> cancels;
+    bool stopping;
+    std::vector<CURL*> idle;      // transport thread only
+    std::unordered_map<uint64_t, Job*> inflight;  // transport thread only
+    std::atomic<size_t> active;
+    std::atomic<uint64_t> nextId;
+
+    explicit Impl(long maxPerHost): multi(nullptr), headers(nullptr), stopping(false), active(0), nextId(1) {
+        multi = curl_multi_init();
+        if (!multi) {
+            LogLine(LogLevel::Error, "AsyncHttpTransport") << "curl_multi_init failed";
+            return;
+        }
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxPerHost);
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        runner = std::thread([this]{ run(); });
+    }
+
+    ~Impl() {
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            stopping = true;
+        }
+        if (multi) curl_multi_wakeup(multi);
+        if (runner.joinable()) runner.join();
+        for (CURL *e : idle) curl_easy_cleanup(e);
+        if (multi) curl_multi_cleanup(multi);
+        if (headers) curl_slist_free_all(headers);
+    }
+
+    uint64_t post(const std::string &url, const std::string &body, Callback done, long timeoutMs) {
+        Job *job = new Job();
+        uint64_t id = nextId++;
+        job->id = id;
+        job->timeoutMs = timeoutMs;
+        job->url = url;
+        job->body = body;
+        job->done = std::move(done);
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            if (!stopping && multi) {
+                incoming.push_back(job);
+                job = nullptr;
+            }
+        }
+        if (job) {
+            job->done(false, 0, job->response, RpcTiming());
+            delete job;
+            return id;
+        }
+        ++active;
+        curl_multi_wakeup(multi);
+        return id;
+    }
+
+    void cancel(uint64_t id) {
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            if (stopping || !multi) return;
+            cancels.push_back(id);
+        }
+        curl_multi_wakeup(multi);
+    }
+
+    void add(Job *job) {
+        CURL *easy = nullptr;
+        if (!idle.empty()) {
+            easy = idle.back();
+            idle.pop_back();
+        } else {
+            easy = curl_easy_init();
+            if (easy) configure_handle(easy, headers);
+        }
+        if (!easy) {
+            finish(job, false, 0, RpcTiming());
+            return;
+        }
+        job->easy = easy;
+        curl_easy_setopt(easy, CURLOPT_URL, job->url.c_str());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, job->body.c_str());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, (long)job->body.size());
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &job->response);
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, job->timeoutMs > 0 ? job->timeoutMs : 6000L);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, job);
+        curl_multi_add_handle(multi, easy);
+        inflight.emplace(job->id, job);
+    }
+
+    void finish(Job *job, bool ok, long httpCode, const RpcTiming &timing) {
+        if (job->easy) {
+            curl_multi_remove_handle(multi, job->easy);
+            idle.push_back(job->easy);
+            inflight.erase(job->id);
+        }
+        job->done(ok, httpCode, job->response, timing);
+        delete job;
+        --active;
+    }
+
+    void run() {
+        std::vector<Job*> batch;
+        std::vector<uint64_t> cancelled;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> g(mtx);
+                if (stopping) break;
+                batch.assign(incoming.begin(), incoming.end());
+                incoming.clear();
+                cancelled.swap(cancels);
+            }
+            for (Job *job : batch) add(job);
+            batch.clear();
+            for (uint64_t id : cancelled) {
+                auto it = inflight.find(id);
+                if (it != inflight.end()) finish(it->second, false, 0, RpcTiming());
+            }
+            cancelled.clear();
+
+            int running = 0;
+            curl_multi_perform(multi, &running);
+            CURLMsg *msg;
+            int left = 0;
+            while ((msg = curl_multi_info_read(multi, &left))) {
+                if (msg->msg != CURLMSG_DONE) continue;
+                Job *job = nullptr;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&job);
+                CURLcode res = msg->data.result;
+                RpcTiming timing;
+                read_timing(msg->easy_handle, res, timing);
+                long httpCode = 0;
+                if (res == CURLE_OK) {
+                    curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &httpCode);
+                } else {
+                    LogLine(LogLevel::Warn, "AsyncHttpTransport") << job->url << ": " << curl_easy_strerror(res);
+                }
+                finish(job, res == CURLE_OK, httpCode, timing);
+            }
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+
+        // fail whatever is left
+        std::deque<Job*> rest;
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            rest.swap(incoming);
+        }
+        std::vector<Job*> pending;
+        for (auto &kv : inflight) pending.push_back(kv.second);
+        for (Job *job : pending) finish(job, false, 0, RpcTiming());
+        for (Job *job : rest) finish(job, false, 0, RpcTiming());
+    }
+};
+
+AsyncHttpTransport::AsyncHttpTransport(long maxPerHost) : pimpl((global_init(), new Impl(maxPerHost))) {}
+AsyncHttpTransport::~AsyncHttpTransport() { delete pimpl; }
+
+uint64_t AsyncHttpTransport::post(const std::string &url, const std::string &body, Callback done, long timeoutMs) {
+    return pimpl->post(url, body, std::move(done), timeoutMs);
+}
+
+void AsyncHttpTransport::cancel(uint64_t id) {
+    pimpl->cancel(id);
+}
+
+size_t AsyncHttpTransport::inFlight() const {
+    return pimpl->active;
+}
+
+AsyncHttpTransport &AsyncHttpTransport::shared() {
+    static AsyncHttpTransport instance;
+    return instance;
+}
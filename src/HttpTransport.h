@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// per-call timing breakdown (microseconds, cumulative from start of the call as reported by curl)
+struct RpcTiming {
+    long dns_us = 0;      // name lookup done
+    long connect_us = 0;  // TCP connect done
+    long ttfb_us = 0;     // first response byte received
+    long total_us = 0;    // whole transfer
+    bool reused = false;  // true if an already-open connection was used
+};
+
+// Keep-alive HTTP POST transport for JSON-RPC.
+// One CURL easy handle and header list are reused for every call so libcurl keeps the
+// TCP connection to the controller open between requests. Calls are serialized.
+class HttpTransport {
+public:
+    HttpTransport();
+    ~HttpTransport();
+
+    // POST body to url; response body, HTTP status and timing are filled in.
+    // Returns false on transport error (httpCode is left 0 in that case).
+    bool post(const std::string &url, const std::string &body, std::string &response, long &httpCode, RpcTiming &timing);
+
+    // process-wide instance shared by the Miracast RPC wrappers
+    static HttpTransport &shared();
+
+private:
+    HttpTransport(const HttpTransport&) = delete;
+    HttpTransport &operator=(const HttpTransport&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
+
+// Non-blocking counterpart on a curl multi handle: any number of POSTs in flight over a pool of
+// keep-alive connections, driven by one background thread.
+class AsyncHttpTransport {
+public:
+    // ok=false on transport error (httpCode 0); runs on the transport thread, must not block
+    typedef std::function<void(bool ok, long httpCode, const std::string &response, const RpcTiming &timing)> Callback;
+
+    // maxPerHost: parallel connections per controller (further requests queue inside curl)
+    explicit AsyncHttpTransport(long maxPerHost = 4);
+    // requests still in flight complete with ok=false
+    ~AsyncHttpTransport();
+
+    // timeoutMs: whole transfer, 0 = the default 6 s. Returns an id for cancel().
+    uint64_t post(const std::string &url, const std::string &body, Callback done, long timeoutMs = 0);
+    // abort a request that has not completed yet: its callback runs with ok=false. Unknown or
+    // finished ids are ignored.
+    void cancel(uint64_t id);
+
+    size_t inFlight() const;
+
+    // process-wide instance used by json_rpc_async
+    static AsyncHttpTransport &shared();
+
+private:
+    AsyncHttpTransport(const AsyncHttpTransport&) = delete;
+    AsyncHttpTransport &operator=(const AsyncHttpTransport&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
@@ -0,0 +1,108 @@
+#include "LatencyHistogram.h"
+#include <limits>
+#include <sstream>
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+int LatencyHistogram::index_of(uint64_t v) {
+    if (v < (uint64_t)kSubBuckets) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - 6;                    // keep the top 7 bits: sub in [64, 127]
+    int sub = (int)(v >> shift);
+    return kSubBuckets + (shift - 1) * (kSubBuckets / 2) + (sub - kSubBuckets / 2);
+}
+
+uint64_t LatencyHistogram::upper_edge(int idx) {
+    if (idx < kSubBuckets) return (uint64_t)idx;
+    int rel = idx - kSubBuckets;
+    int shift = rel / (kSubBuckets / 2) + 1;
+    uint64_t sub = (uint64_t)(rel % (kSubBuckets / 2) + kSubBuckets / 2);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t us) {
+    int idx = index_of(us);
+    if (idx >= kBuckets) idx = kBuckets - 1;
+    counts[idx].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(us, std::memory_order_relaxed);
+    uint64_t cur = minUs.load(std::memory_order_relaxed);
+    while (us < cur && !minUs.compare_exchange_weak(cur, us, std::memory_order_relaxed)) {}
+    cur = maxUs.load(std::memory_order_relaxed);
+    while (us > cur && !maxUs.compare_exchange_weak(cur, us, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::reset() {
+    for (auto &c : counts) c.store(0, std::memory_order_relaxed);
+    total.store(0);
+    sumUs.store(0);
+    minUs.store(std::numeric_limits<uint64_t>::max());
+    maxUs.store(0);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    for (int i = 0; i < kBuckets; ++i) {
+        uint64_t c = other.counts[i].load(std::memory_order_relaxed);
+        if (c) counts[i].fetch_add(c, std::memory_order_relaxed);
+    }
+    total.fetch_add(other.count(), std::memory_order_relaxed);
+    sumUs.fetch_add(other.sum(), std::memory_order_relaxed);
+    uint64_t v = other.minUs.load(), cur = minUs.load();
+    while (v < cur && !minUs.compare_exchange_weak(cur, v)) {}
+    v = other.maxUs.load();
+    cur = maxUs.load();
+    while (v > cur && !maxUs.compare_exchange_weak(cur, v)) {}
+}
+
+uint64_t LatencyHistogram::min() const {
+    return count() ? minUs.load(std::memory_order_relaxed) : 0;
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? (double)sum() / n : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t n = count();
+    if (!n) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * n + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t edge = upper_edge(i);
+            return edge < max() ? edge : max();
+        }
+    }
+    return max();
+}
+
+Json::Value LatencyHistogram::toJson() const {
+    Json::Value j;
+    j["count"] = (Json::UInt64)count();
+    j["min"] = (Json::UInt64)min();
+    j["mean"] = mean();
+    j["p50"] = (Json::UInt64)percentile(50);
+    j["p90"] = (Json::UInt64)percentile(90);
+    j["p99"] = (Json::UInt64)percentile(99);
+    j["p999"] = (Json::UInt64)percentile(99.9);
+    j["max"] = (Json::UInt64)max();
+    return j;
+}
+
+std::string LatencyHistogram::toPrometheus(const std::string &metric, const std::string &labels) const {
+    std::ostringstream out;
+    std::string sep = labels.empty() ? "" : labels + ",";
+    static const double qs[] = {0.5, 0.9, 0.99, 0.999};
+    for (double q : qs) {
+        out << metric << "{" << sep << "quantile=\"" << q << "\"} " << percentile(q * 100) << "\n";
+    }
+    std::string lbl = labels.empty() ? "" : "{" + labels + "}";
+    out << metric << "_sum" << lbl << " " << sum() << "\n";
+    out << metric << "_count" << lbl << " " << count() << "\n";
+    return out.str();
+}
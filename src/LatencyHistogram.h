@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <json/json.h>
+
+// microseconds from -> to on the steady clock, 0 if to is not later; what the histogram records
+inline uint64_t us_between(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return to > from ? (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count() : 0;
+}
+
+// HDR-style log-linear latency histogram (microseconds).
+// Values below 128 are exact; above that each power of two is split into 64 buckets (<1.6% error).
+// record() is lock-free and may be called from any thread.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t us);
+    void reset();
+    void merge(const LatencyHistogram &other);
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sumUs.load(std::memory_order_relaxed); }
+    uint64_t min() const;
+    uint64_t max() const { return maxUs.load(std::memory_order_relaxed); }
+    double mean() const;
+    // value at percentile p (0..100), upper edge of the bucket holding it
+    uint64_t percentile(double p) const;
+
+    // {"count","min","mean","p50","p90","p99","p999","max"}
+    Json::Value toJson() const;
+    // Prometheus summary lines for metric{labels,quantile=..}, _sum and _count
+    std::string toPrometheus(const std::string &metric, const std::string &labels) const;
+
+private:
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram&) = delete;
+
+    static const int kSubBuckets = 128;
+    static const int kBuckets = kSubBuckets + 58 * (kSubBuckets / 2);
+
+    static int index_of(uint64_t v);
+    static uint64_t upper_edge(int idx);
+
+    std::atomic<uint64_t> counts[kBuckets];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sumUs;
+    std::atomic<uint64_t> minUs;
+    std::atomic<uint64_t> maxUs;
+};
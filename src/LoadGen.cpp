@@ -0,0 +1,216 @@
+#include "LoadGen.h"
+#include "HttpTransport.h"
+#include "LatencyHistogram.h"
+#include "Miracast.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+typedef std::chrono::steady_clock clock_type;
+
+struct LoadGenerator::Impl {
+    std::string url;
+    LoadOptions opts;
+    std::atomic<bool> stopRequested{false};
+
+    std::mutex mtx;                       // everything below except the lock-free histograms
+    std::condition_variable changed;
+    unsigned inFlight = 0;
+    LatencyHistogram intervalLatency;
+    uint64_t ivSent = 0, ivOk = 0, ivErrors = 0;
+    clock_type::time_point nextDue;       // of the request the scheduler is waiting to send
+
+    // whole run; failed requests count too (a timeout at due -> timeout), so errors cannot hide slowness
+    LatencyHistogram latency;             // due -> response
+    LatencyHistogram service;             // sent -> response
+    uint64_t scheduled = 0, sent = 0, ok = 0, errors = 0;
+    double elapsedS = 0;
+    Json::Value intervals = Json::Value(Json::arrayValue);
+
+    Impl(const std::string &u, const LoadOptions &o): url(u), opts(o) {}
+
+    // transport thread
+    void completed(bool success, clock_type::time_point due, clock_type::time_point sentAt) {
+        auto now = clock_type::now();
+        uint64_t us = us_between(due, now);
+        latency.record(us);
+        service.record(us_between(sentAt, now));
+        std::lock_guard<std::mutex> g(mtx);
+        --inFlight;
+        intervalLatency.record(us);
+        if (success) {
+            ++ok;
+            ++ivOk;
+        } else {
+            ++errors;
+            ++ivErrors;
+        }
+        changed.notify_all();
+    }
+
+    Json::Value close_interval(clock_type::time_point start, clock_type::time_point now, double spanS) {
+        Json::Value iv;
+        std::lock_guard<std::mutex> g(mtx);
+        iv["t_s"] = std::chrono::duration<double>(now - start).count();
+        iv["sent"] = (Json::UInt64)ivSent;
+        iv["ok"] = (Json::UInt64)ivOk;
+        iv["errors"] = (Json::UInt64)ivErrors;
+        iv["rate"] = spanS > 0 ? ivOk / spanS : 0.0;
+        iv["in_flight"] = inFlight;
+        // how late the scheduler is with the next send: the server (or workers) cannot keep up
+        iv["behind_ms"] = nextDue != clock_type::time_point() ? us_between(nextDue, now) / 1000.0 : 0.0;
+        iv["latency_us"] = intervalLatency.toJson();
+        intervalLatency.reset();
+        ivSent = ivOk = ivErrors = 0;
+        intervals.append(iv);
+        return iv;
+    }
+};
+
+LoadGenerator::LoadGenerator(const std::string &controllerUrl, const LoadOptions &opts) : pimpl(new Impl(controllerUrl, opts)) {}
+
+LoadGenerator::~LoadGenerator() {
+    delete pimpl;
+}
+
+bool LoadGenerator::run(std::string &error, std::function<void(const Json::Value &)> onInterval) {
+    Impl &s = *pimpl;
+    const LoadOptions &o = s.opts;
+    if (o.method.empty() || o.rate <= 0 || o.workers == 0 || o.durationS == 0) {
+        error = "method, rate, workers and duration must be set";
+        return false;
+    }
+    AsyncHttpTransport transport((long)o.workers);
+    // HTTP pairs every reply with its request, so one encoded body serves them all
+    const std::string body = encode_rpc_request(next_rpc_id(), o.method, o.params);
+    const auto period = std::chrono::duration<double>(1.0 / o.rate);
+    const auto interval = std::chrono::milliseconds(std::max(1u, o.intervalMs));
+
+    auto start = clock_type::now();
+    auto end = start + std::chrono::seconds(o.durationS);
+    auto lastReport = start, nextReport = start + interval;
+    auto report_due = [&](clock_type::time_point now) {
+        while (now >= nextReport) {
+            Json::Value iv = s.close_interval(start, nextReport, std::chrono::duration<double>(nextReport - lastReport).count());
+            lastReport = nextReport;
+            nextReport += interval;
+            if (onInterval) onInterval(iv);
+        }
+    };
+
+    uint64_t i = 0;
+    clock_type::time_point stoppedAt = end;
+    for (;; ++i) {
+        auto due = start + std::chrono::duration_cast<clock_type::duration>(period * (double)i);
+        if (due >= end) break;
+        {
+            std::lock_guard<std::mutex> g(s.mtx);
+            s.nextDue = due;
+        }
+        // open loop: wait for the slot's time, never for the previous response
+        while (!s.stopRequested && clock_type::now() < due) {
+            std::this_thread::sleep_until(std::min(due, nextReport));
+            report_due(clock_type::now());
+        }
+        // all workers busy: send as soon as one frees up; the wait counts toward this request's latency
+        bool slot = false;
+        while (!s.stopRequested && clock_type::now() < end) {
+            {
+                std::unique_lock<std::mutex> lk(s.mtx);
+                if (s.inFlight < o.workers) {
+                    ++s.inFlight;
+                    ++s.sent;
+                    ++s.ivSent;
+                    slot = true;
+                    break;
+                }
+                s.changed.wait_until(lk, std::min(nextReport, end));
+            }
+            report_due(clock_type::now());
+        }
+        if (!slot) {
+            stoppedAt = std::min(clock_type::now(), end);
+            break;
+        }
+        auto sentAt = clock_type::now();
+        Impl *p = &s;
+        transport.post(s.url, body, [p, due, sentAt](bool delivered, long httpCode, const std::string &response, const RpcTiming &) {
+            bool success = false;
+            if (delivered && httpCode >= 200 && httpCode < 300) {
+                Json::Value resp;
+                success = decode_rpc_response(response, resp) && resp.isObject() && !resp.isMember("error");
+            }
+            p->completed(success, due, sentAt);
+        }, o.timeoutMs);
+    }
+    {
+        std::lock_guard<std::mutex> g(s.mtx);
+        s.nextDue = clock_type::time_point();
+        // every slot due before the schedule ended, sent or not
+        double dueSlots = std::ceil(std::chrono::duration<double>(stoppedAt - start).count() * o.rate);
+        s.scheduled = std::max<uint64_t>(s.sent, (uint64_t)dueSlots);
+    }
+
+    // drain: the transport's own timeout bounds this
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lk(s.mtx);
+            if (s.inFlight == 0) break;
+            s.changed.wait_until(lk, nextReport);
+        }
+        report_due(clock_type::now());
+    }
+    auto finished = clock_type::now();
+    if (finished > lastReport) {
+        Json::Value iv = s.close_interval(start, finished, std::chrono::duration<double>(finished - lastReport).count());
+        if (onInterval) onInterval(iv);
+    }
+    s.elapsedS = std::chrono::duration<double>(finished - start).count();
+    return true;
+}
+
+void LoadGenerator::requestStop() {
+    pimpl->stopRequested = true;
+}
+
+Json::Value LoadGenerator::report() const {
+    const Impl &s = *pimpl;
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    Json::Value r;
+    r["method"] = s.opts.method;
+    r["target_rate"] = s.opts.rate;
+    r["workers"] = s.opts.workers;
+    r["elapsed_s"] = s.elapsedS;
+    r["scheduled"] = (Json::UInt64)s.scheduled;
+    r["sent"] = (Json::UInt64)s.sent;
+    r["ok"] = (Json::UInt64)s.ok;
+    r["errors"] = (Json::UInt64)s.errors;
+    r["unsent"] = (Json::UInt64)(s.scheduled - s.sent);
+    r["achieved_rate"] = s.elapsedS > 0 ? s.ok / s.elapsedS : 0.0;
+    r["latency_us"] = s.latency.toJson();
+    r["service_us"] = s.service.toJson();
+    r["intervals"] = s.intervals;
+    return r;
+}
+
+void LoadGenerator::printReport(std::ostream &out) const {
+    Json::Value r = report();
+    const Json::Value &l = r["latency_us"], &sv = r["service_us"];
+    out << std::fixed << std::setprecision(1)
+        << "load " << r["method"].asString() << ": target " << r["target_rate"].asDouble() << "/s, achieved "
+        << r["achieved_rate"].asDouble() << "/s over " << r["elapsed_s"].asDouble() << "s with " << r["workers"].asUInt() << " workers\n"
+        << "  scheduled=" << r["scheduled"].asUInt64() << " sent=" << r["sent"].asUInt64() << " ok=" << r["ok"].asUInt64()
+        << " errors=" << r["errors"].asUInt64() << " unsent=" << r["unsent"].asUInt64() << "\n"
+        << std::setprecision(2);
+    for (const Json::Value *h : {&l, &sv}) {
+        out << (h == &l ? "  latency (from due time) " : "  service (from send)    ")
+            << " p50=" << (*h)["p50"].asUInt64() / 1000.0 << " p90=" << (*h)["p90"].asUInt64() / 1000.0
+            << " p99=" << (*h)["p99"].asUInt64() / 1000.0 << " p99.9=" << (*h)["p999"].asUInt64() / 1000.0
+            << " max=" << (*h)["max"].asUInt64() / 1000.0 << " ms\n";
+    }
+}
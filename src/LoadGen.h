@@ -0,0 +1,51 @@
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <json/json.h>
+
+struct LoadOptions {
+    std::string method;                            // full JSON-RPC method
+    Json::Value params = Json::Value(Json::objectValue);
+    double rate = 100;             // requests per second, on a fixed schedule
+    unsigned workers = 16;         // requests in flight at most (= parallel HTTP connections)
+    unsigned durationS = 10;
+    long timeoutMs = 6000;         // per request
+    unsigned intervalMs = 1000;    // reporting interval
+};
+
+// Open-loop load generator. Request i is due at start + i / rate whether or not earlier requests have
+// completed; when all workers are busy it is sent as soon as one frees up, but its latency is still
+// measured from the time it was due. Queueing caused by a slow server therefore shows up in the
+// percentiles instead of silently lowering the offered rate (coordinated omission). The service
+// time (actual send -> response) is reported next to it. Failed requests are in both, measured to
+// when they failed, so a request that timed out counts with at least the timeout.
+//
+// Requests go out on an own AsyncHttpTransport with one connection per worker, so interactive RPCs
+// and the shared transport are not affected. RPC observers are not notified.
+class LoadGenerator {
+public:
+    LoadGenerator(const std::string &controllerUrl, const LoadOptions &opts);
+    ~LoadGenerator();
+
+    // blocking: schedule for durationS, then wait for what is still in flight. onInterval gets one
+    // entry of report()["intervals"] at the end of every interval.
+    bool run(std::string &error, std::function<void(const Json::Value &interval)> onInterval = nullptr);
+
+    // stop scheduling; in-flight requests still complete (async-signal-safe)
+    void requestStop();
+
+    // {"method","target_rate","workers","elapsed_s","scheduled","sent","ok","errors","unsent","achieved_rate",
+    //  "latency_us":{..},"service_us":{..},"intervals":[{"t_s","sent","ok","errors","rate","in_flight","behind_ms",
+    //  "latency_us":{..}}]}
+    Json::Value report() const;
+    void printReport(std::ostream &out) const;
+
+private:
+    LoadGenerator(const LoadGenerator&) = delete;
+    LoadGenerator &operator=(const LoadGenerator&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
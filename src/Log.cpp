@@ -0,0 +1,393 @@
+#include "Log.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <json/json.h>
+
+namespace log_detail {
+std::atomic<int> level((int)LogLevel::Info);
+}
+
+namespace {
+
+// fixed part of a record; the payload follows, padded to 8 bytes
+struct RecordHeader {
+    uint64_t wallNs;
+    const char *source;
+    uint32_t len;
+    uint8_t level;
+    uint8_t json;
+    uint8_t truncated;
+    uint8_t pad;
+};
+static_assert(sizeof(RecordHeader) % 8 == 0, "records stay 8-byte aligned");
+
+size_t round8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+// single producer (the owning thread), single consumer (the writer)
+struct LogRing {
+    explicit LogRing(size_t capacity): buf(capacity), mask(capacity - 1) {}
+
+    std::vector<char> buf;
+    size_t mask;
+    alignas(64) std::atomic<uint64_t> head{0};   // next byte the producer writes
+    alignas(64) std::atomic<uint64_t> tail{0};   // next byte the consumer reads
+    std::atomic<bool> orphaned{false};           // owning thread exited
+
+    void copy_in(uint64_t pos, const void *src, size_t n) {
+        size_t off = pos & mask, first = std::min(n, buf.size() - off);
+        memcpy(&buf[off], src, first);
+        memcpy(&buf[0], (const char*)src + first, n - first);
+    }
+    void copy_out(uint64_t pos, void *dst, size_t n) const {
+        size_t off = pos & mask, first = std::min(n, buf.size() - off);
+        memcpy(dst, &buf[off], first);
+        memcpy((char*)dst + first, &buf[0], n - first);
+    }
+
+    bool push(const RecordHeader &h, const char *data) {
+        size_t need = sizeof(h) + round8(h.len);
+        uint64_t w = head.load(std::memory_order_relaxed);
+        if (need > buf.size() - (size_t)(w - tail.load(std::memory_order_acquire))) return false;
+        copy_in(w, &h, sizeof(h));
+        copy_in(w + sizeof(h), data, h.len);
+        head.store(w + need, std::memory_order_release);
+        return true;
+    }
+};
+
+const char kLevelLetter[] = {'E', 'W', 'I', 'D', 'T'};
+
+void write_all(int fd, const std::string &s) {
+    size_t off = 0;
+    while (off < s.size()) {
+        ssize_t n = ::write(fd, s.data() + off, s.size() - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        off += (size_t)n;
+    }
+}
+
+struct Logger {
+    std::mutex mtx;                      // rings, options, sink, flush/stop state
+    std::mutex outMtx;                   // console/file writes, promptShown
+    bool promptShown = false;
+    std::condition_variable wake, flushed;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    LogOptions opts;
+    int fileFd = -1;
+    std::thread writer;
+    bool running = false;
+    bool stopping = false;
+    std::atomic<bool> stopped{false};    // after log_stop: write synchronously
+    uint64_t flushRequested = 0, flushDone = 0;
+    std::atomic<uint64_t> written{0}, dropped{0};
+    std::once_flag started;
+
+    void ensure_started() {
+        std::call_once(started, [this] {
+            std::lock_guard<std::mutex> g(mtx);
+            start_locked();
+        });
+    }
+
+    void start_locked() {
+        if (running || stopped) return;
+        running = true;
+        writer = std::thread([this] { run(); });
+        std::atexit(log_stop);
+    }
+
+    std::shared_ptr<LogRing> new_ring() {
+        std::lock_guard<std::mutex> g(mtx);
+        size_t cap = 4096;
+        while (cap < opts.ringBytes) cap <<= 1;
+        auto r = std::make_shared<LogRing>(cap);
+        rings.push_back(r);
+        return r;
+    }
+
+    void format(std::string &out, const RecordHeader &h, const char *payload) {
+        time_t secs = (time_t)(h.wallNs / 1000000000ull);
+        struct tm tm;
+        localtime_r(&secs, &tm);
+        char prefix[64];
+        int n = snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%06u %c [", tm.tm_hour, tm.tm_min, tm.tm_sec,
+                         (unsigned)(h.wallNs % 1000000000ull / 1000), kLevelLetter[std::min<int>(h.level, 4)]);
+        out.append(prefix, (size_t)n);
+        out.append(h.source ? h.source : "");
+        out.append("] ");
+        if (h.json && !h.truncated) {
+            Json::Value v;
+            std::string errs;
+            Json::CharReaderBuilder rb;
+            std::unique_ptr<Json::CharReader> reader(rb.newCharReader());
+            if (reader->parse(payload, payload + h.len, &v, &errs)) {
+                Json::StreamWriterBuilder w;
+                w["indentation"] = "  ";
+                out.append(Json::writeString(w, v));
+                out.push_back('\n');
+                return;
+            }
+        }
+        out.append(payload, h.len);
+        if (h.truncated) out.append(" ...(truncated)");
+        out.push_back('\n');
+    }
+
+    void emit(const std::string &out, const std::string &err) {
+        int fd;
+        std::string prompt;
+        {
+            std::lock_guard<std::mutex> g(mtx);
+            fd = fileFd;
+            prompt = opts.prompt;
+        }
+        std::lock_guard<std::mutex> o(outMtx);
+        if (fd >= 0) {
+            write_all(fd, err + out);
+            return;
+        }
+        if (!promptShown) prompt.clear();
+        if (!prompt.empty()) {
+            // break the line the user is typing on, then redraw the prompt
+            write_all(STDOUT_FILENO, "\n");
+        }
+        if (!err.empty()) write_all(STDERR_FILENO, err);
+        if (!out.empty()) write_all(STDOUT_FILENO, out);
+        if (!prompt.empty()) write_all(STDOUT_FILENO, prompt);
+    }
+
+    // a record copied out of its ring; the payload is at off in the pass's payload buffer
+    struct Drained {
+        RecordHeader hdr;
+        size_t off;
+    };
+
+    // one pass over every ring, merged by timestamp across threads; false if nothing was pending
+    bool drain(const std::vector<std::shared_ptr<LogRing>> &snapshot, std::vector<Drained> &batch, std::string &payloads) {
+        batch.clear();
+        payloads.clear();
+        for (const auto &r : snapshot) {
+            uint64_t t = r->tail.load(std::memory_order_relaxed);
+            uint64_t h = r->head.load(std::memory_order_acquire);
+            while (t < h) {
+                Drained d;
+                r->copy_out(t, &d.hdr, sizeof(d.hdr));
+                d.off = payloads.size();
+                payloads.resize(d.off + d.hdr.len);
+                r->copy_out(t + sizeof(d.hdr), &payloads[d.off], d.hdr.len);
+                batch.push_back(d);
+                t += sizeof(d.hdr) + round8(d.hdr.len);
+            }
+            r->tail.store(t, std::memory_order_release);
+        }
+        if (batch.empty()) return false;
+        // stable: a thread's own records keep their order
+        std::stable_sort(batch.begin(), batch.end(), [](const Drained &a, const Drained &b) { return a.hdr.wallNs < b.hdr.wallNs; });
+        std::string out, err;
+        for (const Drained &d : batch) format(d.hdr.level <= (uint8_t)LogLevel::Warn ? err : out, d.hdr, payloads.data() + d.off);
+        written += batch.size();
+        emit(out, err);
+        return true;
+    }
+
+    void run() {
+        std::vector<std::shared_ptr<LogRing>> snapshot;
+        std::vector<Drained> batch;
+        std::string payloads;
+        while (true) {
+            uint64_t flushSeen;
+            bool stop;
+            {
+                std::lock_guard<std::mutex> g(mtx);
+                // rings of exited threads go once they are empty
+                rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<LogRing> &r) {
+                    return r->orphaned && r->head.load(std::memory_order_acquire) == r->tail.load(std::memory_order_relaxed);
+                }), rings.end());
+                snapshot = rings;
+                flushSeen = flushRequested;
+                stop = stopping;
+            }
+            bool any = drain(snapshot, batch, payloads);
+            std::unique_lock<std::mutex> lk(mtx);
+            // whatever was logged before flushSeen was requested is out now
+            flushDone = flushSeen;
+            flushed.notify_all();
+            if (!any) {
+                if (stop) break;
+                wake.wait_for(lk, std::chrono::milliseconds(5), [&] { return stopping || flushRequested != flushSeen; });
+            }
+        }
+    }
+
+    // after log_stop
+    void write_now(const RecordHeader &h, const char *data) {
+        std::string out, err;
+        format(h.level <= (uint8_t)LogLevel::Warn ? err : out, h, data);
+        std::lock_guard<std::mutex> g(mtx);
+        int fd = fileFd;
+        if (fd >= 0) write_all(fd, err + out);
+        else if (!err.empty()) write_all(STDERR_FILENO, err);
+        else write_all(STDOUT_FILENO, out);
+        ++written;
+    }
+};
+
+// never destroyed: threads and static destructors may still log during exit
+Logger &logger() {
+    static Logger *instance = new Logger();
+    return *instance;
+}
+
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+    ~ThreadRing() {
+        if (ring) ring->orphaned = true;
+    }
+};
+
+thread_local ThreadRing threadRing;
+
+} // namespace
+
+bool log_start(const LogOptions &opts, std::string &error) {
+    Logger &L = logger();
+    int fd = -1;
+    if (!opts.file.empty()) {
+        fd = open(opts.file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            error = opts.file + ": " + strerror(errno);
+            return false;
+        }
+    }
+    log_set_level(opts.level);
+    {
+        std::lock_guard<std::mutex> g(L.mtx);
+        if (L.fileFd >= 0) close(L.fileFd);
+        L.fileFd = fd;
+        L.opts = opts;
+    }
+    L.ensure_started();
+    return true;
+}
+
+void log_stop() {
+    Logger &L = logger();
+    {
+        std::lock_guard<std::mutex> g(L.mtx);
+        if (!L.running) return;
+        L.stopping = true;
+    }
+    L.wake.notify_all();
+    if (L.writer.joinable()) L.writer.join();
+    std::lock_guard<std::mutex> g(L.mtx);
+    L.running = false;
+    L.stopped = true;
+    L.opts.prompt.clear();
+}
+
+void log_flush() {
+    Logger &L = logger();
+    std::unique_lock<std::mutex> lk(L.mtx);
+    if (!L.running || L.stopping) return;
+    uint64_t want = ++L.flushRequested;
+    L.wake.notify_all();
+    L.flushed.wait(lk, [&] { return L.flushDone >= want || !L.running; });
+}
+
+void log_prompt(bool visible) {
+    Logger &L = logger();
+    if (visible) log_flush();
+    std::string prompt;
+    {
+        std::lock_guard<std::mutex> g(L.mtx);
+        prompt = L.opts.prompt;
+    }
+    std::lock_guard<std::mutex> o(L.outMtx);
+    L.promptShown = visible && !prompt.empty();
+    if (L.promptShown) write_all(STDOUT_FILENO, prompt);
+}
+
+void log_set_level(LogLevel level) {
+    log_detail::level.store((int)level, std::memory_order_relaxed);
+}
+
+LogLevel log_level() {
+    return (LogLevel)log_detail::level.load(std::memory_order_relaxed);
+}
+
+bool parse_log_level(const std::string &name, LogLevel &out) {
+    static const char *names[] = {"error", "warn", "info", "debug", "trace"};
+    for (int i = 0; i < 5; ++i) {
+        if (name == names[i]) {
+            out = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *log_level_name(LogLevel level) {
+    static const char *names[] = {"error", "warn", "info", "debug", "trace"};
+    return names[std::min<int>((int)level, 4)];
+}
+
+LogStats log_stats() {
+    Logger &L = logger();
+    LogStats st;
+    st.written = L.written;
+    st.dropped = L.dropped;
+    std::lock_guard<std::mutex> g(L.mtx);
+    st.threads = L.rings.size();
+    return st;
+}
+
+bool log_write(LogLevel level, const char *source, const char *data, size_t len, bool json) {
+    if (!log_enabled(level)) return false;
+    Logger &L = logger();
+    L.ensure_started();
+
+    RecordHeader h;
+    h.wallNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    h.source = source;
+    h.level = (uint8_t)level;
+    h.json = json ? 1 : 0;
+    h.truncated = 0;
+    h.pad = 0;
+    h.len = (uint32_t)len;
+
+    if (L.stopped.load(std::memory_order_acquire)) {
+        L.write_now(h, data);
+        return true;
+    }
+    if (!threadRing.ring) threadRing.ring = L.new_ring();  // first record of this thread
+    LogRing &r = *threadRing.ring;
+    size_t maxLen = r.buf.size() / 4;
+    if (len > maxLen) {
+        h.len = (uint32_t)maxLen;
+        h.truncated = 1;
+    }
+    if (!r.push(h, data)) {
+        ++L.dropped;
+        return false;
+    }
+    return true;
+}
+
+void LogLine::append(const char *s, size_t n) {
+    n = std::min(n, sizeof(buf) - len);
+    memcpy(buf + len, s, n);
+    len += n;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Leveled asynchronous logger. log_write copies a binary record (wall clock, level, source, payload)
+// into a lock-free ring owned by the calling thread and returns; a background thread drains every
+// ring, formats "HH:MM:SS.uuuuuu L [source] payload" and writes it out, the records of each pass in
+// timestamp order across threads. A full ring drops the record (counted) instead of blocking, so
+// console speed never shows up in measured latencies.
+//
+// Console: Error/Warn go to stderr, the rest to stdout. With a log file everything goes there.
+
+enum class LogLevel : uint8_t { Error, Warn, Info, Debug, Trace };
+
+struct LogOptions {
+    LogLevel level = LogLevel::Info;
+    std::string file;              // empty = console
+    size_t ringBytes = 64 * 1024;  // per producing thread, rounded up to a power of two
+    std::string prompt;            // console only: see log_prompt
+};
+
+struct LogStats {
+    uint64_t written = 0;
+    uint64_t dropped = 0;   // ring full
+    size_t threads = 0;     // rings currently registered
+};
+
+namespace log_detail {
+extern std::atomic<int> level;
+}
+
+inline bool log_enabled(LogLevel level) {
+    return (int)level <= log_detail::level.load(std::memory_order_relaxed);
+}
+
+// optional: without it the logger starts with the defaults on first use. Flushes and is stopped at exit.
+bool log_start(const LogOptions &opts, std::string &error);
+// drain and stop the writer; later records are written synchronously
+void log_stop();
+// block until everything logged so far by any thread is written
+void log_flush();
+// interactive CLI: visible = flush, print the prompt and redraw it below every later batch of lines;
+// false once the user's line was read (output then goes out as is)
+void log_prompt(bool visible);
+
+void log_set_level(LogLevel level);
+LogLevel log_level();
+bool parse_log_level(const std::string &name, LogLevel &out);
+const char *log_level_name(LogLevel level);
+LogStats log_stats();
+
+// source must be a string literal (only the pointer is stored). json: payload is one JSON text,
+// pretty printed by the writer. Payloads over a quarter of the ring are truncated.
+// Returns false if the record was filtered or dropped.
+bool log_write(LogLevel level, const char *source, const char *data, size_t len, bool json = false);
+
+inline bool log_write(LogLevel level, const char *source, std::string_view text) {
+    return log_enabled(level) && log_write(level, source, text.data(), text.size());
+}
+
+// Formats into a stack buffer, logged when it goes out of scope; nothing is formatted below the level:
+//   LogLine(LogLevel::Warn, "json_rpc") << "HTTP code: " << code;
+class LogLine {
+public:
+    LogLine(LogLevel level, const char *source): lvl(level), src(source), len(0), on(log_enabled(level)) {}
+    ~LogLine() {
+        if (on) log_write(lvl, src, buf, len);
+    }
+
+    LogLine &operator<<(std::string_view s) {
+        if (on) append(s.data(), s.size());
+        return *this;
+    }
+    LogLine &operator<<(const char *s) { return *this << std::string_view(s ? s : ""); }
+    LogLine &operator<<(const std::string &s) { return *this << std::string_view(s); }
+    LogLine &operator<<(char c) {
+        if (on) append(&c, 1);
+        return *this;
+    }
+    LogLine &operator<<(bool b) { return *this << (b ? "true" : "false"); }
+    template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    LogLine &operator<<(T v) {
+        if (!on) return *this;
+        char tmp[32];
+        int n;
+        if (std::is_floating_point<T>::value) n = snprintf(tmp, sizeof(tmp), "%g", (double)v);
+        else if (std::is_signed<T>::value) n = snprintf(tmp, sizeof(tmp), "%lld", (long long)v);
+        else n = snprintf(tmp, sizeof(tmp), "%llu", (unsigned long long)v);
+        if (n > 0) append(tmp, (size_t)n);
+        return *this;
+    }
+
+private:
+    LogLine(const LogLine&) = delete;
+    LogLine &operator=(const LogLine&) = delete;
+
+    void append(const char *s, size_t n);
+
+    LogLevel lvl;
+    const char *src;
+    size_t len;
+    bool on;
+    char buf[1024];
+};
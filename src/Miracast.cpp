@@ -1,17 +1,14 @@
 #include "Miracast.h"
-#include <curl/curl.h>
-#include <iostream>
 #include <sstream>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <json/json.h>
-
-// helper for curl write callback
-static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-    auto realSize = size * nmemb;
-    std::string *s = reinterpret_cast<std::string*>(userp);
-    s->append(reinterpret_cast<char*>(contents), realSize);
-    return realSize;
-}
+#include "EventListener.h"
+#include "Log.h"
+#include "RpcMethods.h"
 
 // helper to serialize Json::Value to string
 static std::string jsonToString(const Json::Value &v) {
@@ -28,6 +25,19 @@ static bool parseJson(const std::string &s, Json::Value &out) {
     return reader->parse(s.c_str(), s.c_str() + s.size(), &out, &errs);
 }
 
+std::string encode_rpc_request(int id, const std::string &method, const Json::Value &params) {
+    Json::Value payload;
+    payload["jsonrpc"] = "2.0";
+    payload["id"] = id;
+    payload["method"] = method;
+    payload["params"] = params;
+    return jsonToString(payload);
+}
+
+bool decode_rpc_response(const std::string &body, Json::Value &out) {
+    return parseJson(body, out);
+}
+
 // normalize controller URL or fallback compile-time default
 static std::string normalize_controller_url(const std::string &url) {
     if (!url.empty()) return url;
@@ -38,168 +48,444 @@ static std::string normalize_controller_url(const std::string &url) {
 #endif
 }
 
-// perform JSON-RPC; params is a Json::Value (object or array)
-static Json::Value json_rpc_request(const std::string &controllerUrl, const std::string &method, const Json::Value &params, bool &ok) {
+std::string http_to_ws(const std::string &httpUrl) {
+    if (httpUrl.rfind("https://", 0) == 0) {
+        return std::string("wss://") + httpUrl.substr(8);
+    } else if (httpUrl.rfind("http://", 0) == 0) {
+        return std::string("ws://") + httpUrl.substr(7);
+    }
+    return httpUrl;
+}
+
+// timing of the last RPC made on this thread
+static thread_local RpcTiming lastTiming;
+
+RpcTiming last_rpc_timing() {
+    return lastTiming;
+}
+
+// ids for requests sent over HTTP
+static std::atomic<int> httpIdCounter(1);
+
+// when set, RPCs go over this listener's WebSocket instead of HTTP
+static std::atomic<EventListener*> eventChannel(nullptr);
+
+void set_rpc_event_channel(EventListener *listener) {
+    eventChannel = listener;
+}
+
+// send over the event socket (send returns the reply future) and wait for the reply matched by id
+template <typename Send>
+static RpcReply ws_rpc_wait(const char *method, Send send) {
+    auto start = std::chrono::steady_clock::now();
+    RpcReply reply = send().get();
+    lastTiming = RpcTiming();
+    lastTiming.total_us = (long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    lastTiming.ttfb_us = lastTiming.total_us;
+    lastTiming.reused = true;
+    if (!reply.ok) LogLine(LogLevel::Warn, "json_rpc") << "websocket request " << method << " failed: " << reply.error;
+    return reply;
+}
+
+static Json::Value ws_rpc_request(EventListener &channel, const std::string &method, const Json::Value &params, bool &ok) {
+    RpcReply reply = ws_rpc_wait(method.c_str(), [&] { return channel.request(method, params, 6000); });
+    ok = reply.ok;
+    return ok ? std::move(reply.response) : Json::Value();
+}
+
+// perform JSON-RPC over the event socket if selected, else the shared keep-alive HTTP transport;
+// params is a Json::Value (object or array)
+static Json::Value json_rpc_send(const std::string &controllerUrl, const std::string &method, const Json::Value &params, bool &ok) {
     ok = false;
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-        std::cerr << "[json_rpc] curl_easy_init failed\n";
+
+    EventListener *channel = eventChannel.load();
+    if (channel && channel->isConnected() && !EventListener::onCallbackThread()) {
+        return ws_rpc_request(*channel, method, params, ok);
+    }
+
+    std::string payloadStr = encode_rpc_request(httpIdCounter.fetch_add(1, std::memory_order_relaxed), method, params);
+    std::string responseStr;
+    long httpCode = 0;
+
+    if (!HttpTransport::shared().post(controllerUrl, payloadStr, responseStr, httpCode, lastTiming)) {
         return Json::Value();
     }
+    if (httpCode >= 200 && httpCode < 300) {
+        Json::Value respJson;
+        if (parseJson(responseStr, respJson)) {
+            ok = true;
+            return respJson;
+        } else {
+            LogLine(LogLevel::Warn, "json_rpc") << "parse error for response: " << responseStr;
+        }
+    } else {
+        LogLine(LogLevel::Warn, "json_rpc") << "HTTP code: " << httpCode << " body: " << responseStr;
+    }
+    return Json::Value();
+}
 
-    static int idCounter = 1;
-    Json::Value payload;
-    payload["jsonrpc"] = "2.0";
-    payload["id"] = idCounter++;
-    payload["method"] = method;
-    payload["params"] = params;
+// copy-on-write list of RPC observers
+typedef std::vector<std::pair<int, RpcObserver>> ObserverList;
+static std::mutex observersMutex;
+static std::shared_ptr<const ObserverList> observers = std::make_shared<ObserverList>();
+static int nextObserverId = 1;
 
-    std::string payloadStr = jsonToString(payload);
-    std::string responseStr;
-    struct curl_slist *headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-
-    curl_easy_setopt(curl, CURLOPT_URL, controllerUrl.c_str());
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payloadStr.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)payloadStr.size());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseStr);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 6L);
-
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        std::cerr << "[json_rpc] curl perform error: " << curl_easy_strerror(res) << "\n";
+int add_rpc_observer(RpcObserver observer) {
+    std::lock_guard<std::mutex> g(observersMutex);
+    auto next = std::make_shared<ObserverList>(*std::atomic_load(&observers));
+    int id = nextObserverId++;
+    next->emplace_back(id, std::move(observer));
+    std::atomic_store(&observers, std::shared_ptr<const ObserverList>(std::move(next)));
+    return id;
+}
+
+void remove_rpc_observer(int id) {
+    std::lock_guard<std::mutex> g(observersMutex);
+    auto next = std::make_shared<ObserverList>(*std::atomic_load(&observers));
+    for (auto it = next->begin(); it != next->end(); ++it) {
+        if (it->first == id) { next->erase(it); break; }
+    }
+    std::atomic_store(&observers, std::shared_ptr<const ObserverList>(std::move(next)));
+}
+
+const Json::Value &RpcEvent::params() const {
+    if (paramsValue) return *paramsValue;
+    if (!paramsParsed) {
+        paramsParsed = true;
+        Json::Value req;
+        if (requestText && parseJson(*requestText, req)) parsedParams = req["params"];
+    }
+    return parsedParams;
+}
+
+const Json::Value &RpcEvent::response() const {
+    if (responseValue) return *responseValue;
+    if (!responseParsed) {
+        responseParsed = true;
+        if (ok && responseText && !parseJson(*responseText, parsedResponse)) parsedResponse = Json::Value();
+    }
+    return parsedResponse;
+}
+
+static uint64_t us_since(std::chrono::steady_clock::time_point start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void notify_observers(const std::string &url, const std::string &method, const Json::Value &params, const Json::Value &response,
+                             bool ok, std::chrono::steady_clock::time_point start) {
+    auto obs = std::atomic_load(&observers);
+    if (obs->empty()) return;
+    RpcEvent ev(url, method, ok, start, us_since(start));
+    ev.paramsValue = &params;
+    ev.responseValue = &response;
+    for (const auto &o : *obs) o.second(ev);
+}
+
+// json_rpc_send + observer notification; used by every wrapper
+static Json::Value json_rpc_request(const std::string &controllerUrl, const std::string &method, const Json::Value &params, bool &ok) {
+    auto start = std::chrono::steady_clock::now();
+    Json::Value resp = json_rpc_send(controllerUrl, method, params, ok);
+    notify_observers(controllerUrl, method, params, resp, ok, start);
+    return resp;
+}
+
+int next_rpc_id() {
+    return httpIdCounter.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool json_rpc_post(const std::string &controllerUrl, const char *method, int id, const std::string &request, std::string &response,
+                   const void *typedMethod, const void *typedParams) {
+    std::string url = normalize_controller_url(controllerUrl);
+    auto start = std::chrono::steady_clock::now();
+    bool ok = false;
+    response.clear();
+
+    EventListener *channel = eventChannel.load();
+    if (channel && channel->isConnected() && !EventListener::onCallbackThread()) {
+        // the bytes go out as encoded; the reply comes back as received
+        RpcReply reply = ws_rpc_wait(method, [&] { return channel->request((uint32_t)id, request, 6000); });
+        ok = reply.ok;
+        if (ok) response = std::move(reply.text);
     } else {
         long httpCode = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-        if (httpCode >= 200 && httpCode < 300) {
-            Json::Value respJson;
-            if (parseJson(responseStr, respJson)) {
-                ok = true;
-                curl_slist_free_all(headers);
-                curl_easy_cleanup(curl);
-                return respJson;
-            } else {
-                std::cerr << "[json_rpc] parse error for response: " << responseStr << "\n";
+        if (HttpTransport::shared().post(url, request, response, httpCode, lastTiming)) {
+            if (httpCode >= 200 && httpCode < 300) ok = true;
+            else LogLine(LogLevel::Warn, "json_rpc") << "HTTP code: " << httpCode << " body: " << response;
+        }
+    }
+
+    // observers get the bytes; they parse only what they look at
+    auto obs = std::atomic_load(&observers);
+    if (!obs->empty()) {
+        std::string name(method);
+        RpcEvent ev(url, name, ok, start, us_since(start));
+        ev.requestText = &request;
+        ev.responseText = &response;
+        ev.typedMethod = typedMethod;
+        ev.typedParams = typedParams;
+        for (const auto &o : *obs) o.second(ev);
+    }
+    return ok;
+}
+
+static void fill_result(RpcResult &r, const Json::Value &resp) {
+    r.response = resp;
+    r.ok = resp.isObject() && !resp.isMember("error");
+}
+
+// one keep-alive round trip per call, in order
+static void sequential_batch(const std::string &url, const std::vector<RpcCall> &calls, std::vector<RpcResult> &results) {
+    for (size_t i = 0; i < calls.size(); ++i) {
+        bool ok = false;
+        auto resp = json_rpc_send(url, calls[i].method, calls[i].params, ok);
+        if (ok) fill_result(results[i], resp);
+    }
+}
+
+enum class BatchOutcome { Answered, Rejected, Failed };
+
+// all calls in one JSON-RPC 2.0 batch array over HTTP; replies matched back by id
+static BatchOutcome http_batch(const std::string &url, const std::vector<RpcCall> &calls, std::vector<RpcResult> &results) {
+    Json::Value batch(Json::arrayValue);
+    std::vector<int> ids(calls.size());
+    for (size_t i = 0; i < calls.size(); ++i) {
+        Json::Value payload;
+        ids[i] = httpIdCounter.fetch_add(1, std::memory_order_relaxed);
+        payload["jsonrpc"] = "2.0";
+        payload["id"] = ids[i];
+        payload["method"] = calls[i].method;
+        payload["params"] = calls[i].params;
+        batch.append(payload);
+    }
+
+    std::string responseStr;
+    long httpCode = 0;
+    // no reply or a server error: the calls may have run, so they are not sent again
+    if (!HttpTransport::shared().post(url, jsonToString(batch), responseStr, httpCode, lastTiming)) {
+        LogLine(LogLevel::Warn, "json_rpc_batch") << "batch failed, not resent";
+        return BatchOutcome::Failed;
+    }
+    Json::Value resp;
+    bool answered = httpCode >= 200 && httpCode < 300;
+    if (!answered && (httpCode < 400 || httpCode >= 500)) {
+        LogLine(LogLevel::Warn, "json_rpc_batch") << "batch failed (HTTP " << httpCode << "), not resent: " << responseStr;
+        return BatchOutcome::Failed;
+    }
+    if (!answered || !parseJson(responseStr, resp) || !resp.isArray()) {
+        LogLine(LogLevel::Warn, "json_rpc_batch") << "batch not accepted (HTTP " << httpCode << "): " << responseStr;
+        return BatchOutcome::Rejected;
+    }
+    for (const auto &r : resp) {
+        if (!r.isObject() || !r["id"].isInt()) continue;
+        int id = r["id"].asInt();
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i] == id) { fill_result(results[i], r); break; }
+        }
+    }
+    return BatchOutcome::Answered;
+}
+
+// all calls written back to back on the event socket, then all replies awaited
+static void pipelined_batch(EventListener &channel, const std::vector<RpcCall> &calls, std::vector<RpcResult> &results) {
+    std::vector<std::future<RpcReply>> replies;
+    replies.reserve(calls.size());
+    for (const auto &c : calls) replies.push_back(channel.request(c.method, c.params, 6000));
+    for (size_t i = 0; i < replies.size(); ++i) {
+        RpcReply r = replies[i].get();
+        if (r.ok) fill_result(results[i], r.response);
+        else LogLine(LogLevel::Warn, "json_rpc_batch") << calls[i].method << " failed: " << r.error;
+    }
+}
+
+bool json_rpc_batch(const std::string &controllerUrl, const std::vector<RpcCall> &calls, std::vector<RpcResult> &results, BatchMode mode) {
+    results.assign(calls.size(), RpcResult());
+    if (calls.empty()) return true;
+    std::string url = normalize_controller_url(controllerUrl);
+    auto start = std::chrono::steady_clock::now();
+
+    EventListener *channel = eventChannel.load();
+    bool haveChannel = channel && channel->isConnected() && !EventListener::onCallbackThread();
+    bool all = true;
+    for (size_t begin = 0, end; begin < calls.size(); begin = end) {
+        // one round trip: up to the next call that has to wait for the ones before it
+        for (end = begin + 1; end < calls.size() && !calls[end].after; ++end) {}
+        std::vector<RpcCall> stage(calls.begin() + begin, calls.begin() + end);
+        std::vector<RpcResult> stageResults(stage.size());
+        if (mode == BatchMode::Pipeline && haveChannel) {
+            pipelined_batch(*channel, stage, stageResults);
+        } else if (mode == BatchMode::Pipeline || http_batch(url, stage, stageResults) == BatchOutcome::Rejected) {
+            // no socket to pipeline on, or the controller rejected the batch array
+            sequential_batch(url, stage, stageResults);
+        }
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = std::move(stageResults[i - begin]);
+            all = all && results[i].ok;
+        }
+    }
+
+    for (size_t i = 0; i < calls.size(); ++i) {
+        notify_observers(url, calls[i].method, calls[i].params, results[i].response, results[i].ok, start);
+    }
+    return all;
+}
+
+bool json_rpc_call(const std::string &controllerUrl, const std::string &method, const Json::Value &params, Json::Value &response) {
+    bool ok = false;
+    response = json_rpc_request(normalize_controller_url(controllerUrl), method, params, ok);
+    return ok && response.isObject() && !response.isMember("error");
+}
+
+// async calls on the event socket. A listener request cannot be withdrawn, so whichever of the reply
+// and cancel_rpc comes first takes the completion out of the table and runs it; ids have the top bit
+// set to keep them apart from AsyncHttpTransport's.
+typedef std::function<void(const RpcReply&)> WsCompletion;
+static const uint64_t kWsRpcIdBit = 1ull << 63;
+static std::atomic<uint64_t> wsRpcCounter(1);
+static std::mutex wsRpcMutex;
+static std::map<uint64_t, WsCompletion> wsRpcPending;
+
+static WsCompletion take_ws_rpc(uint64_t id) {
+    std::lock_guard<std::mutex> g(wsRpcMutex);
+    auto it = wsRpcPending.find(id);
+    if (it == wsRpcPending.end()) return WsCompletion();
+    WsCompletion f = std::move(it->second);
+    wsRpcPending.erase(it);
+    return f;
+}
+
+uint64_t json_rpc_async(const std::string &controllerUrl, const std::string &method, const Json::Value &params, RpcCallback done,
+                        long timeoutMs) {
+    std::string url = normalize_controller_url(controllerUrl);
+    auto start = std::chrono::steady_clock::now();
+
+    EventListener *channel = eventChannel.load();
+    if (channel && channel->isConnected()) {
+        uint64_t id = kWsRpcIdBit | wsRpcCounter.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> g(wsRpcMutex);
+            wsRpcPending[id] = [url, method, params, done, start](const RpcReply &reply) {
+                RpcTiming timing;
+                timing.total_us = (long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+                timing.ttfb_us = timing.total_us;
+                timing.reused = true;
+                if (!reply.ok && reply.error != "cancelled") {
+                    LogLine(LogLevel::Warn, "json_rpc") << "websocket request " << method << " failed: " << reply.error;
+                }
+                notify_observers(url, method, params, reply.response, reply.ok, start);
+                if (done) done(reply.ok && reply.response.isObject() && !reply.response.isMember("error"), reply.response, timing);
+            };
+        }
+        channel->request(method, params, [id](const RpcReply &reply) {
+            if (WsCompletion f = take_ws_rpc(id)) f(reply);
+        }, timeoutMs > 0 ? (unsigned)timeoutMs : 6000);
+        return id;
+    }
+
+    return AsyncHttpTransport::shared().post(url, encode_rpc_request(httpIdCounter.fetch_add(1, std::memory_order_relaxed), method, params),
+        [url, method, params, done, start](bool sent, long httpCode, const std::string &body, const RpcTiming &timing) {
+            Json::Value resp;
+            bool ok = false;
+            if (sent && httpCode >= 200 && httpCode < 300) {
+                ok = parseJson(body, resp);
+                if (!ok) LogLine(LogLevel::Warn, "json_rpc") << "parse error for response: " << body;
+            } else if (sent) {
+                LogLine(LogLevel::Warn, "json_rpc") << method << " HTTP code: " << httpCode << " body: " << body;
             }
-        } else {
-            std::cerr << "[json_rpc] HTTP code: " << httpCode << " body: " << responseStr << "\n";
+            notify_observers(url, method, params, resp, ok, start);
+            if (done) done(ok && resp.isObject() && !resp.isMember("error"), resp, timing);
+        }, timeoutMs);
+}
+
+void cancel_rpc(uint64_t id) {
+    if (id & kWsRpcIdBit) {
+        if (WsCompletion f = take_ws_rpc(id)) {
+            RpcReply reply;
+            reply.error = "cancelled";
+            f(reply);
         }
+        return;
     }
+    AsyncHttpTransport::shared().cancel(id);
+}
 
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-    return Json::Value();
+static bool run_sequence(const char *tag, const std::string &controllerUrl, const std::vector<RpcCall> &calls, BatchMode mode) {
+    std::vector<RpcResult> results;
+    bool ok = json_rpc_batch(controllerUrl, calls, results, mode);
+    for (size_t i = 0; i < calls.size(); ++i) {
+        if (!log_enabled(LogLevel::Info)) break;
+        log_write(LogLevel::Info, tag, calls[i].method + " -> " + (results[i].ok ? jsonToString(results[i].response) : std::string("FAILED")));
+    }
+    return ok;
 }
 
 /* Implementations */
 
-bool activate_service(const std::string &controllerUrl) {
-    bool ok = false;
-    Json::Value params;
-    params["callsign"] = "org.rdk.MiracastService";
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "Controller.activate", params, ok);
-    if (!ok) return false;
-    std::cout << "[activate_service] " << jsonToString(resp) << "\n";
+// typed call; prints the raw reply under tag like the other wrappers
+template <typename P, typename R>
+static bool typed_call(const char *tag, const std::string &controllerUrl, const RpcMethod<P, R> &method, const P &params, R &result) {
+    if (!rpc_call(controllerUrl, method, params, result)) return false;
+    log_write(LogLevel::Info, tag, rpc_last_response());
     return true;
 }
 
+template <typename P>
+static bool typed_call(const char *tag, const std::string &controllerUrl, const RpcMethod<P, RpcNone> &method, const P &params) {
+    RpcNone none;
+    return typed_call(tag, controllerUrl, method, params, none);
+}
+
+bool activate_service(const std::string &controllerUrl) {
+    return typed_call("activate_service", controllerUrl, kControllerActivate, CallsignParams{"org.rdk.MiracastService"});
+}
+
 bool deactivate_service(const std::string &controllerUrl) {
-    bool ok = false;
-    Json::Value params;
-    params["callsign"] = "org.rdk.MiracastService";
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "Controller.deactivate", params, ok);
-    if (!ok) return false;
-    std::cout << "[deactivate_service] " << jsonToString(resp) << "\n";
-    return true;
+    return typed_call("deactivate_service", controllerUrl, kControllerDeactivate, CallsignParams{"org.rdk.MiracastService"});
 }
 
 bool activate_player(const std::string &controllerUrl) {
-    bool ok = false;
-    Json::Value params;
-    params["callsign"] = "org.rdk.MiracastPlayer";
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "Controller.activate", params, ok);
-    if (!ok) return false;
-    std::cout << "[activate_player] " << jsonToString(resp) << "\n";
-    return true;
+    return typed_call("activate_player", controllerUrl, kControllerActivate, CallsignParams{"org.rdk.MiracastPlayer"});
 }
 
 bool deactivate_player(const std::string &controllerUrl) {
-    bool ok = false;
-    Json::Value params;
-    params["callsign"] = "org.rdk.MiracastPlayer";
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "Controller.deactivate", params, ok);
-    if (!ok) return false;
-    std::cout << "[deactivate_player] " << jsonToString(resp) << "\n";
-    return true;
+    return typed_call("deactivate_player", controllerUrl, kControllerDeactivate, CallsignParams{"org.rdk.MiracastPlayer"});
 }
 
 bool set_enable(const std::string &controllerUrl, bool enabled) {
-    bool ok = false;
-    Json::Value params;
-    params["enabled"] = enabled;
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "org.rdk.MiracastService.setEnable", params, ok);
-    if (!ok) return false;
-    std::cout << "[set_enable] " << jsonToString(resp) << "\n";
-    return true;
+    return typed_call("set_enable", controllerUrl, kSetEnable, EnableParams{enabled});
 }
 
 bool get_enable(const std::string &controllerUrl, bool &enabled_out) {
-    bool ok = false;
-    Json::Value params = Json::Value(Json::arrayValue); // no params
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "org.rdk.MiracastService.getEnable", params, ok);
-    if (!ok) return false;
-    std::cout << "[get_enable] " << jsonToString(resp) << "\n";
-    try {
-        if (resp.isMember("result") && resp["result"].isArray() && resp["result"].size() > 0) {
-            const Json::Value &r = resp["result"][0];
-            if (r.isMember("enabled")) {
-                enabled_out = r["enabled"].asBool();
-                return true;
-            }
-        }
-    } catch(...) {}
-    return false;
+    // Thunder answers {"enabled":..,"success":..}; older builds wrapped it in an array (see rpc_decode)
+    EnableResult result;
+    if (!typed_call("get_enable", controllerUrl, kGetEnable, RpcNone(), result)) return false;
+    if (!result.enabled.present) return false;
+    enabled_out = result.enabled.value;
+    return true;
 }
 
 bool accept_client_connection(const std::string &controllerUrl, const std::string &requestStatus) {
-    bool ok = false;
-    Json::Value params;
-    params["requestStatus"] = requestStatus;
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "org.rdk.MiracastService.acceptClientConnection", params, ok);
-    if (!ok) return false;
-    std::cout << "[accept_client_connection] " << jsonToString(resp) << "\n";
-    return true;
+    return typed_call("accept_client_connection", controllerUrl, kAcceptClientConnection, AcceptParams{requestStatus});
 }
 
 bool stop_client_connection(const std::string &controllerUrl, const std::string &mac, const std::string &name) {
-    bool ok = false;
-    Json::Value params;
-    params["mac"] = mac;
-    params["name"] = name;
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "org.rdk.MiracastService.stopClientConnection", params, ok);
-    if (!ok) return false;
-    std::cout << "[stop_client_connection] " << jsonToString(resp) << "\n";
-    return true;
+    return typed_call("stop_client_connection", controllerUrl, kStopClientConnection, ClientParams{mac, name});
 }
 
-bool update_player_state(const std::string &controllerUrl, const std::string &mac, const std::string &state, int reason_code, const std::string &reason) {
-    bool ok = false;
+// Json::Value form, for json_rpc_call users and as the DOM baseline in mcastbench
+Json::Value player_state_params(const std::string &mac, const std::string &state, int reason_code, const std::string &reason) {
     Json::Value params;
     params["mac"] = mac;
     params["state"] = state;
     params["reason_code"] = reason_code;
     params["reason"] = reason;
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "org.rdk.MiracastService.updatePlayerState", params, ok);
-    if (!ok) return false;
-    std::cout << "[update_player_state] " << jsonToString(resp) << "\n";
-    return true;
+    return params;
 }
 
-bool player_play_request(const std::string &controllerUrl, const DeviceParameters &device_params, const VideoRectangle &rect) {
-    bool ok = false;
+bool update_player_state(const std::string &controllerUrl, const std::string &mac, const std::string &state, int reason_code, const std::string &reason) {
+    return typed_call("update_player_state", controllerUrl, kUpdatePlayerState, PlayerStateParams{mac, state, reason_code, reason});
+}
+
+Json::Value play_request_params(const DeviceParameters &device_params, const VideoRectangle &rect) {
     Json::Value params;
     Json::Value dev;
     dev["source_dev_ip"] = device_params.source_dev_ip;
@@ -207,27 +493,51 @@ bool player_play_request(const std::string &controllerUrl, const DeviceParameter
     dev["source_dev_name"] = device_params.source_dev_name;
     dev["sink_dev_ip"] = device_params.sink_dev_ip;
     params["device_parameters"] = dev;
-    Json::Value rectv;
-    rectv["X"] = rect.X;
-    rectv["Y"] = rect.Y;
-    rectv["W"] = rect.W;
-    rectv["H"] = rect.H;
-    params["video_rectangle"] = rectv;
-
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "org.rdk.MiracastPlayer.playRequest", params, ok);
-    if (!ok) return false;
-    std::cout << "[player_play_request] " << jsonToString(resp) << "\n";
-    return true;
+    params["video_rectangle"] = video_rectangle_params(rect);
+    return params;
 }
 
-bool player_stop_request(const std::string &controllerUrl, const std::string &mac, const std::string &name, int reason_code) {
-    bool ok = false;
+Json::Value video_rectangle_params(const VideoRectangle &rect) {
     Json::Value params;
-    params["mac"] = mac;
-    params["name"] = name;
-    params["reason_code"] = reason_code;
-    auto resp = json_rpc_request(normalize_controller_url(controllerUrl), "org.rdk.MiracastPlayer.stopRequest", params, ok);
-    if (!ok) return false;
-    std::cout << "[player_stop_request] " << jsonToString(resp) << "\n";
-    return true;
+    params["X"] = rect.X;
+    params["Y"] = rect.Y;
+    params["W"] = rect.W;
+    params["H"] = rect.H;
+    return params;
+}
+
+bool player_play_request(const std::string &controllerUrl, const DeviceParameters &device_params, const VideoRectangle &rect) {
+    return typed_call("player_play_request", controllerUrl, kPlayRequest, PlayRequestParams{device_params, rect});
+}
+
+bool player_stop_request(const std::string &controllerUrl, const std::string &mac, const std::string &name, int reason_code) {
+    return typed_call("player_stop_request", controllerUrl, kStopRequest, StopRequestParams{mac, name, reason_code});
+}
+
+bool player_set_video_rectangle(const std::string &controllerUrl, const VideoRectangle &rect) {
+    return typed_call("player_set_video_rectangle", controllerUrl, kSetVideoRectangle, rect);
+}
+
+bool bring_up(const std::string &controllerUrl, BatchMode mode) {
+    Json::Value service, player, enable;
+    service["callsign"] = "org.rdk.MiracastService";
+    player["callsign"] = "org.rdk.MiracastPlayer";
+    enable["enabled"] = true;
+    return run_sequence("bring_up", controllerUrl, {
+        {"Controller.activate", service},
+        {"Controller.activate", player},
+        {"org.rdk.MiracastService.setEnable", enable, true},
+    }, mode);
+}
+
+bool tear_down(const std::string &controllerUrl, BatchMode mode) {
+    Json::Value service, player, enable;
+    service["callsign"] = "org.rdk.MiracastService";
+    player["callsign"] = "org.rdk.MiracastPlayer";
+    enable["enabled"] = false;
+    return run_sequence("tear_down", controllerUrl, {
+        {"org.rdk.MiracastService.setEnable", enable},
+        {"Controller.deactivate", player, true},
+        {"Controller.deactivate", service},
+    }, mode);
 }
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 #include <json/json.h>
+#include "HttpTransport.h"
 
 struct DeviceParameters {
     std::string source_dev_ip;
@@ -17,6 +22,70 @@ struct VideoRectangle {
     int H;
 };
 
+// http://host/jsonrpc -> ws://host/jsonrpc (https -> wss), where Thunder serves events
+std::string http_to_ws(const std::string &httpUrl);
+
+// timing of the most recent blocking RPC issued by the calling thread (all wrappers share one keep-alive
+// connection); async calls hand theirs to the callback
+RpcTiming last_rpc_timing();
+
+class EventListener;
+
+struct RpcCall {
+    std::string method;
+    Json::Value params;
+    bool after = false;    // json_rpc_batch: needs every earlier call's reply first, so never sent together with them
+};
+
+struct RpcResult {
+    bool ok = false;       // a response arrived for this call and it has no JSON-RPC "error"
+    Json::Value response;  // full response object
+};
+
+enum class BatchMode {
+    Batch,    // one JSON-RPC 2.0 batch array over HTTP (sequential if the controller rejects the array)
+    Pipeline  // all requests written back to back on the event WebSocket (sequential HTTP if none)
+};
+
+// route the wrappers below over listener's already-open WebSocket (replies matched by id);
+// nullptr switches back to HTTP. Calls made from listener callback threads always use HTTP.
+void set_rpc_event_channel(EventListener *listener);
+
+// one completed RPC, as seen by observers. Calls made from encoded bytes (rpc_call) carry the raw
+// request and response; params() and response() only parse them on first use, so an observer should
+// filter on method before touching either. rpc_params (RpcMethods.h) gives the typed params instead.
+struct RpcEvent {
+    RpcEvent(const std::string &url, const std::string &m, bool received, std::chrono::steady_clock::time_point t0, uint64_t elapsedUs)
+        : controllerUrl(url), method(m), ok(received), start(t0), us(elapsedUs) {}
+
+    const std::string &controllerUrl;
+    const std::string &method;
+    bool ok;                      // a response was received
+    std::chrono::steady_clock::time_point start;
+    uint64_t us;                  // start -> response
+
+    const Json::Value &params() const;
+    const Json::Value &response() const;  // null if ok is false or the body is not JSON
+
+    // set by the caller, whichever form it has
+    const Json::Value *paramsValue = nullptr;
+    const Json::Value *responseValue = nullptr;
+    const std::string *requestText = nullptr;   // full encoded request
+    const std::string *responseText = nullptr;  // raw response body
+    const void *typedMethod = nullptr;          // RpcMethod descriptor and its params, for rpc_call
+    const void *typedParams = nullptr;
+
+private:
+    mutable Json::Value parsedParams, parsedResponse;
+    mutable bool paramsParsed = false, responseParsed = false;
+};
+typedef std::function<void(const RpcEvent&)> RpcObserver;
+
+// observer called (on the calling thread) after every RPC made by the wrappers and json_rpc_batch;
+// returns an id for remove_rpc_observer
+int add_rpc_observer(RpcObserver observer);
+void remove_rpc_observer(int id);
+
 // Miracast RPC wrappers (no simulation): return true on success, false on failure
 bool activate_service(const std::string &controllerUrl);
 bool deactivate_service(const std::string &controllerUrl);
@@ -31,4 +100,46 @@ bool stop_client_connection(const std::string &controllerUrl, const std::string
 bool update_player_state(const std::string &controllerUrl, const std::string &mac, const std::string &state, int reason_code, const std::string &reason);
 
 bool player_play_request(const std::string &controllerUrl, const DeviceParameters &device_params, const VideoRectangle &rect);
-bool player_stop_request(const std::string &controllerUrl, const std::string &mac, const std::string &name, int reason_code);
\ No newline at end of file
+bool player_stop_request(const std::string &controllerUrl, const std::string &mac, const std::string &name, int reason_code);
+// move/resize the video of the running session
+bool player_set_video_rectangle(const std::string &controllerUrl, const VideoRectangle &rect);
+
+// wire format shared by every RPC path (exposed for the benchmarks)
+std::string encode_rpc_request(int id, const std::string &method, const Json::Value &params);
+bool decode_rpc_response(const std::string &body, Json::Value &out);
+Json::Value play_request_params(const DeviceParameters &device_params, const VideoRectangle &rect);
+Json::Value video_rectangle_params(const VideoRectangle &rect);
+Json::Value player_state_params(const std::string &mac, const std::string &state, int reason_code, const std::string &reason);
+
+// send an already encoded request (see RpcMethods.h) and return the raw response body; same transport
+// selection, timing and observer notification as the Json::Value calls. False on transport/HTTP error.
+// id is the one in the request (from next_rpc_id); the bytes go out unchanged on either transport.
+// typedMethod/typedParams are handed to observers as is (see rpc_params).
+bool json_rpc_post(const std::string &controllerUrl, const char *method, int id, const std::string &request, std::string &response,
+                   const void *typedMethod = nullptr, const void *typedParams = nullptr);
+int next_rpc_id();
+
+// any method: response is the full response object; returns true if it arrived without a JSON-RPC "error"
+bool json_rpc_call(const std::string &controllerUrl, const std::string &method, const Json::Value &params, Json::Value &response);
+
+// non-blocking: the request goes out on AsyncHttpTransport::shared(), or on the event WebSocket when
+// set_rpc_event_channel selected it, and done runs on the transport (or listener) thread once the response
+// arrives (ok as in json_rpc_call), with the call's timing. Observers are notified as for blocking calls.
+// done must not block. timeoutMs bounds the whole call (0 = 6 s); the returned id can be passed to cancel_rpc.
+typedef std::function<void(bool ok, const Json::Value &response, const RpcTiming &timing)> RpcCallback;
+uint64_t json_rpc_async(const std::string &controllerUrl, const std::string &method, const Json::Value &params, RpcCallback done,
+                        long timeoutMs = 0);
+// abort an async call still in flight; its callback runs with ok=false and a null response
+void cancel_rpc(uint64_t id);
+
+// send several calls in one round trip; results[i] matches calls[i]. Returns true if all succeeded.
+// Neither a batch nor a pipeline has an execution order, so a call marked after starts a new round trip
+// once all before it were answered. A batch that failed in transport is not
+// resent: the controller may have executed it. Only an explicit rejection (HTTP 4xx, or a reply that is
+// not an array) falls back to one call at a time.
+bool json_rpc_batch(const std::string &controllerUrl, const std::vector<RpcCall> &calls, std::vector<RpcResult> &results, BatchMode mode = BatchMode::Batch);
+
+// activate service + player and enable discovery / the reverse: the two plugins in one batch, the enable
+// state after the service is up / before it goes down
+bool bring_up(const std::string &controllerUrl, BatchMode mode = BatchMode::Batch);
+bool tear_down(const std::string &controllerUrl, BatchMode mode = BatchMode::Batch);
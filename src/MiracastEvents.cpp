@@ -0,0 +1,85 @@
+#include "MiracastEvents.h"
+#include <cstring>
+
+const char *const kMiracastService = "org.rdk.MiracastService";
+const char *const kMiracastPlayer = "org.rdk.MiracastPlayer";
+
+// direct member lookup, no member-name enumeration; nullptr if absent
+static const Json::Value *field(const Json::Value &obj, const char *key) {
+    if (!obj.isObject()) return nullptr;
+    return obj.find(key, key + strlen(key));
+}
+
+static bool get_string(const Json::Value &obj, const char *key, std::string &out) {
+    const Json::Value *v = field(obj, key);
+    if (!v || !v->isString()) return false;
+    out = v->asString();
+    return true;
+}
+
+static bool get_int(const Json::Value &obj, const char *key, int &out) {
+    const Json::Value *v = field(obj, key);
+    if (!v) return false;
+    if (v->isInt()) { out = v->asInt(); return true; }
+    if (v->isString()) {
+        try { out = std::stoi(v->asString()); return true; } catch (...) {}
+    }
+    return false;
+}
+
+bool decode_event(const Json::Value &params, ClientConnectionRequest &out) {
+    return get_string(params, "mac", out.mac) && get_string(params, "name", out.name);
+}
+
+bool decode_event(const Json::Value &params, ClientConnectionError &out) {
+    if (!get_string(params, "mac", out.mac)) return false;
+    get_string(params, "name", out.name);
+    const Json::Value *code = field(params, "error_code");
+    if (code) out.error_code = code->isString() ? code->asString() : code->toStyledString();
+    get_string(params, "reason", out.reason);
+    return true;
+}
+
+bool decode_event(const Json::Value &params, LaunchRequest &out) {
+    const Json::Value *dev = field(params, "device_parameters");
+    if (!dev) return false;
+    get_string(*dev, "source_dev_ip", out.device.source_dev_ip);
+    get_string(*dev, "sink_dev_ip", out.device.sink_dev_ip);
+    get_string(*dev, "source_dev_name", out.device.source_dev_name);
+    return get_string(*dev, "source_dev_mac", out.device.source_dev_mac);
+}
+
+bool decode_event(const Json::Value &params, PlayerStateChange &out) {
+    if (!get_string(params, "mac", out.mac) || !get_string(params, "state", out.state)) return false;
+    get_string(params, "name", out.name);
+    get_int(params, "reason_code", out.reason_code);
+    get_string(params, "reason", out.reason);
+    return true;
+}
+
+// adapt a typed callback to the raw EventHandler signature
+template <typename Event>
+static EventHandler typed(std::function<void(const Event&)> cb) {
+    return [cb](const Json::Value &params, EventTime received) {
+        Event ev;
+        if (!decode_event(params, ev)) return;
+        ev.received = received;
+        cb(ev);
+    };
+}
+
+void on_client_connection_request(EventListener &listener, std::function<void(const ClientConnectionRequest&)> cb) {
+    listener.addEventHandler(kMiracastService, "onClientConnectionRequest", typed(std::move(cb)));
+}
+
+void on_client_connection_error(EventListener &listener, std::function<void(const ClientConnectionError&)> cb) {
+    listener.addEventHandler(kMiracastService, "onClientConnectionError", typed(std::move(cb)));
+}
+
+void on_launch_request(EventListener &listener, std::function<void(const LaunchRequest&)> cb) {
+    listener.addEventHandler(kMiracastService, "onLaunchRequest", typed(std::move(cb)));
+}
+
+void on_player_state_change(EventListener &listener, std::function<void(const PlayerStateChange&)> cb) {
+    listener.addEventHandler(kMiracastPlayer, "onStateChange", typed(std::move(cb)));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <json/json.h>
+#include "EventListener.h"
+#include "Miracast.h"
+
+// Typed Miracast notifications, decoded by direct field lookup from the event "params".
+
+struct ClientConnectionRequest {
+    std::string mac;
+    std::string name;
+    EventTime received;
+};
+
+struct ClientConnectionError {
+    std::string mac;
+    std::string name;
+    std::string error_code;
+    std::string reason;
+    EventTime received;
+};
+
+struct LaunchRequest {
+    DeviceParameters device;
+    EventTime received;
+};
+
+struct PlayerStateChange {
+    std::string name;
+    std::string mac;
+    std::string state;  // INITIATED, INPROGRESS, PLAYING, STOPPED
+    int reason_code = 0;
+    std::string reason;
+    EventTime received;
+};
+
+extern const char *const kMiracastService;  // "org.rdk.MiracastService"
+extern const char *const kMiracastPlayer;   // "org.rdk.MiracastPlayer"
+
+// decoders return false if a required field is missing
+bool decode_event(const Json::Value &params, ClientConnectionRequest &out);
+bool decode_event(const Json::Value &params, ClientConnectionError &out);
+bool decode_event(const Json::Value &params, LaunchRequest &out);
+bool decode_event(const Json::Value &params, PlayerStateChange &out);
+
+// register typed handlers on listener (MiracastService / MiracastPlayer events)
+void on_client_connection_request(EventListener &listener, std::function<void(const ClientConnectionRequest&)> cb);
+void on_client_connection_error(EventListener &listener, std::function<void(const ClientConnectionError&)> cb);
+void on_launch_request(EventListener &listener, std::function<void(const LaunchRequest&)> cb);
+void on_player_state_change(EventListener &listener, std::function<void(const PlayerStateChange&)> cb);
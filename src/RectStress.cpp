@@ -0,0 +1,426 @@
+#include "RectStress.h"
+#include "LatencyHistogram.h"
+#include "Log.h"
+#include "MiracastEvents.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+typedef std::chrono::steady_clock clock_type;
+
+static const char *pattern_name(RectPattern p) {
+    switch (p) {
+    case RectPattern::Random: return "random";
+    case RectPattern::Sweep: return "sweep";
+    case RectPattern::Corners: return "corners";
+    case RectPattern::List: return "list";
+    }
+    return "?";
+}
+
+bool parse_rect_pattern(const std::string &spec, RectStressOptions &opts, std::string &error) {
+    if (spec == "random") opts.pattern = RectPattern::Random;
+    else if (spec == "sweep") opts.pattern = RectPattern::Sweep;
+    else if (spec == "corners") opts.pattern = RectPattern::Corners;
+    else {
+        std::ifstream in(spec);
+        if (!in) {
+            error = "unknown pattern or unreadable file: " + spec;
+            return false;
+        }
+        std::vector<VideoRectangle> seq;
+        std::string line;
+        for (unsigned n = 1; std::getline(in, line); ++n) {
+            std::istringstream iss(line);
+            VideoRectangle r;
+            if (!(iss >> r.X)) continue;  // blank line or '#' comment
+            if (!(iss >> r.Y >> r.W >> r.H) || r.W <= 0 || r.H <= 0) {
+                error = spec + ":" + std::to_string(n) + ": expected X Y W H";
+                return false;
+            }
+            seq.push_back(r);
+        }
+        if (seq.empty()) {
+            error = spec + ": no rectangles";
+            return false;
+        }
+        opts.pattern = RectPattern::List;
+        opts.sequence = seq;
+    }
+    return true;
+}
+
+enum class ChangeStatus { Waiting, InFlight, Acked, Dropped, Coalesced };
+
+static const char *status_name(ChangeStatus s) {
+    switch (s) {
+    case ChangeStatus::Waiting: return "unsent";
+    case ChangeStatus::InFlight: return "in_flight";
+    case ChangeStatus::Acked: return "acked";
+    case ChangeStatus::Dropped: return "dropped";
+    case ChangeStatus::Coalesced: return "coalesced";
+    }
+    return "?";
+}
+
+struct RectChange {
+    VideoRectangle rect;
+    clock_type::time_point due, sent, done;
+    ChangeStatus status = ChangeStatus::Waiting;
+    std::string states;   // attributed onStateChange states, space separated
+    std::string error;
+};
+
+struct RectStress::Impl {
+    std::string url;
+    RectStressOptions opts;
+    std::atomic<bool> stopRequested{false};
+    bool attached = false;
+    std::mt19937 rng;
+
+    std::mutex mtx;
+    std::condition_variable changed;
+    std::string mac;                  // the session under test
+    bool playing = false;
+    bool running = false;             // attribute events
+    bool sessionLost = false;
+    std::string lostReason;
+    // only the changes that can still change: in flight, the last sent (events are attributed to it)
+    // and the pending one; the rest are counted and, with changesFile, written out as they finish
+    std::map<uint64_t, RectChange> live;
+    long pending = -1;                // due but not sent yet
+    long lastSent = -1;
+    unsigned inFlight = 0;
+    std::ofstream csv;
+
+    // results of the last run
+    clock_type::time_point start;
+    uint64_t changes = 0, sent = 0, acked = 0, dropped = 0, coalesced = 0, unsent = 0, unattributed = 0;
+    std::map<std::string, uint64_t> states;
+    LatencyHistogram latency;         // due -> reply
+    LatencyHistogram service;         // sent -> reply
+    LatencyHistogram eventLatency;    // sent -> first state event attributed to the change
+    double elapsedS = 0;
+
+    Impl(const std::string &u, const RectStressOptions &o): url(u), opts(o), rng(o.seed) {}
+
+    VideoRectangle scaled(int w) const {
+        return VideoRectangle{0, 0, w, (int)((int64_t)w * opts.screenH / opts.screenW)};
+    }
+
+    VideoRectangle rect_at(uint64_t i) {
+        const int W = opts.screenW, H = opts.screenH;
+        const int minW = std::max(16, std::min(opts.minW, W));
+        VideoRectangle r{0, 0, W, H};
+        switch (opts.pattern) {
+        case RectPattern::Random: {
+            r = scaled(std::uniform_int_distribution<int>(minW, W)(rng));
+            r.X = std::uniform_int_distribution<int>(0, W - r.W)(rng);
+            r.Y = std::uniform_int_distribution<int>(0, H - r.H)(rng);
+            break;
+        }
+        case RectPattern::Sweep: {
+            uint64_t n = std::max(1u, opts.sweepSteps);
+            uint64_t p = i % (2 * n);
+            uint64_t step = p <= n ? p : 2 * n - p;
+            r = scaled(minW + (int)((int64_t)(W - minW) * (int64_t)step / (int64_t)n));
+            r.X = W - r.W;
+            r.Y = H - r.H;
+            break;
+        }
+        case RectPattern::Corners: {
+            r = scaled(std::max(minW, W / 4));
+            unsigned corner = i % 4;  // TL, TR, BR, BL
+            r.X = corner == 1 || corner == 2 ? W - r.W : 0;
+            r.Y = corner >= 2 ? H - r.H : 0;
+            break;
+        }
+        case RectPattern::List:
+            r = opts.sequence[i % opts.sequence.size()];
+            break;
+        }
+        return r;
+    }
+
+    // listener dispatch thread
+    void on_state(const PlayerStateChange &ev) {
+        std::lock_guard<std::mutex> g(mtx);
+        if (mac.empty()) {
+            // no fixed client: the first session to reach PLAYING is the one under test
+            if (ev.state == "PLAYING") mac = ev.mac;
+            else return;
+        }
+        if (ev.mac != mac) return;
+        if (ev.state == "PLAYING") playing = true;
+        if (!running) {
+            changed.notify_all();
+            return;
+        }
+        ++states[ev.state];
+        RectChange *c = lastSent >= 0 ? &live[lastSent] : nullptr;
+        bool open = c && (c->status == ChangeStatus::InFlight ||
+                          ev.received <= c->done + std::chrono::milliseconds(opts.settleMs));
+        if (open) {
+            if (c->states.empty()) eventLatency.record(us_between(c->sent, ev.received));
+            else c->states += ' ';
+            c->states += ev.state;
+        } else {
+            ++unattributed;
+        }
+        if (ev.state == "STOPPED") {
+            sessionLost = true;
+            lostReason = ev.reason.empty() ? "STOPPED" : "STOPPED: " + ev.reason;
+        }
+        changed.notify_all();
+    }
+
+    // transport thread
+    void completed(long idx, bool ok, const Json::Value &response) {
+        auto now = clock_type::now();
+        std::lock_guard<std::mutex> g(mtx);
+        RectChange &c = live[idx];
+        c.done = now;
+        if (ok) {
+            c.status = ChangeStatus::Acked;
+            ++acked;
+            latency.record(us_between(c.due, now));
+            service.record(us_between(c.sent, now));
+        } else {
+            c.status = ChangeStatus::Dropped;
+            ++dropped;
+            c.error = response.isMember("error") ? response["error"].get("message", "error").asString() : "no reply";
+        }
+        LogLine(LogLevel::Debug, "rect") << "#" << idx << " " << c.rect.X << "," << c.rect.Y << " " << c.rect.W << "x" << c.rect.H
+            << " " << status_name(c.status) << " in " << us_between(c.sent, now) / 1000 << " ms";
+        --inFlight;
+        if (idx != lastSent) finish(idx);
+        changed.notify_all();
+    }
+
+    // with mtx held: nothing more can happen to change idx
+    void finish(long idx) {
+        auto it = live.find(idx);
+        if (it == live.end()) return;
+        if (csv.is_open()) {
+            const RectChange &c = it->second;
+            auto ms = [this](clock_type::time_point t) { return t == clock_type::time_point() ? 0.0 : us_between(start, t) / 1000.0; };
+            bool answered = c.status == ChangeStatus::Acked || c.status == ChangeStatus::Dropped;
+            csv << idx << "," << ms(c.due) << "," << ms(c.sent) << "," << ms(c.done) << "," << status_name(c.status) << ","
+                << c.rect.X << "," << c.rect.Y << "," << c.rect.W << "," << c.rect.H << ","
+                << (answered ? us_between(c.due, c.done) / 1000.0 : 0.0) << "," << c.states << "," << c.error << "\n";
+        }
+        live.erase(it);
+    }
+
+    // called with lk held; the call goes out unlocked
+    void send(long idx, std::unique_lock<std::mutex> &lk) {
+        RectChange &c = live[idx];
+        c.status = ChangeStatus::InFlight;
+        c.sent = clock_type::now();
+        // events now go to idx: the previous one is done unless still waiting for its reply
+        if (lastSent >= 0 && live[lastSent].status != ChangeStatus::InFlight) finish(lastSent);
+        lastSent = idx;
+        ++inFlight;
+        ++sent;
+        Json::Value params = video_rectangle_params(c.rect);
+        lk.unlock();
+        Impl *p = this;
+        json_rpc_async(url, "org.rdk.MiracastPlayer.setVideoRectangle", params,
+                       [p, idx](bool ok, const Json::Value &response, const RpcTiming &) { p->completed(idx, ok, response); }, opts.timeoutMs);
+        lk.lock();
+    }
+
+    // a session in PLAYING: the fixed client's (started here) or the first one the events report
+    bool acquire_session(std::string &error) {
+        if (!opts.client.empty()) {
+            {
+                std::lock_guard<std::mutex> g(mtx);
+                mac = opts.client;
+            }
+            DeviceParameters device;
+            device.source_dev_mac = opts.client;
+            device.source_dev_name = "rectstress";
+            if (!player_play_request(url, device, VideoRectangle{0, 0, opts.screenW, opts.screenH})) {
+                error = "playRequest failed";
+                return false;
+            }
+            if (!attached) return true;
+        } else if (!attached) {
+            error = "no event listener attached and no fixed client";
+            return false;
+        }
+        std::unique_lock<std::mutex> lk(mtx);
+        auto deadline = clock_type::now() + std::chrono::milliseconds(opts.eventTimeoutMs);
+        while (!playing) {
+            if (stopRequested || clock_type::now() >= deadline) break;
+            changed.wait_for(lk, std::chrono::milliseconds(100));
+        }
+        if (playing) return true;
+        if (!opts.client.empty()) {
+            LogLine(LogLevel::Warn, "rect") << "no PLAYING event for " << mac << ", continuing";
+            return true;
+        }
+        error = "no session reached PLAYING";
+        return false;
+    }
+};
+
+RectStress::RectStress(const std::string &controllerUrl, const RectStressOptions &opts) : pimpl(new Impl(controllerUrl, opts)) {}
+
+RectStress::~RectStress() {
+    delete pimpl;
+}
+
+void RectStress::attach(EventListener &listener) {
+    pimpl->attached = true;
+    Impl *p = pimpl;
+    on_player_state_change(listener, [p](const PlayerStateChange &ev) { p->on_state(ev); });
+}
+
+bool RectStress::run(std::string &error) {
+    Impl &s = *pimpl;
+    const RectStressOptions &o = s.opts;
+    if (o.rate <= 0 || o.maxInFlight == 0 || o.screenW <= 0 || o.screenH <= 0 ||
+        (o.pattern == RectPattern::List && o.sequence.empty())) {
+        error = "rate, in-flight limit, screen size and pattern must be set";
+        return false;
+    }
+    if (!o.changesFile.empty()) {
+        s.csv.open(o.changesFile);
+        if (!s.csv) {
+            error = "cannot write " + o.changesFile;
+            return false;
+        }
+        s.csv << "change,due_ms,sent_ms,done_ms,status,X,Y,W,H,latency_ms,states,error\n" << std::fixed << std::setprecision(3);
+    }
+    if (!s.acquire_session(error)) return false;
+
+    const auto period = std::chrono::duration<double>(1.0 / o.rate);
+    std::unique_lock<std::mutex> lk(s.mtx);
+    s.start = clock_type::now();
+    const auto end = o.durationS ? s.start + std::chrono::seconds(o.durationS) : clock_type::time_point::max();
+    s.running = true;
+    uint64_t next = 0;
+    while (!s.stopRequested && !s.sessionLost) {
+        auto now = clock_type::now();
+        auto due = s.start + std::chrono::duration_cast<clock_type::duration>(period * (double)next);
+        bool more = (o.changes == 0 || next < o.changes) && due < end;
+        if (more && due <= now) {
+            RectChange &c = s.live[next];
+            c.rect = s.rect_at(next);
+            c.due = due;
+            ++s.changes;
+            // only the newest geometry is worth sending
+            if (s.pending >= 0) {
+                s.live[s.pending].status = ChangeStatus::Coalesced;
+                ++s.coalesced;
+                s.finish(s.pending);
+            }
+            s.pending = (long)next++;
+            continue;
+        }
+        if (s.pending >= 0 && s.inFlight < o.maxInFlight) {
+            long idx = s.pending;
+            s.pending = -1;
+            s.send(idx, lk);
+            continue;
+        }
+        if (!more && s.pending < 0) break;
+        auto slice = now + std::chrono::milliseconds(100);
+        s.changed.wait_until(lk, more ? std::min(due, slice) : slice);
+    }
+    if (s.pending >= 0) {
+        ++s.unsent;
+        s.pending = -1;
+    }
+    // the transport's timeout bounds the wait for replies; trailing state events get settleMs
+    while (s.inFlight > 0) s.changed.wait_for(lk, std::chrono::milliseconds(100));
+    if (s.sent && !s.sessionLost && o.settleMs) {
+        auto settled = clock_type::now() + std::chrono::milliseconds(o.settleMs);
+        while (!s.sessionLost && s.changed.wait_until(lk, settled) != std::cv_status::timeout) {}
+    }
+    s.running = false;
+    s.elapsedS = std::chrono::duration<double>(clock_type::now() - s.start).count();
+    while (!s.live.empty()) s.finish((long)s.live.begin()->first);
+    s.lastSent = -1;
+    bool wrote = true;
+    if (s.csv.is_open()) {
+        s.csv.close();
+        if (!s.csv) {
+            error = "cannot write " + o.changesFile;
+            wrote = false;
+        }
+    }
+    bool lost = s.sessionLost;
+    std::string mac = s.mac;
+    lk.unlock();
+
+    // a session started here is stopped here
+    if (!o.client.empty() && !lost) player_stop_request(s.url, mac, "rectstress", 1);
+    if (lost) {
+        error = "session " + mac + " lost: " + s.lostReason;
+        return false;
+    }
+    return wrote;
+}
+
+void RectStress::requestStop() {
+    pimpl->stopRequested = true;
+}
+
+Json::Value RectStress::report() const {
+    const Impl &s = *pimpl;
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    Json::Value r;
+    r["pattern"] = pattern_name(s.opts.pattern);
+    r["mac"] = s.mac;
+    r["target_rate"] = s.opts.rate;
+    r["max_in_flight"] = s.opts.maxInFlight;
+    r["elapsed_s"] = s.elapsedS;
+    r["changes"] = (Json::UInt64)s.changes;
+    r["sent"] = (Json::UInt64)s.sent;
+    r["acked"] = (Json::UInt64)s.acked;
+    r["dropped"] = (Json::UInt64)s.dropped;
+    r["coalesced"] = (Json::UInt64)s.coalesced;
+    r["unsent"] = (Json::UInt64)s.unsent;
+    r["unattributed_events"] = (Json::UInt64)s.unattributed;
+    r["session_lost"] = s.sessionLost;
+    if (s.sessionLost) r["lost_reason"] = s.lostReason;
+    r["latency_us"] = s.latency.toJson();
+    r["service_us"] = s.service.toJson();
+    r["event_latency_us"] = s.eventLatency.toJson();
+    Json::Value st(Json::objectValue);
+    for (const auto &kv : s.states) st[kv.first] = (Json::UInt64)kv.second;
+    r["states"] = st;
+    return r;
+}
+
+void RectStress::printReport(std::ostream &out) const {
+    Json::Value r = report();
+    out << std::fixed << std::setprecision(1)
+        << "rect stress " << r["pattern"].asString() << " on " << (r["mac"].asString().empty() ? "?" : r["mac"].asString())
+        << ": " << r["changes"].asUInt64() << " changes at " << r["target_rate"].asDouble() << "/s over "
+        << r["elapsed_s"].asDouble() << "s, " << r["max_in_flight"].asUInt() << " in flight\n"
+        << "  sent=" << r["sent"].asUInt64() << " acked=" << r["acked"].asUInt64() << " dropped=" << r["dropped"].asUInt64()
+        << " coalesced=" << r["coalesced"].asUInt64() << " unsent=" << r["unsent"].asUInt64() << "\n"
+        << std::setprecision(2);
+    const char *labels[] = {"  latency (from due time)", "  ack (from send)        ", "  first state event      "};
+    const char *keys[] = {"latency_us", "service_us", "event_latency_us"};
+    for (int i = 0; i < 3; ++i) {
+        const Json::Value &h = r[keys[i]];
+        out << labels[i] << " n=" << h["count"].asUInt64() << " p50=" << h["p50"].asUInt64() / 1000.0
+            << " p90=" << h["p90"].asUInt64() / 1000.0 << " p99=" << h["p99"].asUInt64() / 1000.0
+            << " max=" << h["max"].asUInt64() / 1000.0 << " ms\n";
+    }
+    out << "  states:";
+    for (const auto &name : r["states"].getMemberNames()) out << " " << name << "=" << r["states"][name].asUInt64();
+    out << " unattributed=" << r["unattributed_events"].asUInt64() << "\n";
+    if (r["session_lost"].asBool()) out << "  SESSION LOST: " << r["lost_reason"].asString() << "\n";
+}
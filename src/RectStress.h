@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <json/json.h>
+#include "EventListener.h"
+#include "Miracast.h"
+
+enum class RectPattern {
+    Random,   // random 16:9 windows anywhere on screen
+    Sweep,    // bottom-right picture-in-picture growing to full screen and back
+    Corners,  // picture-in-picture window jumping TL -> TR -> BR -> BL
+    List      // the rectangles of RectStressOptions::sequence, cycled
+};
+
+struct RectStressOptions {
+    RectPattern pattern = RectPattern::Random;
+    std::vector<VideoRectangle> sequence;
+    double rate = 10;                 // changes per second, on a fixed schedule
+    unsigned changes = 200;           // 0 = until durationS / requestStop
+    unsigned durationS = 0;           // 0 = no time limit
+    unsigned maxInFlight = 1;         // setVideoRectangle calls outstanding; further changes coalesce
+    int screenW = 1920;
+    int screenH = 1080;
+    int minW = 320;                   // smallest window of random / sweep / corners
+    unsigned sweepSteps = 20;         // sweep: changes from smallest to full screen
+    uint32_t seed = 1;
+    long timeoutMs = 2000;            // per call; a failed or timed out change is dropped
+    unsigned settleMs = 500;          // state events this long after an ack still belong to the change
+    unsigned eventTimeoutMs = 10000;  // wait for a session to reach PLAYING
+    std::string client;               // start the session with playRequest for this MAC instead of waiting
+    std::string changesFile;          // CSV, one row per change, written once it is final (not in change order)
+};
+
+// "random" | "sweep" | "corners" | a file of "X Y W H" lines ('#' comments)
+bool parse_rect_pattern(const std::string &spec, RectStressOptions &opts, std::string &error);
+
+// Video rectangle stress for a live MiracastPlayer session, the way a UI moves the window around
+// (picture-in-picture, full screen). Change i is due at start + i / rate; at most maxInFlight
+// setVideoRectangle calls are outstanding. A change that comes due while the calls are busy waits,
+// and is superseded (coalesced, never sent) if a newer one comes due before it could go out, like
+// a UI that only ever sends the latest geometry. Latency runs from the due time to the reply, so
+// waiting behind a slow player counts. A change whose call fails or times out is dropped.
+//
+// onStateChange events of the session are attributed to the latest change sent before them (while
+// in flight or up to settleMs after its reply). A STOPPED session ends the run.
+class RectStress {
+public:
+    RectStress(const std::string &controllerUrl, const RectStressOptions &opts = RectStressOptions());
+    ~RectStress();
+
+    // register the player state handler; call before listener.start()
+    void attach(EventListener &listener);
+
+    // blocking; false if the run could not start (no live session, changes file) or the session was lost
+    bool run(std::string &error);
+
+    // stop after the changes in flight (async-signal-safe)
+    void requestStop();
+
+    // {"pattern","mac","target_rate","elapsed_s","changes","sent","acked","dropped","coalesced","unsent",
+    //  "unattributed_events","session_lost","latency_us":{..},"service_us":{..},"event_latency_us":{..},"states":{"<state>":n}}
+    Json::Value report() const;
+    void printReport(std::ostream &out) const;
+
+private:
+    RectStress(const RectStress&) = delete;
+    RectStress &operator=(const RectStress&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
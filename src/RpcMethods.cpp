@@ -0,0 +1,295 @@
+#include "RpcMethods.h"
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+static thread_local std::string requestBuffer;
+static thread_local std::string responseBuffer;
+
+std::string &rpc_request_buffer() { return requestBuffer; }
+std::string &rpc_response_buffer() { return responseBuffer; }
+const std::string &rpc_last_response() { return responseBuffer; }
+
+/* writer */
+
+void RpcWriter::beginRequest(int id, const char *method) {
+    buf.append("{\"jsonrpc\":\"2.0\",\"id\":");
+    needComma = false;
+    value(id);
+    buf.append(",\"method\":");
+    value(method);
+    buf.append(",\"params\":");
+    needComma = false;
+}
+
+void RpcWriter::endRequest() {
+    buf.push_back('}');
+}
+
+void RpcWriter::beginObject() {
+    buf.push_back('{');
+    needComma = false;
+}
+
+void RpcWriter::endObject() {
+    buf.push_back('}');
+    needComma = true;
+}
+
+void RpcWriter::key(const char *name) {
+    if (needComma) buf.push_back(',');
+    value(name);
+    buf.push_back(':');
+    needComma = false;
+}
+
+void RpcWriter::value(const std::string &v) {
+    buf.push_back('"');
+    size_t run = 0;  // length of the current stretch that needs no escaping
+    const char *s = v.data();
+    for (size_t i = 0; i < v.size(); ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') { ++run; continue; }
+        buf.append(s + i - run, run);
+        run = 0;
+        switch (c) {
+        case '"': buf.append("\\\""); break;
+        case '\\': buf.append("\\\\"); break;
+        case '\n': buf.append("\\n"); break;
+        case '\r': buf.append("\\r"); break;
+        case '\t': buf.append("\\t"); break;
+        default: {
+            static const char hex[] = "0123456789abcdef";
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+            buf.append(esc, sizeof(esc));
+        }
+        }
+    }
+    buf.append(s + v.size() - run, run);
+    buf.push_back('"');
+    needComma = true;
+}
+
+void RpcWriter::value(const char *v) {
+    // method names and keys: plain ASCII, no escaping needed
+    buf.push_back('"');
+    buf.append(v);
+    buf.push_back('"');
+    needComma = true;
+}
+
+void RpcWriter::value(int v) {
+    char tmp[16];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf.append(tmp, res.ptr - tmp);
+    needComma = true;
+}
+
+void RpcWriter::value(bool v) {
+    buf.append(v ? "true" : "false");
+    needComma = true;
+}
+
+void RpcWriter::null() {
+    buf.append("null");
+    needComma = true;
+}
+
+/* reader */
+
+char RpcReader::peek() {
+    while (p < e && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+    return p < e ? *p : '\0';
+}
+
+bool RpcReader::expect(char c) {
+    if (peek() != c) return fail();
+    ++p;
+    return true;
+}
+
+bool RpcReader::beginObject() {
+    if (!ok || peek() != '{') return false;
+    ++p;
+    return true;
+}
+
+bool RpcReader::beginArray() {
+    if (!ok || peek() != '[') return false;
+    ++p;
+    return true;
+}
+
+bool RpcReader::nextKey(std::string_view &key) {
+    if (!ok) return false;
+    char c = peek();
+    if (c == '}') { ++p; return false; }
+    if (c == ',') { ++p; c = peek(); }
+    if (c != '"') return fail();
+    const char *start = ++p;
+    while (p < e && *p != '"') p += (*p == '\\') ? 2 : 1;  // keys are compared raw, escapes are not decoded
+    if (p >= e) return fail();
+    key = std::string_view(start, p - start);
+    ++p;
+    return expect(':');
+}
+
+bool RpcReader::nextElement() {
+    if (!ok) return false;
+    char c = peek();
+    if (c == ']') { ++p; return false; }
+    if (c == ',') ++p;
+    return true;
+}
+
+static void append_utf8(std::string &out, unsigned cp) {
+    if (cp < 0x80) {
+        out.push_back((char)cp);
+    } else if (cp < 0x800) {
+        out.push_back((char)(0xc0 | (cp >> 6)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out.push_back((char)(0xe0 | (cp >> 12)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else {
+        out.push_back((char)(0xf0 | (cp >> 18)));
+        out.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    }
+}
+
+static bool hex4(const char *s, unsigned &out) {
+    out = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = s[i];
+        out <<= 4;
+        if (c >= '0' && c <= '9') out |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') out |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') out |= (unsigned)(c - 'A' + 10);
+        else return false;
+    }
+    return true;
+}
+
+// at the opening quote; decodes into out when given
+bool RpcReader::scanString(std::string *out) {
+    ++p;
+    if (out) out->clear();
+    while (p < e) {
+        const char *run = p;
+        while (p < e && *p != '"' && *p != '\\') ++p;
+        if (out) out->append(run, p - run);
+        if (p >= e) break;
+        if (*p == '"') { ++p; return true; }
+        if (++p >= e) break;
+        char c = *p++;
+        if (!out) {
+            if (c == 'u') p += 4;
+            continue;
+        }
+        switch (c) {
+        case 'n': out->push_back('\n'); break;
+        case 't': out->push_back('\t'); break;
+        case 'r': out->push_back('\r'); break;
+        case 'b': out->push_back('\b'); break;
+        case 'f': out->push_back('\f'); break;
+        case 'u': {
+            unsigned cp;
+            if (e - p < 4 || !hex4(p, cp)) return fail();
+            p += 4;
+            if (cp >= 0xd800 && cp < 0xdc00 && e - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                unsigned lo;
+                if (hex4(p + 2, lo) && lo >= 0xdc00 && lo < 0xe000) {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                    p += 6;
+                }
+            }
+            append_utf8(*out, cp);
+            break;
+        }
+        default: out->push_back(c); break;  // \" \\ \/
+        }
+    }
+    return fail();
+}
+
+bool RpcReader::read(std::string &v) {
+    if (!ok) return false;
+    if (peek() != '"') { skip(); return false; }
+    return scanString(&v);
+}
+
+bool RpcReader::read(int &v) {
+    if (!ok) return false;
+    char c = peek();
+    const char *start = p, *end = e;
+    if (c == '"') {
+        // numeric string: parse its contents
+        ++p;
+        start = p;
+        while (p < e && *p != '"' && *p != '\\') ++p;
+        end = p;
+        if (p < e && *p == '"') {
+            ++p;
+        } else {
+            p = start - 1;
+            skip();
+            return false;
+        }
+        int tmp;
+        auto res = std::from_chars(start, end, tmp);
+        if (res.ec != std::errc() || res.ptr != end) return false;
+        v = tmp;
+        return true;
+    }
+    if (c != '-' && (c < '0' || c > '9')) { skip(); return false; }
+    long long tmp;
+    auto res = std::from_chars(start, end, tmp);
+    if (res.ec != std::errc()) return fail();
+    p = res.ptr;
+    if (p < e && (*p == '.' || *p == 'e' || *p == 'E')) {
+        // fractional: not an int
+        skip();
+        return false;
+    }
+    // out of range: consumed, but not an int
+    if (tmp < std::numeric_limits<int>::min() || tmp > std::numeric_limits<int>::max()) return false;
+    v = (int)tmp;
+    return true;
+}
+
+bool RpcReader::read(bool &v) {
+    if (!ok) return false;
+    char c = peek();
+    if (c == 't' && e - p >= 4 && memcmp(p, "true", 4) == 0) { v = true; p += 4; return true; }
+    if (c == 'f' && e - p >= 5 && memcmp(p, "false", 5) == 0) { v = false; p += 5; return true; }
+    skip();
+    return false;
+}
+
+bool RpcReader::skip() {
+    if (!ok) return false;
+    char c = peek();
+    if (c == '"') return scanString(nullptr);
+    if (c == '{') {
+        ++p;
+        std::string_view key;
+        while (nextKey(key)) {
+            if (!skip()) return false;
+        }
+        return ok;
+    }
+    if (c == '[') {
+        ++p;
+        while (nextElement()) {
+            if (!skip()) return false;
+        }
+        return ok;
+    }
+    // number / true / false / null
+    const char *start = p;
+    while (p < e && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') ++p;
+    return p > start ? true : fail();
+}
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include "Log.h"
+#include "Miracast.h"
+
+// Typed JSON-RPC methods. Each method is declared once with its name, a params struct and a result
+// struct; RpcFields<T> lists a struct's JSON fields at compile time. Requests are written straight
+// into a reused per-thread buffer and the result fields are scanned straight into the result struct,
+// without building a Json::Value on either side.
+
+template <typename T, typename M>
+struct RpcField {
+    const char *name;
+    M T::*member;
+};
+
+template <typename T, typename M>
+constexpr RpcField<T, M> rpc_field(const char *name, M T::*member) {
+    return RpcField<T, M>{name, member};
+}
+
+// specialize for every params/result struct:
+//   template <> struct RpcFields<X> { static constexpr auto list = std::make_tuple(rpc_field("a", &X::a), ...); };
+template <typename T>
+struct RpcFields;
+
+// a result field that may be missing from the reply
+template <typename T>
+struct RpcOptional {
+    bool present = false;
+    T value{};
+};
+
+struct RpcNone {};
+
+struct RpcError {
+    bool present = false;
+    int code = 0;
+    std::string message;
+};
+
+template <typename P, typename R>
+struct RpcMethod {
+    typedef P Params;
+    typedef R Result;
+    const char *name;
+};
+
+/* writer */
+
+class RpcWriter {
+public:
+    explicit RpcWriter(std::string &out): buf(out), needComma(false) {}
+
+    // {"jsonrpc":"2.0","id":<id>,"method":"<method>","params": ... }
+    void beginRequest(int id, const char *method);
+    void endRequest();
+
+    void beginObject();
+    void endObject();
+    void key(const char *name);
+
+    void value(const std::string &v);
+    void value(const char *v);
+    void value(int v);
+    void value(bool v);
+    template <typename T>
+    void value(const RpcOptional<T> &v) {
+        if (v.present) value(v.value);
+        else null();
+    }
+    template <typename T>
+    void value(const T &obj) {
+        beginObject();
+        std::apply([&](const auto &... f) { (field(f.name, obj.*(f.member)), ...); }, RpcFields<T>::list);
+        endObject();
+    }
+
+private:
+    template <typename M>
+    void field(const char *name, const M &v) {
+        key(name);
+        value(v);
+    }
+    template <typename M>
+    void field(const char *name, const RpcOptional<M> &v) {
+        if (!v.present) return;  // absent optionals are left out
+        key(name);
+        value(v.value);
+    }
+    void null();
+
+    std::string &buf;
+    bool needComma;
+};
+
+/* reader: a forward-only scanner over one JSON text, no DOM */
+
+class RpcReader {
+public:
+    RpcReader(const char *begin, const char *end): p(begin), e(end), ok(true) {}
+
+    bool good() const { return ok; }
+
+    // true and consumes the opening bracket if the next value is an object / array
+    bool beginObject();
+    bool beginArray();
+    // next member key of the current object; false (bracket consumed) at its end
+    bool nextKey(std::string_view &key);
+    // true if the current array has another element; false (bracket consumed) at its end
+    bool nextElement();
+
+    // false if the value has another type: it is skipped and good() stays true
+    bool read(std::string &v);
+    bool read(int &v);   // numbers, and numeric strings ("200")
+    bool read(bool &v);
+    bool skip();         // any value
+
+    char peek();
+
+private:
+    bool expect(char c);
+    bool fail() { ok = false; return false; }
+    bool scanString(std::string *out);
+
+    const char *p, *e;
+    bool ok;
+};
+
+inline bool rpc_read(RpcReader &r, std::string &v) { return r.read(v); }
+inline bool rpc_read(RpcReader &r, int &v) { return r.read(v); }
+inline bool rpc_read(RpcReader &r, bool &v) { return r.read(v); }
+
+template <typename T>
+bool rpc_read(RpcReader &r, RpcOptional<T> &v) {
+    v.present = rpc_read(r, v.value);
+    return v.present;
+}
+
+// a value of the wrong type leaves the member untouched; only malformed JSON fails
+template <typename T>
+bool rpc_read_field(RpcReader &r, T &obj, std::string_view key) {
+    bool matched = false;
+    std::apply([&](const auto &... f) {
+        ((!matched && key == f.name ? (matched = true, rpc_read(r, obj.*(f.member))) : false), ...);
+    }, RpcFields<T>::list);
+    if (!matched) r.skip();
+    return r.good();
+}
+
+// objects are matched field by field; unknown fields are skipped
+template <typename T>
+bool rpc_read(RpcReader &r, T &obj) {
+    if (!r.beginObject()) {
+        r.skip();
+        return false;
+    }
+    std::string_view key;
+    while (r.nextKey(key)) {
+        if (!rpc_read_field(r, obj, key)) return false;
+    }
+    return r.good();
+}
+
+template <>
+struct RpcFields<RpcNone> {
+    static constexpr auto list = std::make_tuple();
+};
+
+template <>
+struct RpcFields<RpcError> {
+    static constexpr auto list = std::make_tuple(rpc_field("code", &RpcError::code), rpc_field("message", &RpcError::message));
+};
+
+// scan a response: "result" into result (an array result contributes its first element, as older
+// Thunder builds wrap it), "error" into error. False if body is not a well-formed JSON-RPC object.
+template <typename R>
+bool rpc_decode(const std::string &body, R &result, RpcError &error) {
+    RpcReader r(body.data(), body.data() + body.size());
+    if (!r.beginObject()) return false;
+    std::string_view key;
+    while (r.nextKey(key)) {
+        if (key == "result") {
+            if (r.peek() == '[') {
+                r.beginArray();
+                for (bool first = true; r.good() && r.nextElement(); first = false) {
+                    if (first) rpc_read(r, result);
+                    else r.skip();
+                }
+            } else {
+                rpc_read(r, result);
+            }
+        } else if (key == "error") {
+            error.present = true;
+            rpc_read(r, error);
+        } else {
+            r.skip();
+        }
+        if (!r.good()) return false;
+    }
+    return r.good();
+}
+
+/* transport */
+
+// buffers reused by rpc_call on this thread; the response stays valid until the next call
+std::string &rpc_request_buffer();
+const std::string &rpc_last_response();
+std::string &rpc_response_buffer();
+
+template <typename P, typename R>
+void rpc_encode(std::string &out, int id, const RpcMethod<P, R> &method, const P &params) {
+    out.clear();
+    RpcWriter w(out);
+    w.beginRequest(id, method.name);
+    w.value(params);
+    w.endRequest();
+}
+
+// true if a well-formed reply arrived (result filled in, error.present if it carried a JSON-RPC error)
+template <typename P, typename R>
+bool rpc_call(const std::string &controllerUrl, const RpcMethod<P, R> &method, const P &params, R &result, RpcError *error = nullptr) {
+    std::string &request = rpc_request_buffer();
+    std::string &response = rpc_response_buffer();
+    int id = next_rpc_id();
+    rpc_encode(request, id, method, params);
+    if (!json_rpc_post(controllerUrl, method.name, id, request, response, &method, &params)) return false;
+    RpcError err;
+    if (!rpc_decode(response, result, err)) {
+        LogLine(LogLevel::Warn, "json_rpc") << "parse error for response: " << response;
+        return false;
+    }
+    if (error) *error = err;
+    return true;
+}
+
+// in an RPC observer: the params of an rpc_call of method, nullptr for any other call
+template <typename P, typename R>
+const P *rpc_params(const RpcEvent &ev, const RpcMethod<P, R> &method) {
+    return ev.typedMethod == &method ? static_cast<const P *>(ev.typedParams) : nullptr;
+}
+
+/* Miracast methods */
+
+struct CallsignParams {
+    std::string callsign;
+};
+
+struct EnableParams {
+    bool enabled = false;
+};
+
+struct EnableResult {
+    RpcOptional<bool> enabled;
+    RpcOptional<bool> success;
+};
+
+struct AcceptParams {
+    std::string requestStatus;
+};
+
+struct ClientParams {
+    std::string mac;
+    std::string name;
+};
+
+struct PlayerStateParams {
+    std::string mac;
+    std::string state;
+    int reason_code = 0;
+    std::string reason;
+};
+
+struct PlayRequestParams {
+    DeviceParameters device_parameters;
+    VideoRectangle video_rectangle;
+};
+
+struct StopRequestParams {
+    std::string mac;
+    std::string name;
+    int reason_code = 0;
+};
+
+template <> struct RpcFields<CallsignParams> {
+    static constexpr auto list = std::make_tuple(rpc_field("callsign", &CallsignParams::callsign));
+};
+template <> struct RpcFields<EnableParams> {
+    static constexpr auto list = std::make_tuple(rpc_field("enabled", &EnableParams::enabled));
+};
+template <> struct RpcFields<EnableResult> {
+    static constexpr auto list = std::make_tuple(rpc_field("enabled", &EnableResult::enabled),
+                                                 rpc_field("success", &EnableResult::success));
+};
+template <> struct RpcFields<AcceptParams> {
+    static constexpr auto list = std::make_tuple(rpc_field("requestStatus", &AcceptParams::requestStatus));
+};
+template <> struct RpcFields<ClientParams> {
+    static constexpr auto list = std::make_tuple(rpc_field("mac", &ClientParams::mac), rpc_field("name", &ClientParams::name));
+};
+template <> struct RpcFields<PlayerStateParams> {
+    static constexpr auto list = std::make_tuple(rpc_field("mac", &PlayerStateParams::mac),
+                                                 rpc_field("state", &PlayerStateParams::state),
+                                                 rpc_field("reason_code", &PlayerStateParams::reason_code),
+                                                 rpc_field("reason", &PlayerStateParams::reason));
+};
+template <> struct RpcFields<DeviceParameters> {
+    static constexpr auto list = std::make_tuple(rpc_field("source_dev_ip", &DeviceParameters::source_dev_ip),
+                                                 rpc_field("source_dev_mac", &DeviceParameters::source_dev_mac),
+                                                 rpc_field("source_dev_name", &DeviceParameters::source_dev_name),
+                                                 rpc_field("sink_dev_ip", &DeviceParameters::sink_dev_ip));
+};
+template <> struct RpcFields<VideoRectangle> {
+    static constexpr auto list = std::make_tuple(rpc_field("X", &VideoRectangle::X), rpc_field("Y", &VideoRectangle::Y),
+                                                 rpc_field("W", &VideoRectangle::W), rpc_field("H", &VideoRectangle::H));
+};
+template <> struct RpcFields<PlayRequestParams> {
+    static constexpr auto list = std::make_tuple(rpc_field("device_parameters", &PlayRequestParams::device_parameters),
+                                                 rpc_field("video_rectangle", &PlayRequestParams::video_rectangle));
+};
+template <> struct RpcFields<StopRequestParams> {
+    static constexpr auto list = std::make_tuple(rpc_field("mac", &StopRequestParams::mac),
+                                                 rpc_field("name", &StopRequestParams::name),
+                                                 rpc_field("reason_code", &StopRequestParams::reason_code));
+};
+
+// inline: one descriptor per program, so rpc_params can match by address
+inline constexpr RpcMethod<CallsignParams, RpcNone> kControllerActivate{"Controller.activate"};
+inline constexpr RpcMethod<CallsignParams, RpcNone> kControllerDeactivate{"Controller.deactivate"};
+inline constexpr RpcMethod<EnableParams, RpcNone> kSetEnable{"org.rdk.MiracastService.setEnable"};
+inline constexpr RpcMethod<RpcNone, EnableResult> kGetEnable{"org.rdk.MiracastService.getEnable"};
+inline constexpr RpcMethod<AcceptParams, RpcNone> kAcceptClientConnection{"org.rdk.MiracastService.acceptClientConnection"};
+inline constexpr RpcMethod<ClientParams, RpcNone> kStopClientConnection{"org.rdk.MiracastService.stopClientConnection"};
+inline constexpr RpcMethod<PlayerStateParams, RpcNone> kUpdatePlayerState{"org.rdk.MiracastService.updatePlayerState"};
+inline constexpr RpcMethod<PlayRequestParams, RpcNone> kPlayRequest{"org.rdk.MiracastPlayer.playRequest"};
+inline constexpr RpcMethod<StopRequestParams, RpcNone> kStopRequest{"org.rdk.MiracastPlayer.stopRequest"};
+inline constexpr RpcMethod<VideoRectangle, RpcNone> kSetVideoRectangle{"org.rdk.MiracastPlayer.setVideoRectangle"};
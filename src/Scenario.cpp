@@ -0,0 +1,450 @@
+#include "Scenario.h"
+#include "Log.h"
+#include "LatencyHistogram.h"
+#include "Miracast.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+static const size_t kMaxQueuedEvents = 1000;
+static const long kStopPollMs = 100;
+
+struct Step {
+    enum Kind { Call, Wait, Delay, Loop, End, Save, Assert, Print } kind;
+    int line = 0;
+    std::string text;
+    std::string method;     // Call / Wait
+    std::string arg;        // Call params template, Print text, Assert value, Save expression
+    long ms = 0;            // Wait timeout / Delay
+    long count = 0;         // Loop
+    size_t match = 0;       // Loop -> index of its End
+    std::vector<std::pair<std::string, std::string>> filters;  // Wait
+    std::string lhs, op;    // Assert; Save uses lhs as the variable name
+};
+
+struct StepStats {
+    uint64_t runs = 0;
+    uint64_t failures = 0;
+    LatencyHistogram latency;
+};
+
+static std::string trim(const std::string &s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+static std::string compact(const Json::Value &v) {
+    Json::StreamWriterBuilder w;
+    w["indentation"] = "";
+    return Json::writeString(w, v);
+}
+
+static bool parse_json(const std::string &s, Json::Value &out, std::string &errs) {
+    Json::CharReaderBuilder b;
+    std::unique_ptr<Json::CharReader> reader(b.newCharReader());
+    return reader->parse(s.c_str(), s.c_str() + s.size(), &out, &errs);
+}
+
+// walk "a.b.0.c" into v; false if a component is missing
+static bool walk(const Json::Value &v, const std::string &path, Json::Value &out) {
+    const Json::Value *cur = &v;
+    std::istringstream iss(path);
+    std::string part;
+    while (std::getline(iss, part, '.')) {
+        if (part.empty()) continue;
+        if (cur->isArray() && part.find_first_not_of("0123456789") == std::string::npos) {
+            Json::ArrayIndex idx = (Json::ArrayIndex)std::stoul(part);
+            if (idx >= cur->size()) return false;
+            cur = &(*cur)[idx];
+        } else if (cur->isObject() && cur->isMember(part)) {
+            cur = &(*cur)[part];
+        } else {
+            return false;
+        }
+    }
+    out = *cur;
+    return true;
+}
+
+static std::string as_text(const Json::Value &v) {
+    return v.isString() ? v.asString() : compact(v);
+}
+
+static bool as_number(const std::string &s, double &out) {
+    if (s.empty()) return false;
+    char *end = nullptr;
+    out = strtod(s.c_str(), &end);
+    return end && *end == '\0';
+}
+
+struct Scenario::Impl {
+    std::vector<Step> steps;
+    std::vector<std::unique_ptr<StepStats>> stats;
+    std::string controllerUrl;
+    std::atomic<bool> stopRequested;
+
+    // notifications for awaited events, oldest first
+    struct QueuedEvent {
+        std::string method;
+        Json::Value params;
+    };
+    std::mutex evMutex;
+    std::condition_variable evCv;
+    std::deque<QueuedEvent> events;
+
+    Json::Value lastEvent;
+    Json::Value lastResult;
+    std::map<std::string, Json::Value> vars;
+
+    // report
+    clock_type::time_point started, finished;
+    uint64_t iterations = 0, iterationsFailed = 0;
+    bool passed = false;
+
+    Impl(): stopRequested(false) {}
+
+    bool parse_line(const std::string &raw, int line, Step &st, std::string &error) {
+        std::string text = trim(raw);
+        std::istringstream iss(text);
+        std::string kw;
+        iss >> kw;
+        st.line = line;
+        st.text = text;
+        std::string rest;
+        std::getline(iss, rest);
+        rest = trim(rest);
+        std::istringstream args(rest);
+        try {
+            if (kw == "call") {
+                st.kind = Step::Call;
+                args >> st.method;
+                std::getline(args, st.arg);
+                st.arg = trim(st.arg);
+                if (st.method.empty()) { error = "call needs a method"; return false; }
+            } else if (kw == "wait") {
+                st.kind = Step::Wait;
+                std::string timeout, f;
+                args >> st.method >> timeout;
+                if (st.method.empty() || timeout.empty()) { error = "usage: wait <callsign.event> <timeout_ms> [path=value ...]"; return false; }
+                st.ms = std::stol(timeout);
+                while (args >> f) {
+                    auto eq = f.find('=');
+                    if (eq == std::string::npos) { error = "filter must be path=value: " + f; return false; }
+                    st.filters.emplace_back(f.substr(0, eq), f.substr(eq + 1));
+                }
+            } else if (kw == "delay") {
+                st.kind = Step::Delay;
+                st.ms = std::stol(rest);
+            } else if (kw == "loop") {
+                st.kind = Step::Loop;
+                st.count = std::stol(rest);
+            } else if (kw == "end") {
+                st.kind = Step::End;
+            } else if (kw == "save") {
+                st.kind = Step::Save;
+                args >> st.lhs >> st.arg;
+                if (st.arg.empty()) { error = "usage: save <var> <expr>"; return false; }
+            } else if (kw == "assert") {
+                st.kind = Step::Assert;
+                args >> st.lhs >> st.op;
+                std::getline(args, st.arg);
+                st.arg = trim(st.arg);
+                static const std::set<std::string> ops = {"==", "!=", "<", "<=", ">", ">="};
+                if (!ops.count(st.op)) { error = "usage: assert <expr> ==|!=|<|<=|>|>= <value>"; return false; }
+            } else if (kw == "print") {
+                st.kind = Step::Print;
+                st.arg = rest;
+            } else {
+                error = "unknown step '" + kw + "'";
+                return false;
+            }
+        } catch (...) {
+            error = "invalid number";
+            return false;
+        }
+        return true;
+    }
+
+    /* expressions */
+
+    bool resolve(const std::string &expr, Json::Value &out) const {
+        auto dot = expr.find('.');
+        std::string head = expr.substr(0, dot);
+        std::string path = dot == std::string::npos ? "" : expr.substr(dot + 1);
+        if (head == "ev") return walk(lastEvent, path, out);
+        if (head == "result") return walk(lastResult, path, out);
+        auto it = vars.find(head);
+        return it != vars.end() && walk(it->second, path, out);
+    }
+
+    // replace ${expr}; false (with error) if an expression does not resolve
+    bool substitute(const std::string &in, std::string &out, std::string &error) const {
+        out.clear();
+        size_t pos = 0;
+        while (true) {
+            size_t b = in.find("${", pos);
+            if (b == std::string::npos) { out.append(in, pos, std::string::npos); return true; }
+            size_t e = in.find('}', b);
+            if (e == std::string::npos) { error = "unterminated ${"; return false; }
+            out.append(in, pos, b - pos);
+            std::string expr = in.substr(b + 2, e - b - 2);
+            Json::Value v;
+            if (!resolve(expr, v)) { error = "cannot resolve ${" + expr + "}"; return false; }
+            out += as_text(v);
+            pos = e + 1;
+        }
+    }
+
+    /* steps */
+
+    bool do_call(const Step &st, std::string &error) {
+        std::string text;
+        Json::Value params(Json::objectValue);
+        if (!substitute(st.arg, text, error)) return false;
+        std::string errs;
+        if (!text.empty() && !parse_json(text, params, errs)) { error = "bad params JSON: " + errs; return false; }
+        Json::Value resp;
+        bool ok = json_rpc_call(controllerUrl, st.method, params, resp);
+        lastResult = resp.isMember("result") ? resp["result"] : Json::Value();
+        if (!ok) {
+            error = resp.isMember("error") ? "error " + compact(resp["error"]) : "no response";
+            return false;
+        }
+        return true;
+    }
+
+    bool event_matches(const Step &st, const QueuedEvent &ev, std::string &error) const {
+        if (ev.method != st.method) return false;
+        for (const auto &f : st.filters) {
+            std::string want;
+            Json::Value got;
+            if (!substitute(f.second, want, error)) return false;
+            if (!walk(ev.params, f.first, got) || as_text(got) != want) return false;
+        }
+        return true;
+    }
+
+    bool do_wait(const Step &st, std::string &error) {
+        auto deadline = clock_type::now() + std::chrono::milliseconds(st.ms);
+        std::unique_lock<std::mutex> lk(evMutex);
+        while (true) {
+            for (auto it = events.begin(); it != events.end(); ++it) {
+                if (event_matches(st, *it, error)) {
+                    lastEvent = it->params;
+                    // older events of this method are stale now; other methods' stay for later waits
+                    std::string method = it->method;
+                    auto end = events.erase(it);
+                    events.erase(std::remove_if(events.begin(), end, [&](const QueuedEvent &e){ return e.method == method; }), end);
+                    return true;
+                }
+                if (!error.empty()) return false;
+            }
+            auto now = clock_type::now();
+            if (now >= deadline) { error = "timeout waiting for " + st.method; return false; }
+            if (stopRequested) { error = "stopped"; return false; }
+            evCv.wait_until(lk, std::min(deadline, now + std::chrono::milliseconds(kStopPollMs)));
+        }
+    }
+
+    bool do_delay(long ms) {
+        auto deadline = clock_type::now() + std::chrono::milliseconds(ms);
+        while (!stopRequested) {
+            auto now = clock_type::now();
+            if (now >= deadline) return true;
+            std::this_thread::sleep_for(std::min(deadline - now, clock_type::duration(std::chrono::milliseconds(kStopPollMs))));
+        }
+        return false;
+    }
+
+    bool do_assert(const Step &st, std::string &error) {
+        Json::Value lv;
+        std::string rhs;
+        if (!resolve(st.lhs, lv)) { error = "cannot resolve " + st.lhs; return false; }
+        if (!substitute(st.arg, rhs, error)) return false;
+        std::string lhs = as_text(lv);
+        double a, b;
+        int cmp;
+        if (as_number(lhs, a) && as_number(rhs, b)) cmp = a < b ? -1 : (a > b ? 1 : 0);
+        else cmp = lhs.compare(rhs) < 0 ? -1 : (lhs == rhs ? 0 : 1);
+        bool ok = (st.op == "==" && cmp == 0) || (st.op == "!=" && cmp != 0) || (st.op == "<" && cmp < 0) ||
+                  (st.op == "<=" && cmp <= 0) || (st.op == ">" && cmp > 0) || (st.op == ">=" && cmp >= 0);
+        if (!ok) error = st.lhs + " is " + lhs + ", expected " + st.op + " " + rhs;
+        return ok;
+    }
+
+    bool run_step(size_t i, std::string &error) {
+        const Step &st = steps[i];
+        switch (st.kind) {
+        case Step::Call: return do_call(st, error);
+        case Step::Wait: return do_wait(st, error);
+        case Step::Delay: if (!do_delay(st.ms)) { error = "stopped"; return false; } return true;
+        case Step::Save: {
+            Json::Value v;
+            if (!resolve(st.arg, v)) { error = "cannot resolve " + st.arg; return false; }
+            vars[st.lhs] = v;
+            return true;
+        }
+        case Step::Assert: return do_assert(st, error);
+        case Step::Print: {
+            std::string text;
+            if (!substitute(st.arg, text, error)) return false;
+            log_write(LogLevel::Info, "scenario", text);
+            return true;
+        }
+        default: return true;
+        }
+    }
+
+    // run steps [begin, end); a failure ends the block. depth 0 = top level
+    bool run_block(size_t begin, size_t end, int depth) {
+        bool ok = true;
+        for (size_t i = begin; i < end && !stopRequested; ++i) {
+            const Step &st = steps[i];
+            if (st.kind == Step::Loop) {
+                // a failed iteration fails the loop but the block goes on after it
+                for (long n = 0; n < st.count && !stopRequested; ++n) {
+                    bool iterOk = run_block(i + 1, st.match, depth + 1);
+                    if (depth == 0) {
+                        ++iterations;
+                        if (!iterOk) ++iterationsFailed;
+                    }
+                    ok = ok && iterOk;
+                }
+                i = st.match;
+                continue;
+            }
+            std::string error;
+            auto t0 = clock_type::now();
+            bool stepOk = run_step(i, error);
+            StepStats &s = *stats[i];
+            ++s.runs;
+            s.latency.record((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - t0).count());
+            if (!stepOk) {
+                ++s.failures;
+                LogLine(LogLevel::Warn, "scenario") << "line " << st.line << " failed: " << error;
+                return false;
+            }
+        }
+        return ok && !stopRequested;
+    }
+};
+
+Scenario::Scenario() : pimpl(new Impl()) {}
+Scenario::~Scenario() { delete pimpl; }
+
+bool Scenario::load(const std::string &path, std::string &error) {
+    std::ifstream in(path);
+    if (!in) { error = "cannot open " + path; return false; }
+    std::string raw;
+    int line = 0;
+    std::vector<size_t> open;
+    while (std::getline(in, raw)) {
+        ++line;
+        std::string text = trim(raw);
+        if (text.empty() || text[0] == '#') continue;
+        Step st;
+        std::string err;
+        if (!pimpl->parse_line(text, line, st, err)) {
+            error = path + ":" + std::to_string(line) + ": " + err;
+            return false;
+        }
+        if (st.kind == Step::Loop) open.push_back(pimpl->steps.size());
+        if (st.kind == Step::End) {
+            if (open.empty()) { error = path + ":" + std::to_string(line) + ": 'end' without 'loop'"; return false; }
+            pimpl->steps[open.back()].match = pimpl->steps.size();
+            open.pop_back();
+        }
+        pimpl->steps.push_back(st);
+        pimpl->stats.emplace_back(new StepStats());
+    }
+    if (!open.empty()) {
+        error = path + ":" + std::to_string(pimpl->steps[open.back()].line) + ": 'loop' without 'end'";
+        return false;
+    }
+    return true;
+}
+
+void Scenario::attach(EventListener &listener) {
+    std::set<std::string> methods;
+    for (const auto &st : pimpl->steps) if (st.kind == Step::Wait) methods.insert(st.method);
+    Impl *p = pimpl;
+    for (const auto &m : methods) {
+        auto dot = m.rfind('.');
+        std::string callsign = dot == std::string::npos ? "" : m.substr(0, dot);
+        std::string event = dot == std::string::npos ? m : m.substr(dot + 1);
+        listener.addEventHandler(callsign, event, [p, m](const Json::Value &params, EventTime){
+            {
+                std::lock_guard<std::mutex> g(p->evMutex);
+                p->events.push_back(Impl::QueuedEvent{m, params});
+                if (p->events.size() > kMaxQueuedEvents) p->events.pop_front();
+            }
+            p->evCv.notify_all();
+        });
+    }
+}
+
+bool Scenario::run(const std::string &controllerUrl) {
+    pimpl->controllerUrl = controllerUrl;
+    pimpl->started = clock_type::now();
+    pimpl->passed = pimpl->run_block(0, pimpl->steps.size(), 0);
+    pimpl->finished = clock_type::now();
+    return pimpl->passed;
+}
+
+void Scenario::requestStop() {
+    pimpl->stopRequested = true;
+}
+
+Json::Value Scenario::report() const {
+    Json::Value j;
+    double elapsed = std::chrono::duration<double>(pimpl->finished - pimpl->started).count();
+    j["passed"] = pimpl->passed;
+    j["stopped"] = pimpl->stopRequested.load();
+    j["elapsed_s"] = elapsed;
+    j["iterations"] = (Json::UInt64)pimpl->iterations;
+    j["iterations_failed"] = (Json::UInt64)pimpl->iterationsFailed;
+    j["sessions_per_hour"] = elapsed > 0 ? (pimpl->iterations - pimpl->iterationsFailed) * 3600.0 / elapsed : 0.0;
+    j["steps"] = Json::Value(Json::arrayValue);
+    for (size_t i = 0; i < pimpl->steps.size(); ++i) {
+        const Step &st = pimpl->steps[i];
+        if (st.kind == Step::Loop || st.kind == Step::End) continue;
+        const StepStats &s = *pimpl->stats[i];
+        Json::Value e;
+        e["line"] = st.line;
+        e["step"] = st.text;
+        e["runs"] = (Json::UInt64)s.runs;
+        e["failures"] = (Json::UInt64)s.failures;
+        e["latency_us"] = s.latency.toJson();
+        j["steps"].append(e);
+    }
+    return j;
+}
+
+void Scenario::printReport(std::ostream &out) const {
+    Json::Value r = report();
+    out << "Scenario " << (r["passed"].asBool() ? "PASSED" : "FAILED") << (r["stopped"].asBool() ? " (stopped)" : "")
+        << " in " << r["elapsed_s"].asDouble() << "s: iterations=" << r["iterations"].asUInt64()
+        << " failed=" << r["iterations_failed"].asUInt64()
+        << " sessions/hour=" << (long)r["sessions_per_hour"].asDouble() << "\n";
+    for (const auto &e : r["steps"]) {
+        const Json::Value &l = e["latency_us"];
+        out << "  line " << e["line"].asInt() << " runs=" << e["runs"].asUInt64() << " fail=" << e["failures"].asUInt64()
+            << " p50=" << l["p50"].asUInt64() / 1000.0 << "ms p99=" << l["p99"].asUInt64() / 1000.0
+            << "ms max=" << l["max"].asUInt64() / 1000.0 << "ms  " << e["step"].asString() << "\n";
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <json/json.h>
+#include "EventListener.h"
+
+// Non-interactive scenario runner. A scenario is a text file with one step per line ('#' comments):
+//
+//   call <method> [json params]            RPC; fails on transport error or JSON-RPC "error"
+//   wait <callsign.event> <timeout_ms> [path=value ...]
+//                                          wait for a notification whose params match every filter
+//   delay <ms>
+//   loop <n> ... end                       repeat the enclosed steps n times
+//   save <var> <expr>                      copy a value into ${var}
+//   assert <expr> <op> <value>             op: == != < <= > >= (numeric when both sides are numbers)
+//   print <text>
+//
+// <expr> is "ev.<path>" (params of the last matched event), "result.<path>" (result of the last call)
+// or a saved variable, optionally followed by ".<path>". ${expr} is substituted in call params,
+// filter values, assert values and print text (strings raw, other values as JSON).
+// A failing step ends the current iteration of the innermost loop (or the run, outside any loop).
+class Scenario {
+public:
+    Scenario();
+    ~Scenario();
+
+    bool load(const std::string &path, std::string &error);
+
+    // register handlers for every awaited event; call before listener.start()
+    void attach(EventListener &listener);
+
+    // execute against controllerUrl; true if every step passed
+    bool run(const std::string &controllerUrl);
+
+    // ask a running scenario to stop after the current step (async-signal-safe)
+    void requestStop();
+
+    // {"passed","elapsed_s","iterations","iterations_failed","sessions_per_hour","steps":[...]}
+    Json::Value report() const;
+    void printReport(std::ostream &out) const;
+
+private:
+    Scenario(const Scenario&) = delete;
+    Scenario &operator=(const Scenario&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
@@ -0,0 +1,210 @@
+#include "SessionTracker.h"
+#include "Miracast.h"
+#include "MiracastEvents.h"
+#include "RpcMethods.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+typedef std::chrono::steady_clock clock_type;
+
+// phase histograms, in pipeline order
+static const char *const kPhases[] = {
+    "request_to_accept",        // onClientConnectionRequest -> acceptClientConnection sent
+    "accept_to_launch",         // accept sent -> onLaunchRequest
+    "launch_to_play_request",   // onLaunchRequest -> playRequest sent
+    "play_request_to_playing",  // playRequest sent -> onStateChange PLAYING
+    "playing_to_stop",          // PLAYING -> stopRequest / stopClientConnection / STOPPED
+    "request_to_playing",       // end to end connect time
+    "session_total",            // request -> stop
+};
+
+static std::string lower(const std::string &s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c){ return (char)std::tolower(c); });
+    return out;
+}
+
+static bool ends_with(const std::string &s, const char *suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+struct SessionTracker::Impl {
+    struct Session {
+        clock_type::time_point requested, accepted, launched, playRequested, playing;
+    };
+
+    std::string controllerUrl;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> phases;
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, Session> sessions;  // by lower-case MAC
+    std::string pending;  // MAC of the unanswered request; acceptClientConnection carries none
+    uint64_t started, completed;
+    int observerId;
+
+    explicit Impl(const std::string &url): controllerUrl(url), started(0), completed(0), observerId(0) {
+        for (const char *p : kPhases) phases[p].reset(new LatencyHistogram());
+    }
+
+    ~Impl() {
+        if (observerId) remove_rpc_observer(observerId);
+    }
+
+    void record(const char *phase, clock_type::time_point from, clock_type::time_point to) {
+        if (from == clock_type::time_point() || to == clock_type::time_point()) return;
+        phases[phase]->record(us_between(from, to));
+    }
+
+    void on_request(const std::string &mac, clock_type::time_point t) {
+        std::lock_guard<std::mutex> g(mtx);
+        Session s;
+        s.requested = t;
+        sessions[lower(mac)] = s;
+        pending = lower(mac);
+        ++started;
+    }
+
+    // an answer without a pending request (duplicate, or sent before the request was seen) is ignored
+    void on_answer(bool accepted, clock_type::time_point t) {
+        std::lock_guard<std::mutex> g(mtx);
+        if (pending.empty()) return;
+        auto it = sessions.find(pending);
+        pending.clear();
+        if (!accepted || it == sessions.end() || it->second.accepted != clock_type::time_point()) return;
+        it->second.accepted = t;
+        record("request_to_accept", it->second.requested, t);
+    }
+
+    void on_launch(const std::string &mac, clock_type::time_point t) {
+        std::lock_guard<std::mutex> g(mtx);
+        auto it = sessions.find(lower(mac));
+        if (it == sessions.end()) return;
+        it->second.launched = t;
+        record("accept_to_launch", it->second.accepted, t);
+    }
+
+    void on_play_request(const std::string &mac, clock_type::time_point t) {
+        std::lock_guard<std::mutex> g(mtx);
+        auto it = sessions.find(lower(mac));
+        if (it == sessions.end()) return;
+        it->second.playRequested = t;
+        record("launch_to_play_request", it->second.launched, t);
+    }
+
+    void on_playing(const std::string &mac, clock_type::time_point t) {
+        std::lock_guard<std::mutex> g(mtx);
+        auto it = sessions.find(lower(mac));
+        if (it == sessions.end() || it->second.playing != clock_type::time_point()) return;
+        it->second.playing = t;
+        record("play_request_to_playing", it->second.playRequested, t);
+        record("request_to_playing", it->second.requested, t);
+    }
+
+    void on_stop(const std::string &mac, clock_type::time_point t) {
+        std::lock_guard<std::mutex> g(mtx);
+        auto it = sessions.find(lower(mac));
+        if (it == sessions.end()) return;
+        record("playing_to_stop", it->second.playing, t);
+        record("session_total", it->second.requested, t);
+        sessions.erase(it);
+        ++completed;
+    }
+
+    // method first: the response is only parsed for the calls that are tracked
+    void on_rpc(const RpcEvent &ev) {
+        if (!ev.ok) return;
+        if (!controllerUrl.empty() && ev.controllerUrl != controllerUrl) return;
+        bool accept = ends_with(ev.method, ".acceptClientConnection");
+        bool play = !accept && ends_with(ev.method, ".playRequest");
+        bool stop = !accept && !play && (ends_with(ev.method, ".stopRequest") || ends_with(ev.method, ".stopClientConnection"));
+        if (!accept && !play && !stop) return;
+        const Json::Value &resp = ev.response();
+        if (!resp.isObject() || resp.isMember("error")) return;
+        if (accept) {
+            const AcceptParams *typed = rpc_params(ev, kAcceptClientConnection);
+            on_answer((typed ? typed->requestStatus : ev.params()["requestStatus"].asString()) == "Accept", ev.start);
+        } else if (play) {
+            on_play_request(ev.params()["device_parameters"]["source_dev_mac"].asString(), ev.start);
+        } else {
+            on_stop(ev.params()["mac"].asString(), ev.start);
+        }
+    }
+};
+
+SessionTracker::SessionTracker(const std::string &controllerUrl) : pimpl(new Impl(controllerUrl)) {}
+SessionTracker::~SessionTracker() { delete pimpl; }
+
+void SessionTracker::attach(EventListener &listener) {
+    Impl *p = pimpl;
+    on_client_connection_request(listener, [p](const ClientConnectionRequest &ev){ p->on_request(ev.mac, ev.received); });
+    on_launch_request(listener, [p](const LaunchRequest &ev){ p->on_launch(ev.device.source_dev_mac, ev.received); });
+    on_player_state_change(listener, [p](const PlayerStateChange &ev){
+        if (ev.state == "PLAYING") p->on_playing(ev.mac, ev.received);
+        else if (ev.state == "STOPPED") p->on_stop(ev.mac, ev.received);
+    });
+    on_client_connection_error(listener, [p](const ClientConnectionError &ev){
+        std::lock_guard<std::mutex> g(p->mtx);
+        p->sessions.erase(lower(ev.mac));
+        if (p->pending == lower(ev.mac)) p->pending.clear();
+    });
+    if (!p->observerId) p->observerId = add_rpc_observer([p](const RpcEvent &ev){ p->on_rpc(ev); });
+}
+
+void SessionTracker::reset() {
+    std::lock_guard<std::mutex> g(pimpl->mtx);
+    for (auto &ph : pimpl->phases) ph.second->reset();
+    pimpl->started = pimpl->completed = 0;
+}
+
+const LatencyHistogram *SessionTracker::phase(const std::string &name) const {
+    auto it = pimpl->phases.find(name);
+    return it == pimpl->phases.end() ? nullptr : it->second.get();
+}
+
+Json::Value SessionTracker::toJson() const {
+    Json::Value j;
+    {
+        std::lock_guard<std::mutex> g(pimpl->mtx);
+        j["sessions"]["started"] = (Json::UInt64)pimpl->started;
+        j["sessions"]["completed"] = (Json::UInt64)pimpl->completed;
+        j["sessions"]["active"] = (Json::UInt64)pimpl->sessions.size();
+    }
+    for (const char *p : kPhases) j["phases"][p] = pimpl->phases.at(p)->toJson();
+    return j;
+}
+
+std::string SessionTracker::toPrometheus() const {
+    std::ostringstream out;
+    {
+        std::lock_guard<std::mutex> g(pimpl->mtx);
+        out << "# TYPE mcast_sessions_started_total counter\nmcast_sessions_started_total " << pimpl->started << "\n";
+        out << "# TYPE mcast_sessions_completed_total counter\nmcast_sessions_completed_total " << pimpl->completed << "\n";
+        out << "# TYPE mcast_sessions_active gauge\nmcast_sessions_active " << pimpl->sessions.size() << "\n";
+    }
+    out << "# TYPE mcast_session_phase_latency_us summary\n";
+    for (const char *p : kPhases) {
+        out << pimpl->phases.at(p)->toPrometheus("mcast_session_phase_latency_us", std::string("phase=\"") + p + "\"");
+    }
+    return out.str();
+}
+
+bool SessionTracker::writeFile(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out) return false;
+    if (ends_with(path, ".prom")) {
+        out << toPrometheus();
+    } else {
+        Json::StreamWriterBuilder w;
+        w["indentation"] = "  ";
+        out << Json::writeString(w, toJson()) << "\n";
+    }
+    return (bool)out;
+}
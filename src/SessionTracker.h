@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <json/json.h>
+#include "EventListener.h"
+#include "LatencyHistogram.h"
+
+// Per-phase latency of Miracast sessions, keyed by source MAC:
+//   connection request -> accept sent -> launch request -> playRequest -> PLAYING -> stop
+// Phase timestamps come from the typed events and from the RPC observer in Miracast.h.
+class SessionTracker {
+public:
+    // controllerUrl filters RPCs to this controller ("" = all)
+    explicit SessionTracker(const std::string &controllerUrl = "");
+    ~SessionTracker();
+
+    // register event handlers on listener (before start()) and the RPC observer
+    void attach(EventListener &listener);
+
+    void reset();
+
+    // {"sessions":{"started","completed","active"},"phases":{"<phase>":{count,min,mean,p50,...}}}
+    Json::Value toJson() const;
+    // Prometheus text exposition (summaries in microseconds + session counters)
+    std::string toPrometheus() const;
+    // write toJson() or, for a .prom path, toPrometheus()
+    bool writeFile(const std::string &path) const;
+
+    // histogram of one phase ("request_to_accept", ...), nullptr if unknown
+    const LatencyHistogram *phase(const std::string &name) const;
+
+private:
+    SessionTracker(const SessionTracker&) = delete;
+    SessionTracker &operator=(const SessionTracker&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
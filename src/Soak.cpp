@@ -0,0 +1,391 @@
+#include "Soak.h"
+#include "LatencyHistogram.h"
+#include "Log.h"
+#include "Miracast.h"
+#include "MiracastEvents.h"
+#include "RpcMethods.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock clock_type;
+
+static const size_t kMaxQueuedRequests = 16;
+static const unsigned kStatusEveryS = 10;
+
+// one cycle step: only a reply without a JSON-RPC error counts as done
+template <typename P>
+static bool step(const std::string &url, const RpcMethod<P, RpcNone> &method, const P &params) {
+    RpcNone none;
+    RpcError err;
+    if (!rpc_call(url, method, params, none, &err)) return false;
+    if (err.present) {
+        LogLine(LogLevel::Warn, "soak") << method.name << " error " << err.code << ": " << err.message;
+        return false;
+    }
+    return true;
+}
+
+struct ResourceSample {
+    uint64_t rssKb = 0;
+    uint64_t fds = 0;
+    uint64_t threads = 0;
+};
+
+// the tester's own footprint, from /proc/self
+static ResourceSample sample_resources() {
+    ResourceSample s;
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    if (statm >> size >> resident) s.rssKb = resident * (uint64_t)sysconf(_SC_PAGESIZE) / 1024;
+    if (DIR *d = opendir("/proc/self/fd")) {
+        while (dirent *e = readdir(d)) {
+            if (e->d_name[0] != '.') ++s.fds;
+        }
+        closedir(d);
+        if (s.fds) --s.fds;  // the directory stream itself
+    }
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0) {
+            s.threads = std::strtoull(line.c_str() + 8, nullptr, 10);
+            break;
+        }
+    }
+    return s;
+}
+
+struct SoakRow {
+    uint64_t cycle;
+    double elapsedS;
+    ResourceSample res;
+    uint64_t latCount, latMeanUs, latMaxUs;   // successful cycles of the window
+    uint64_t failed;                          // cumulative
+};
+
+struct Trend {
+    bool valid = false;
+    double first = 0, last = 0;   // medians of the first / last quarter after warm-up
+    double slopePer1k = 0;        // least squares, per 1000 cycles
+    double growthPct = 0;
+    bool flagged = false;
+};
+
+static double median(std::vector<double> v) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// minAbs: growth needed regardless of pct; minPct < 0 = absolute growth alone decides
+static Trend trend(const std::vector<double> &x, const std::vector<double> &y, double minAbs, double minPct) {
+    Trend t;
+    size_t skip = x.size() / 10;   // warm-up: allocator pools, connection setup, caches
+    size_t n = x.size() - skip;
+    if (n < 8) return t;
+    t.valid = true;
+    size_t q = n / 4;
+    t.first = median(std::vector<double>(y.begin() + skip, y.begin() + skip + q));
+    t.last = median(std::vector<double>(y.end() - q, y.end()));
+    double mx = 0, my = 0;
+    for (size_t i = skip; i < x.size(); ++i) { mx += x[i]; my += y[i]; }
+    mx /= n;
+    my /= n;
+    double sxy = 0, sxx = 0;
+    for (size_t i = skip; i < x.size(); ++i) {
+        sxy += (x[i] - mx) * (y[i] - my);
+        sxx += (x[i] - mx) * (x[i] - mx);
+    }
+    double slope = sxx > 0 ? sxy / sxx : 0;
+    t.slopePer1k = slope * 1000;
+    double growth = t.last - t.first;
+    t.growthPct = t.first > 0 ? growth / t.first * 100 : 0;
+    // the fitted line must rise by at least half the median step, so a single late spike does not count
+    double fitted = slope * (x.back() - x[skip]);
+    t.flagged = growth >= minAbs && fitted >= growth / 2 && (minPct < 0 || t.growthPct >= minPct);
+    return t;
+}
+
+struct Soak::Impl {
+    std::string url;
+    SoakOptions opts;
+    std::atomic<bool> stopRequested{false};
+    bool attached = false;
+
+    std::mutex mtx;
+    std::condition_variable arrived;
+    std::deque<ClientConnectionRequest> requests;
+    bool launched = false;
+    DeviceParameters launch;
+
+    // results of the last run
+    LatencyHistogram cycleLatency;
+    uint64_t cycles = 0, failed = 0, noRequest = 0;
+    double elapsedS = 0;
+    std::vector<SoakRow> rows;
+
+    Impl(const std::string &u, const SoakOptions &o): url(u), opts(o) {}
+
+    bool next_request(std::string &mac, std::string &name) {
+        if (!opts.client.empty()) {
+            mac = opts.client;
+            name = "soak";
+            return true;
+        }
+        std::unique_lock<std::mutex> lk(mtx);
+        auto deadline = clock_type::now() + std::chrono::milliseconds(opts.eventTimeoutMs);
+        // short slices: requestStop comes from a signal handler and cannot notify
+        while (requests.empty()) {
+            if (stopRequested || clock_type::now() >= deadline) return false;
+            arrived.wait_for(lk, std::chrono::milliseconds(100));
+        }
+        mac = requests.front().mac;
+        name = requests.front().name;
+        requests.pop_front();
+        launched = false;
+        return true;
+    }
+
+    bool wait_launch(DeviceParameters &device) {
+        std::unique_lock<std::mutex> lk(mtx);
+        auto deadline = clock_type::now() + std::chrono::milliseconds(opts.eventTimeoutMs);
+        while (!launched) {
+            if (stopRequested || clock_type::now() >= deadline) return false;
+            arrived.wait_for(lk, std::chrono::milliseconds(100));
+        }
+        device = launch;
+        return true;
+    }
+
+    // one session; latencyUs excludes the hold. false on the first failed step
+    bool cycle(const std::string &mac, const std::string &name, uint64_t &latencyUs, const char *&failedAt) {
+        auto t0 = clock_type::now();
+        failedAt = "acceptClientConnection";
+        if (!step(url, kAcceptClientConnection, AcceptParams{"Accept"})) return false;
+        DeviceParameters device;
+        if (opts.client.empty()) {
+            failedAt = "onLaunchRequest";
+            if (!wait_launch(device)) {
+                step(url, kStopClientConnection, ClientParams{mac, name});
+                return false;
+            }
+        } else {
+            device.source_dev_mac = mac;
+            device.source_dev_name = name;
+        }
+        VideoRectangle rect{0, 0, 1920, 1080};
+        failedAt = "playRequest";
+        if (!step(url, kPlayRequest, PlayRequestParams{device, rect})) {
+            step(url, kStopClientConnection, ClientParams{mac, name});
+            return false;
+        }
+        auto held = clock_type::now();
+        if (opts.holdMs) std::this_thread::sleep_for(std::chrono::milliseconds(opts.holdMs));
+        auto resumed = clock_type::now();
+        bool stopped = step(url, kStopRequest, StopRequestParams{mac, name, 1});
+        bool closed = step(url, kStopClientConnection, ClientParams{mac, name});
+        failedAt = !stopped ? "stopRequest" : "stopClientConnection";
+        latencyUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            (held - t0) + (clock_type::now() - resumed)).count();
+        return stopped && closed;
+    }
+};
+
+Soak::Soak(const std::string &controllerUrl, const SoakOptions &opts) : pimpl(new Impl(controllerUrl, opts)) {}
+
+Soak::~Soak() {
+    delete pimpl;
+}
+
+void Soak::attach(EventListener &listener) {
+    if (!pimpl->opts.client.empty()) return;
+    pimpl->attached = true;
+    Impl *p = pimpl;
+    on_client_connection_request(listener, [p](const ClientConnectionRequest &ev) {
+        std::lock_guard<std::mutex> g(p->mtx);
+        p->requests.push_back(ev);
+        if (p->requests.size() > kMaxQueuedRequests) p->requests.pop_front();
+        p->arrived.notify_all();
+    });
+    on_launch_request(listener, [p](const LaunchRequest &ev) {
+        std::lock_guard<std::mutex> g(p->mtx);
+        p->launch = ev.device;
+        p->launched = true;
+        p->arrived.notify_all();
+    });
+}
+
+bool Soak::run(std::string &error) {
+    Impl &s = *pimpl;
+    if (s.opts.client.empty() && !s.attached) {
+        error = "no event listener attached and no fixed client";
+        return false;
+    }
+    std::ofstream series;
+    if (!s.opts.seriesFile.empty()) {
+        series.open(s.opts.seriesFile);
+        if (!series) {
+            error = "cannot write " + s.opts.seriesFile;
+            return false;
+        }
+        series << "cycle,elapsed_s,rss_kb,fds,threads,cycle_us_mean,cycle_us_max,cycles_ok,failed\n";
+    }
+    s.cycleLatency.reset();
+    s.cycles = s.failed = s.noRequest = 0;
+    s.rows.clear();
+    unsigned every = std::max(1u, s.opts.sampleEvery);
+
+    auto start = clock_type::now();
+    auto nextStatus = start + std::chrono::seconds(kStatusEveryS);
+    uint64_t winCount = 0, winSum = 0, winMax = 0;
+    unsigned consecutive = 0;
+    auto add_row = [&] {
+        SoakRow r;
+        r.cycle = s.cycles;
+        r.elapsedS = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start).count() / 1000.0;
+        r.res = sample_resources();
+        r.latCount = winCount;
+        r.latMeanUs = winCount ? winSum / winCount : 0;
+        r.latMaxUs = winMax;
+        r.failed = s.failed;
+        s.rows.push_back(r);
+        if (series.is_open()) {
+            series << r.cycle << "," << std::fixed << std::setprecision(3) << r.elapsedS << "," << r.res.rssKb << ","
+                   << r.res.fds << "," << r.res.threads << "," << r.latMeanUs << "," << r.latMaxUs << ","
+                   << r.latCount << "," << r.failed << "\n" << std::flush;
+        }
+        winCount = winSum = winMax = 0;
+    };
+    add_row();  // baseline before the first cycle
+
+    while (!s.stopRequested) {
+        if (s.opts.iterations && s.cycles >= s.opts.iterations) break;
+        if (s.opts.durationS && clock_type::now() - start >= std::chrono::seconds(s.opts.durationS)) break;
+        std::string mac, name;
+        if (!s.next_request(mac, name)) {
+            if (!s.stopRequested) {
+                ++s.noRequest;
+                LogLine(LogLevel::Warn, "soak") << "no onClientConnectionRequest within " << s.opts.eventTimeoutMs << " ms";
+            }
+            continue;
+        }
+        uint64_t us = 0;
+        const char *failedAt = "";
+        bool ok = s.cycle(mac, name, us, failedAt);
+        ++s.cycles;
+        if (ok) {
+            consecutive = 0;
+            s.cycleLatency.record(us);
+            ++winCount;
+            winSum += us;
+            winMax = std::max(winMax, us);
+        } else {
+            ++s.failed;
+            LogLine(LogLevel::Warn, "soak") << "cycle " << s.cycles << " " << mac << " failed at " << failedAt;
+            if (s.opts.maxConsecutiveFailures && ++consecutive >= s.opts.maxConsecutiveFailures) {
+                error = std::to_string(consecutive) + " consecutive failed cycles";
+                break;
+            }
+        }
+        if (s.cycles % every == 0) add_row();
+        if (clock_type::now() >= nextStatus) {
+            const SoakRow &r = s.rows.back();
+            LogLine(LogLevel::Info, "soak") << "cycle " << s.cycles << " failed=" << s.failed << " rss=" << r.res.rssKb
+                << "KiB fds=" << r.res.fds << " threads=" << r.res.threads << " p50="
+                << s.cycleLatency.percentile(50) / 1000.0 << "ms";
+            nextStatus += std::chrono::seconds(kStatusEveryS);
+        }
+    }
+    if (s.rows.back().cycle != s.cycles) add_row();
+    s.elapsedS = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start).count() / 1000.0;
+    if (s.cycles && s.failed == s.cycles && error.empty()) error = "every cycle failed";
+    return error.empty();
+}
+
+void Soak::requestStop() {
+    pimpl->stopRequested = true;
+}
+
+bool Soak::trendsFlagged() const {
+    return report()["flagged"].size() > 0;
+}
+
+Json::Value Soak::report() const {
+    const Impl &s = *pimpl;
+    Json::Value r;
+    r["cycles"] = (Json::UInt64)s.cycles;
+    r["failed"] = (Json::UInt64)s.failed;
+    r["no_request"] = (Json::UInt64)s.noRequest;
+    r["elapsed_s"] = s.elapsedS;
+    r["cycles_per_hour"] = s.elapsedS > 0 ? s.cycles * 3600.0 / s.elapsedS : 0.0;
+    r["cycle_latency_us"] = s.cycleLatency.toJson();
+    r["samples"] = (Json::UInt64)s.rows.size();
+
+    std::vector<double> x, rss, fds, threads, lx, lat;
+    for (const auto &row : s.rows) {
+        x.push_back((double)row.cycle);
+        rss.push_back((double)row.res.rssKb);
+        fds.push_back((double)row.res.fds);
+        threads.push_back((double)row.res.threads);
+        if (row.latCount) {
+            lx.push_back((double)row.cycle);
+            lat.push_back((double)row.latMeanUs);
+        }
+    }
+    struct { const char *name; Trend t; } trends[] = {
+        {"rss_kb", trend(x, rss, 1024, s.opts.growthPct)},
+        {"fds", trend(x, fds, 2, -1)},
+        {"threads", trend(x, threads, 2, -1)},
+        {"cycle_us", trend(lx, lat, 0, s.opts.growthPct)},
+    };
+    Json::Value flagged(Json::arrayValue);
+    for (const auto &e : trends) {
+        Json::Value j;
+        if (!e.t.valid) {
+            j["insufficient_samples"] = true;
+        } else {
+            j["first"] = e.t.first;
+            j["last"] = e.t.last;
+            j["slope_per_1k"] = e.t.slopePer1k;
+            j["growth_pct"] = e.t.growthPct;
+            j["flagged"] = e.t.flagged;
+            if (e.t.flagged) flagged.append(e.name);
+        }
+        r["trends"][e.name] = j;
+    }
+    r["flagged"] = flagged;
+    return r;
+}
+
+void Soak::printReport(std::ostream &out) const {
+    Json::Value r = report();
+    const Json::Value &l = r["cycle_latency_us"];
+    out << "soak: " << r["cycles"].asUInt64() << " cycles in " << std::fixed << std::setprecision(1) << r["elapsed_s"].asDouble()
+        << "s, failed=" << r["failed"].asUInt64() << " no_request=" << r["no_request"].asUInt64()
+        << " cycle p50/p99/max=" << l["p50"].asUInt64() / 1000.0 << "/" << l["p99"].asUInt64() / 1000.0 << "/"
+        << l["max"].asUInt64() / 1000.0 << "ms\n";
+    for (const char *name : {"rss_kb", "fds", "threads", "cycle_us"}) {
+        const Json::Value &t = r["trends"][name];
+        out << "  " << std::left << std::setw(9) << name << std::right;
+        if (t.isMember("insufficient_samples")) {
+            out << "not enough samples for a trend\n";
+            continue;
+        }
+        out << std::setprecision(0) << t["first"].asDouble() << " -> " << t["last"].asDouble()
+            << std::setprecision(1) << " (" << std::showpos << t["growth_pct"].asDouble() << "%, slope "
+            << t["slope_per_1k"].asDouble() << std::noshowpos << "/1k cycles)"
+            << (t["flagged"].asBool() ? "  UPWARD TREND" : "") << "\n";
+    }
+}
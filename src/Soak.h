@@ -0,0 +1,55 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <json/json.h>
+#include "EventListener.h"
+
+struct SoakOptions {
+    unsigned iterations = 1000;       // 0 = until durationS / requestStop
+    unsigned durationS = 0;           // 0 = no time limit
+    unsigned holdMs = 0;              // playRequest -> stopRequest
+    unsigned sampleEvery = 10;        // cycles per time series row
+    unsigned eventTimeoutMs = 10000;  // wait for onClientConnectionRequest / onLaunchRequest
+    unsigned maxConsecutiveFailures = 20;
+    std::string client;               // fixed client MAC: no events awaited (sinks that take unsolicited accepts)
+    std::string seriesFile;           // CSV time series, one row per sample
+    double growthPct = 10;            // latency/RSS rise over the run flagged as a trend
+};
+
+// Session churn soak: repeats accept -> playRequest -> [hold] -> stopRequest -> stopClientConnection
+// with the blocking wrappers of Miracast.h, for thousands of cycles. Every sampleEvery cycles the
+// tester's own RSS, open fd count and thread count (from /proc/self) are sampled together with the
+// cycle latency of the window. At the end each series is checked for an upward trend: after a 10%
+// warm-up, the median of the last quarter is compared with the median of the first quarter and the
+// least-squares slope must agree. fds and threads are flagged on any sustained growth of 2 or more,
+// RSS and latency when they grew by growthPct (RSS also by at least 1 MiB).
+class Soak {
+public:
+    Soak(const std::string &controllerUrl, const SoakOptions &opts = SoakOptions());
+    ~Soak();
+
+    // register the connection request / launch handlers; call before listener.start()
+    void attach(EventListener &listener);
+
+    // blocking; false if the run could not start (series file) or every cycle failed
+    bool run(std::string &error);
+
+    // ask a running soak to stop after the current cycle (async-signal-safe)
+    void requestStop();
+
+    // true if any series was flagged by the last run
+    bool trendsFlagged() const;
+
+    // {"cycles","failed","no_request","elapsed_s","cycle_latency_us":{..},
+    //  "trends":{"<series>":{"first","last","slope_per_1k","growth_pct","flagged"}},"flagged":[..]}
+    Json::Value report() const;
+    void printReport(std::ostream &out) const;
+
+private:
+    Soak(const Soak&) = delete;
+    Soak &operator=(const Soak&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
@@ -0,0 +1,364 @@
+#include "StateCache.h"
+#include "Log.h"
+#include "MiracastEvents.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+typedef std::chrono::steady_clock clock_type;
+
+static const size_t kMaxClients = 64;
+
+// set while this thread runs reconcile(): corrections it makes are drift
+static thread_local bool inReconcile = false;
+
+static std::string lower(const std::string &s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c){ return (char)std::tolower(c); });
+    return out;
+}
+
+static bool ends_with(const std::string &s, const char *suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static int64_t ms_since(clock_type::time_point t, clock_type::time_point now) {
+    return t == clock_type::time_point() ? -1 : (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - t).count();
+}
+
+// Thunder answers some results wrapped in a one element array
+static const Json::Value &unwrap(const Json::Value &result) {
+    return result.isArray() && result.size() > 0 ? result[0] : result;
+}
+
+// Controller status / statechange: activated, resumed and suspended plugins are all up
+static bool plugin_up(const std::string &state) {
+    std::string s = lower(state);
+    return s == "activated" || s == "resumed" || s == "suspended";
+}
+
+static Json::Value known_json(const KnownBool &k) {
+    return k.known ? Json::Value(k.value) : Json::Value();
+}
+
+struct StateCache::Impl {
+    std::string url;
+    std::mutex writeMtx;  // serializes writers; readers only load the pointer
+    std::shared_ptr<const MiracastState> current = std::make_shared<MiracastState>();
+    int observerId = 0;
+    std::atomic<uint64_t> fromEvents{0}, fromRpcs{0}, reconciles{0}, reconcileFailures{0}, drift{0};
+
+    std::mutex recMtx;
+    std::condition_variable recCv;
+    std::thread recThread;
+    bool recRunning = false;
+    bool recWanted = false;
+    unsigned intervalS = 0;
+
+    explicit Impl(const std::string &u): url(u) {}
+
+    // change returns false when it left the state as it was
+    template <typename F>
+    void update(F change) {
+        std::lock_guard<std::mutex> g(writeMtx);
+        auto next = std::make_shared<MiracastState>(*std::atomic_load(&current));
+        if (!change(*next)) return;
+        ++next->version;
+        next->updated = clock_type::now();
+        while (next->clients.size() > kMaxClients) {
+            auto oldest = next->clients.end();
+            for (auto it = next->clients.begin(); it != next->clients.end(); ++it) {
+                if (it->first == next->lastClient) continue;
+                if (oldest == next->clients.end() || it->second.updated < oldest->second.updated) oldest = it;
+            }
+            next->clients.erase(oldest);
+        }
+        std::atomic_store(&current, std::shared_ptr<const MiracastState>(std::move(next)));
+    }
+
+    bool set(KnownBool &k, bool value) {
+        if (k.known && k.value == value) return false;
+        if (inReconcile && k.known) ++drift;
+        k.known = true;
+        k.value = value;
+        return true;
+    }
+
+    static ClientState &client(MiracastState &s, const std::string &mac) {
+        std::string key = lower(mac);
+        ClientState &c = s.clients[key];
+        if (c.mac.empty()) c.mac = mac;
+        c.updated = clock_type::now();
+        return c;
+    }
+
+    void set_plugin(MiracastState &s, const std::string &callsign, bool up, bool &changed) {
+        if (callsign == kMiracastService) {
+            changed |= set(s.serviceActive, up);
+            if (!up && (s.enabled.known || !s.clients.empty())) {
+                // a deactivated service forgets its sessions and its enable state
+                s.enabled = KnownBool();
+                s.clients.clear();
+                s.lastClient.clear();
+                s.pendingClient.clear();
+                changed = true;
+            }
+        } else if (callsign == kMiracastPlayer) {
+            changed |= set(s.playerActive, up);
+        }
+    }
+
+    // any thread that made an RPC through Miracast.h
+    void on_rpc(const RpcEvent &ev) {
+        if (!ev.ok || ev.controllerUrl != url) return;
+        const std::string &m = ev.method;
+        std::string callsign = m.substr(0, m.rfind('.'));
+        // only these change the cached state; nothing else is parsed
+        if (callsign != kMiracastService && callsign != kMiracastPlayer && m.compare(0, 11, "Controller.") != 0) return;
+        if (!ev.response().isObject()) return;
+        const Json::Value &err = ev.response()["error"];
+        if (!err.isNull()) {
+            // ERROR_UNAVAILABLE: the plugin is not active
+            if (err["code"].asInt() == 2 && (callsign == kMiracastService || callsign == kMiracastPlayer)) {
+                ++fromRpcs;
+                update([&](MiracastState &s) { bool changed = false; set_plugin(s, callsign, false, changed); return changed; });
+            }
+            return;
+        }
+        const Json::Value &result = unwrap(ev.response()["result"]);
+        bool handled = true;
+        update([&](MiracastState &s) {
+            bool changed = false;
+            if (m.compare(0, 11, "Controller.") == 0) {
+                size_t at = m.find("status@");
+                if (at != std::string::npos) {
+                    if (result.isObject() && result.isMember("state")) set_plugin(s, m.substr(at + 7), plugin_up(result["state"].asString()), changed);
+                } else if (ends_with(m, ".activate") || ends_with(m, ".deactivate")) {
+                    set_plugin(s, ev.params()["callsign"].asString(), ends_with(m, ".activate"), changed);
+                } else {
+                    handled = false;
+                }
+                return changed;
+            }
+            // a reply from a Miracast plugin proves it is up
+            if (callsign == kMiracastService || callsign == kMiracastPlayer) set_plugin(s, callsign, true, changed);
+            if (ends_with(m, ".setEnable")) {
+                changed |= set(s.enabled, ev.params()["enabled"].asBool());
+            } else if (ends_with(m, ".getEnable")) {
+                if (result.isObject() && result["enabled"].isBool()) changed |= set(s.enabled, result["enabled"].asBool());
+            } else if (ends_with(m, ".acceptClientConnection")) {
+                // carries no MAC: it answers the pending request; nothing pending (a duplicate answer) changes nothing
+                if (!s.pendingClient.empty()) {
+                    client(s, s.pendingClient).phase = ev.params()["requestStatus"].asString() == "Accept" ? "accepted" : "rejected";
+                    s.pendingClient.clear();
+                    changed = true;
+                }
+            } else if (ends_with(m, ".stopClientConnection")) {
+                client(s, ev.params()["mac"].asString()).phase = "disconnected";
+                changed = true;
+            } else if (ends_with(m, ".playRequest")) {
+                const Json::Value &dev = ev.params()["device_parameters"];
+                ClientState &c = client(s, dev["source_dev_mac"].asString());
+                c.phase = "play_requested";
+                c.device = DeviceParameters{dev["source_dev_ip"].asString(), dev["source_dev_mac"].asString(),
+                                            dev["source_dev_name"].asString(), dev["sink_dev_ip"].asString()};
+                changed = true;
+            } else if (ends_with(m, ".stopRequest")) {
+                client(s, ev.params()["mac"].asString()).phase = "stop_requested";
+                changed = true;
+            } else if (!changed) {
+                handled = false;
+            }
+            return changed;
+        });
+        if (handled) ++fromRpcs;
+    }
+
+    // listener I/O thread
+    void on_connection(bool connected) {
+        if (!connected) {
+            update([](MiracastState &s) {
+                if (s.stale) return false;
+                s.stale = true;
+                return true;
+            });
+            return;
+        }
+        std::lock_guard<std::mutex> g(recMtx);
+        recWanted = true;
+        recCv.notify_all();
+    }
+
+    void reconcile_loop() {
+        std::unique_lock<std::mutex> lk(recMtx);
+        while (recRunning) {
+            auto wanted = [this]{ return !recRunning || recWanted; };
+            if (intervalS) recCv.wait_for(lk, std::chrono::seconds(intervalS), wanted);
+            else recCv.wait(lk, wanted);
+            if (!recRunning) break;
+            recWanted = false;
+            lk.unlock();
+            do_reconcile();
+            lk.lock();
+        }
+    }
+
+    bool do_reconcile() {
+        inReconcile = true;
+        Json::Value resp;
+        // status@ is answered by Thunder R2+; without it the getEnable reply (or "not active" error) has to do
+        json_rpc_call(url, std::string("Controller.1.status@") + kMiracastService, Json::Value(Json::objectValue), resp);
+        json_rpc_call(url, std::string("Controller.1.status@") + kMiracastPlayer, Json::Value(Json::objectValue), resp);
+        bool ok = json_rpc_call(url, std::string(kMiracastService) + ".getEnable", Json::Value(Json::objectValue), resp);
+        bool answered = ok || resp["error"]["code"].asInt() == 2;
+        inReconcile = false;
+        if (!answered) {
+            ++reconcileFailures;
+            LogLine(LogLevel::Warn, "state") << "reconcile failed, cached state stays stale";
+            return false;
+        }
+        ++reconciles;
+        update([](MiracastState &s) {
+            s.stale = false;
+            s.reconciled = clock_type::now();
+            return true;
+        });
+        return true;
+    }
+};
+
+StateCache::StateCache(const std::string &controllerUrl) : pimpl(new Impl(controllerUrl)) {}
+
+StateCache::~StateCache() {
+    stopReconciler();
+    if (pimpl->observerId) remove_rpc_observer(pimpl->observerId);
+    delete pimpl;
+}
+
+void StateCache::attach(EventListener &listener) {
+    Impl *p = pimpl;
+    on_client_connection_request(listener, [p](const ClientConnectionRequest &ev) {
+        ++p->fromEvents;
+        p->update([&](MiracastState &s) {
+            ClientState &c = Impl::client(s, ev.mac);
+            c.name = ev.name;
+            c.phase = "requested";
+            c.playerState.clear();
+            c.reasonCode = 0;
+            c.reason.clear();
+            s.lastClient = lower(ev.mac);
+            s.pendingClient = s.lastClient;
+            return true;
+        });
+    });
+    on_client_connection_error(listener, [p](const ClientConnectionError &ev) {
+        ++p->fromEvents;
+        p->update([&](MiracastState &s) {
+            ClientState &c = Impl::client(s, ev.mac);
+            if (!ev.name.empty()) c.name = ev.name;
+            c.phase = "error";
+            c.reason = ev.error_code + " " + ev.reason;
+            if (s.pendingClient == lower(ev.mac)) s.pendingClient.clear();
+            return true;
+        });
+    });
+    on_launch_request(listener, [p](const LaunchRequest &ev) {
+        ++p->fromEvents;
+        p->update([&](MiracastState &s) {
+            ClientState &c = Impl::client(s, ev.device.source_dev_mac);
+            c.phase = "launched";
+            c.device = ev.device;
+            return true;
+        });
+    });
+    on_player_state_change(listener, [p](const PlayerStateChange &ev) {
+        ++p->fromEvents;
+        p->update([&](MiracastState &s) {
+            ClientState &c = Impl::client(s, ev.mac);
+            if (c.name.empty()) c.name = ev.name;
+            c.playerState = ev.state;
+            c.reasonCode = ev.reason_code;
+            c.reason = ev.reason;
+            return true;
+        });
+    });
+    listener.addEventHandler("Controller", "statechange", [p](const Json::Value &params, EventTime) {
+        std::string callsign = params["callsign"].asString();
+        if (callsign != kMiracastService && callsign != kMiracastPlayer) return;
+        ++p->fromEvents;
+        p->update([&](MiracastState &s) {
+            bool changed = false;
+            p->set_plugin(s, callsign, plugin_up(params["state"].asString()), changed);
+            return changed;
+        });
+    });
+    listener.setConnectionCallback([p](bool connected, uint64_t) { p->on_connection(connected); });
+    if (!p->observerId) p->observerId = add_rpc_observer([p](const RpcEvent &ev) { p->on_rpc(ev); });
+}
+
+std::shared_ptr<const MiracastState> StateCache::snapshot() const {
+    return std::atomic_load(&pimpl->current);
+}
+
+bool StateCache::reconcile() {
+    return pimpl->do_reconcile();
+}
+
+void StateCache::startReconciler(unsigned intervalS) {
+    std::lock_guard<std::mutex> g(pimpl->recMtx);
+    if (pimpl->recRunning) return;
+    pimpl->intervalS = intervalS;
+    pimpl->recRunning = true;
+    // the first connect may have happened already
+    pimpl->recWanted = pimpl->recWanted || snapshot()->stale;
+    pimpl->recThread = std::thread(&Impl::reconcile_loop, pimpl);
+}
+
+void StateCache::stopReconciler() {
+    {
+        std::lock_guard<std::mutex> g(pimpl->recMtx);
+        if (!pimpl->recRunning) return;
+        pimpl->recRunning = false;
+        pimpl->recCv.notify_all();
+    }
+    pimpl->recThread.join();
+}
+
+Json::Value StateCache::toJson() const {
+    auto s = snapshot();
+    auto now = clock_type::now();
+    Json::Value j;
+    j["version"] = (Json::UInt64)s->version;
+    j["stale"] = s->stale;
+    j["age_ms"] = (Json::Int64)ms_since(s->updated, now);
+    j["reconciled_ms_ago"] = (Json::Int64)ms_since(s->reconciled, now);
+    j["service_active"] = known_json(s->serviceActive);
+    j["player_active"] = known_json(s->playerActive);
+    j["enabled"] = known_json(s->enabled);
+    j["last_client"] = s->lastClient;
+    j["pending_client"] = s->pendingClient;
+    Json::Value clients(Json::objectValue);
+    for (const auto &kv : s->clients) {
+        const ClientState &c = kv.second;
+        Json::Value cj;
+        cj["name"] = c.name;
+        cj["phase"] = c.phase;
+        cj["player_state"] = c.playerState;
+        cj["reason_code"] = c.reasonCode;
+        cj["reason"] = c.reason;
+        cj["age_ms"] = (Json::Int64)ms_since(c.updated, now);
+        clients[kv.first] = cj;
+    }
+    j["clients"] = clients;
+    j["updates"]["events"] = (Json::UInt64)pimpl->fromEvents.load();
+    j["updates"]["rpcs"] = (Json::UInt64)pimpl->fromRpcs.load();
+    j["updates"]["reconciles"] = (Json::UInt64)pimpl->reconciles.load();
+    j["updates"]["reconcile_failures"] = (Json::UInt64)pimpl->reconcileFailures.load();
+    j["updates"]["drift"] = (Json::UInt64)pimpl->drift.load();
+    return j;
+}
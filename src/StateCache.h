@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <json/json.h>
+#include "EventListener.h"
+#include "Miracast.h"
+
+// a value is only trusted once an event, an RPC result or a reconcile set it
+struct KnownBool {
+    bool known = false;
+    bool value = false;
+};
+
+struct ClientState {
+    std::string mac;
+    std::string name;
+    // requested, accepted, rejected, launched, play_requested, stop_requested, disconnected, error
+    std::string phase;
+    std::string playerState;  // last onStateChange state, "" before the first one
+    int reasonCode = 0;
+    std::string reason;
+    DeviceParameters device;  // from onLaunchRequest
+    std::chrono::steady_clock::time_point updated;
+};
+
+// one consistent view of the device; never modified once published
+struct MiracastState {
+    KnownBool serviceActive;
+    KnownBool playerActive;
+    KnownBool enabled;
+    std::map<std::string, ClientState> clients;  // by lower-case MAC, most recently updated 64 kept
+    std::string lastClient;                      // lower-case MAC of the latest connection request
+    std::string pendingClient;                   // lastClient while its request is unanswered, else ""
+    uint64_t version = 0;                        // bumped by every change
+    bool stale = true;                           // never reconciled, or the event socket dropped since
+    std::chrono::steady_clock::time_point updated;
+    std::chrono::steady_clock::time_point reconciled;
+};
+
+// Local copy of the device state, kept current from the Miracast / Controller notifications and
+// from the results of every RPC made through Miracast.h (observer), so status queries and policy
+// decisions need no round trip. Writers copy the current snapshot, change it and publish the copy;
+// readers take the published snapshot without a lock and never wait for the event thread.
+//
+// Events can be missed while the socket is down, and clients are only known from events, so the
+// plugin states and the enable flag are reconciled with the device (Controller status, getEnable)
+// after every reconnect and, optionally, periodically. Values that a reconcile had to correct are
+// counted as drift.
+class StateCache {
+public:
+    explicit StateCache(const std::string &controllerUrl);
+    // stops the reconciler and removes the RPC observer
+    ~StateCache();
+
+    // register the event handlers and the RPC observer; takes over listener's connection callback
+    // (marks the state stale on disconnect, reconciles on connect). Call before listener.start().
+    void attach(EventListener &listener);
+
+    // lock-free; hold on to the pointer for a consistent view
+    std::shared_ptr<const MiracastState> snapshot() const;
+
+    // blocking: query plugin status and enable state now. Not from a listener callback thread.
+    bool reconcile();
+
+    // background thread: reconcile after each (re)connect and every intervalS (0 = only on connect)
+    void startReconciler(unsigned intervalS);
+    void stopReconciler();
+
+    // {"version","stale","age_ms","reconciled_ms_ago","service_active","player_active","enabled",
+    //  "last_client","pending_client","clients":{"<mac>":{"name","phase","player_state","reason_code","reason","age_ms"}},
+    //  "updates":{"events","rpcs","reconciles","reconcile_failures","drift"}}  (unknown values are null)
+    Json::Value toJson() const;
+
+private:
+    StateCache(const StateCache&) = delete;
+    StateCache &operator=(const StateCache&) = delete;
+
+    struct Impl;
+    Impl* pimpl;
+};
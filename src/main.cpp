@@ -1,12 +1,29 @@
 #include "Miracast.h"
 #include "EventListener.h"
+#include "MiracastEvents.h"
+#include "AutoAccept.h"
+#include "SessionTracker.h"
+#include "Scenario.h"
+#include "Fleet.h"
+#include "CommandRunner.h"
+#include "Daemon.h"
+#include "Soak.h"
+#include "LoadGen.h"
+#include "RectStress.h"
+#include "StateCache.h"
+#include "Log.h"
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <thread>
 #include <mutex>
+#include <csignal>
+#include <memory>
 #include <json/json.h>
 
 static void print_help() {
@@ -16,7 +33,28 @@ static void print_help() {
               << "  2. activate_player\n"
               << "  3. set_enable\n"
               << "  4. accept      # accept last seen client (from events)\n"
-              << "  5. quit\n";
+              << "  5. quit\n"
+              << "  RPC commands run in the background (over HTTP, or the event WebSocket after 'transport ws'); add --timeout <ms> to any of them\n"
+              << "  jobs        # commands still running\n"
+              << "  cancel <id>|all   # abort running commands\n"
+              << "  wait [id]   # block until a command (or all) finished\n"
+              << "  timeout <ms>      # default timeout of new commands (default 6000)\n"
+              << "  timing [id] # DNS/connect/first-byte/total time of a command's last RPC (default: the last finished)\n"
+              << "  transport ws|http  # send RPCs over the event WebSocket or HTTP (default http)\n"
+              << "  bringup [batch|pipeline]   # activate_service + activate_player + set_enable (in the background, or blocking in one round trip)\n"
+              << "  teardown [batch|pipeline]  # set_enable false + deactivate player + deactivate service\n"
+              << "  evstats     # event queue depth, drops and dispatch latency\n"
+              << "  capture <file>|off  # append every raw event frame to an event log\n"
+              << "  replay <file> [speed]  # feed a captured log to the handlers (1 = real time, 0 = as fast as possible)\n"
+              << "  conn        # event WebSocket state, reconnects and time spent disconnected\n"
+              << "  events on|off      # pretty print every raw notification\n"
+              << "  auto on|off|stats  # automatic accept of connection requests\n"
+              << "  auto allow|deny <pattern> | auto max <n> | auto rate <per_sec> | auto clear\n"
+              << "  stats [json|prom] [file]  # session phase latency histograms\n"
+              << "  get_enable [fresh]  # enable state from the local state cache (RPC if unknown, stale or 'fresh')\n"
+              << "  state [json|sync]   # cached plugin/enable/client state; sync = reconcile with the device now\n"
+              << "  rect <X> <Y> <W> <H>  # move/resize the video of the running session (setVideoRectangle)\n"
+              << "  log level <level> | log stats  # log verbosity (error|warn|info|debug|trace), written/dropped lines\n";
 }
 
 
@@ -28,76 +66,582 @@ static std::vector<std::string> split_tokens(const std::string &s) {
     return out;
 }
 
-static std::string http_to_ws(const std::string &httpUrl) {
-    if (httpUrl.rfind("https://", 0) == 0) {
-        return std::string("wss://") + httpUrl.substr(8);
-    } else if (httpUrl.rfind("http://", 0) == 0) {
-        return std::string("ws://") + httpUrl.substr(7);
+static void print_usage(const char *prog) {
+    std::cout << "Usage: " << prog << " [options] [controller_url]\n"
+              << "  --workers N      event dispatch threads (default 1, >1 may reorder events)\n"
+              << "  --queue N        event queue capacity (default 1024)\n"
+              << "  --overflow P     queue full policy: drop-oldest|drop-newest|block (default drop-oldest)\n"
+              << "  --print-events   pretty print every raw notification (same as 'events on')\n"
+              << "  --no-reconnect   do not reconnect the event WebSocket when it drops\n"
+              << "  --max-backoff-ms N  cap of the jittered exponential reconnect backoff (default 5000)\n"
+              << "  --ca-file F      wss:// event socket: trust the PEM certificates in F instead of the system store\n"
+              << "  --insecure       wss:// event socket: skip certificate and host name checks\n"
+              << "  --no-tls-resume  wss:// event socket: full TLS handshake on every reconnect\n"
+              << "  --auto-accept    answer connection requests automatically (see 'auto' command)\n"
+              << "  --allow P        auto-accept only MACs/names matching P ('*' wildcard, repeatable)\n"
+              << "  --deny P         always reject MACs/names matching P (repeatable)\n"
+              << "  --max-sessions N reject when N accepted sessions are active\n"
+              << "  --accept-rate R  at most R accepts per second\n"
+              << "  --accept-log F   write per-request accept latency CSV to F at exit\n"
+              << "  --stats-out F    write session phase latencies to F at exit (.prom = Prometheus text, else JSON)\n"
+              << "  --scenario F     run the steps in F non-interactively and exit 0 if all passed (see Scenario.h)\n"
+              << "  --report F       write the scenario (or soak/load/rect) report (JSON) to F\n"
+              << "  --capture F      append every raw event frame to the event log F\n"
+              << "  --replay F       replay the event log F through the handlers offline, print dispatch stats and exit\n"
+              << "  --replay-speed X replay pacing: 1 = recorded timing (default), X times faster, 0 = as fast as possible\n"
+              << "  --target URL     fleet mode: drive this controller too (repeatable; replaces the prompt)\n"
+              << "  --fleet F        fleet mode: controller URLs from F, one per line ('#' comments)\n"
+              << "  --duration S     fleet/soak/load/rect mode: stop after S seconds (default: until Ctrl-C)\n"
+              << "  --hold-ms N      fleet mode: PLAYING -> stopRequest delay (default 2000)\n"
+              << "  --sessions N     fleet mode: sessions per device before further requests are rejected\n"
+              << "  --no-bringup     fleet/soak mode: do not activate plugins / setEnable on start\n"
+              << "  --fleet-report F fleet mode: write the aggregated report (JSON) to F\n"
+              << "  --rpc-timeout-ms N  default timeout of interactive commands (default 6000)\n"
+              << "  --soak N         soak mode: N accept/play/stop/disconnect cycles (0 = until --duration or Ctrl-C),\n"
+              << "                   then report leak/latency trends; exit 1 if one was flagged (see Soak.h)\n"
+              << "  --soak-series F  soak mode: write the RSS/fd/thread/latency time series (CSV) to F\n"
+              << "  --soak-sample N  soak mode: cycles per time series sample (default 10)\n"
+              << "  --soak-hold-ms N soak mode: playRequest -> stopRequest delay (default 0)\n"
+              << "  --soak-client M  soak mode: use client MAC M instead of waiting for connection requests\n"
+              << "  --soak-growth-pct P  soak mode: RSS/latency growth flagged as a trend (default 10)\n"
+              << "  --load M         load mode: call JSON-RPC method M (no '.': on org.rdk.MiracastService) at a fixed rate\n"
+              << "                   for --duration seconds (default 10) and report latency from each request's due time\n"
+              << "  --load-params J  load mode: params of every request (JSON, default {})\n"
+              << "  --load-rate R    load mode: requests per second (default 100)\n"
+              << "  --load-workers N load mode: requests in flight at most (default 16)\n"
+              << "  --load-timeout-ms N  load mode: per request timeout (default 6000)\n"
+              << "  --rect-stress N  rect mode: N setVideoRectangle changes on the live session (0 = until --duration\n"
+              << "                   or Ctrl-C); report per-change latency, dropped and coalesced changes (see RectStress.h)\n"
+              << "  --rect-pattern P rect mode: random|sweep|corners or a file of 'X Y W H' lines (default random)\n"
+              << "  --rect-rate R    rect mode: changes per second (default 10)\n"
+              << "  --rect-inflight N  rect mode: calls outstanding before changes coalesce (default 1)\n"
+              << "  --rect-screen WxH  rect mode: screen size (default 1920x1080)\n"
+              << "  --rect-client M  rect mode: start the session with playRequest for MAC M instead of waiting for PLAYING\n"
+              << "  --rect-log F     rect mode: write every change (CSV) to F\n"
+              << "  --rect-timeout-ms N  rect mode: per change timeout, later replies count as dropped (default 2000)\n"
+              << "  --state-sync S   reconcile the state cache with the device every S seconds (default 60, 0 = only\n"
+              << "                   after a reconnect)\n"
+              << "  --log-level L    error|warn|info|debug|trace (default info)\n"
+              << "  --log-file F     append log lines to F instead of the console\n"
+              << "  --daemon SOCK    stay resident and serve commands/event streams on the Unix socket SOCK (see Daemon.h)\n"
+              << "  --client SOCK CMD  send one command to a daemon and print its reply; CMD is one of\n"
+              << "                   ping | stats | state | shutdown | call <method> [params_json] [--timeout ms]\n"
+              << "                   | events [name...] [--since seq]   (streams until Ctrl-C)\n";
+}
+
+static Scenario *runningScenario = nullptr;
+
+static void stop_scenario(int) {
+    if (runningScenario) runningScenario->requestStop();
+}
+
+static Soak *runningSoak = nullptr;
+
+static void stop_soak(int) {
+    if (runningSoak) runningSoak->requestStop();
+}
+
+static RectStress *runningRect = nullptr;
+
+static void stop_rect(int) {
+    if (runningRect) runningRect->requestStop();
+}
+
+static LoadGenerator *runningLoad = nullptr;
+
+static void stop_load(int) {
+    if (runningLoad) runningLoad->requestStop();
+}
+
+static volatile sig_atomic_t fleetInterrupted = 0;
+
+static void stop_fleet(int) {
+    fleetInterrupted = 1;
+}
+
+// strips a trailing "--timeout <ms>" from tokens; false if its value is not a number
+static bool take_timeout(std::vector<std::string> &tokens, long &timeoutMs) {
+    if (tokens.size() < 3 || tokens[tokens.size() - 2] != "--timeout") return true;
+    try {
+        timeoutMs = std::stol(tokens.back());
+    } catch (...) {
+        return false;
     }
-    return httpUrl;
+    tokens.resize(tokens.size() - 2);
+    return true;
+}
+
+static volatile sig_atomic_t daemonInterrupted = 0;
+
+static void stop_daemon(int) {
+    daemonInterrupted = 1;
+}
+
+static std::string compact_json(const Json::Value &v) {
+    Json::StreamWriterBuilder w;
+    w["indentation"] = "";
+    return Json::writeString(w, v);
+}
+
+static std::string pretty_json(const Json::Value &v) {
+    Json::StreamWriterBuilder w;
+    w["indentation"] = "  ";
+    return Json::writeString(w, v);
 }
 
-// search Json::Value recursively for keys "mac" and "name" (return true if found)
-static bool find_mac_name(const Json::Value &j, std::string &mac, std::string &name) {
-    if (j.isObject()) {
-        if (j.isMember("mac") && j.isMember("name") && j["mac"].isString() && j["name"].isString()) {
-            mac = j["mac"].asString();
-            name = j["name"].asString();
-            return true;
+// --report FILE of every mode; nothing if path is empty
+static void write_report(const std::string &path, const Json::Value &report) {
+    if (path.empty()) return;
+    std::ofstream out(path);
+    if (!(out << pretty_json(report) << "\n")) std::cerr << "Cannot write " << path << "\n";
+}
+
+// --client: one request to a running daemon, reply (or event stream) on stdout; 0 if it succeeded
+static int run_client(const std::string &socketPath, std::vector<std::string> args) {
+    long timeoutMs = 0;
+    if (!take_timeout(args, timeoutMs) || args.empty()) { print_usage("mcasttester"); return 2; }
+    DaemonClient client;
+    std::string error;
+    if (!client.connect(socketPath, error)) { std::cerr << "[client] " << error << "\n"; return 1; }
+
+    Json::Value req;
+    const std::string &cmd = args[0];
+    if (cmd == "ping" || cmd == "stats" || cmd == "state" || cmd == "shutdown") {
+        req["cmd"] = cmd;
+    } else if (cmd == "call" && (args.size() == 2 || args.size() == 3)) {
+        req["cmd"] = "call";
+        req["method"] = args[1];
+        if (args.size() == 3 && !decode_rpc_response(args[2], req["params"])) {
+            std::cerr << "[client] params are not valid JSON\n";
+            return 2;
         }
-        for (const auto &key : j.getMemberNames()) {
-            if (find_mac_name(j[key], mac, name)) return true;
+        if (timeoutMs > 0) req["timeout_ms"] = (Json::Int64)timeoutMs;
+    } else if (cmd == "events") {
+        req["cmd"] = "subscribe";
+        req["events"] = Json::Value(Json::arrayValue);
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (args[i] == "--since" && i + 1 < args.size()) {
+                try { req["since"] = (Json::UInt64)std::stoull(args[++i]); } catch (...) { print_usage("mcasttester"); return 2; }
+            } else {
+                req["events"].append(args[i]);
+            }
+        }
+    } else {
+        print_usage("mcasttester");
+        return 2;
+    }
+
+    // the daemon bounds calls itself; leave room for its reply
+    long replyMs = (timeoutMs > 0 ? timeoutMs : 6000) + 2000;
+    Json::Value reply;
+    if (!client.request(req, reply, replyMs, error)) { std::cerr << "[client] " << error << "\n"; return 1; }
+    std::cout << compact_json(reply) << std::endl;
+    if (!reply["ok"].asBool()) return 1;
+    if (cmd != "events") return 0;
+
+    std::signal(SIGINT, stop_daemon);
+    std::signal(SIGTERM, stop_daemon);
+    Json::Value frame;
+    while (!daemonInterrupted) {
+        if (client.receive(frame, 200, error)) {
+            std::cout << compact_json(frame) << std::endl;
+        } else if (error != "timeout") {
+            std::cerr << "[client] " << error << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static bool read_targets(const std::string &path, std::vector<std::string> &out) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        auto tokens = split_tokens(line);
+        if (!tokens.empty() && tokens[0][0] != '#') out.push_back(tokens[0]);
+    }
+    return true;
+}
+
+// non-interactive: run every target until duration or Ctrl-C, printing a status line every 10 s
+static int run_fleet(const std::vector<std::string> &targets, const FleetOptions &opts, unsigned durationS,
+                     const std::string &reportFile) {
+    Fleet fleet(targets, opts);
+    std::cout << "Fleet of " << fleet.size() << " controllers" << (durationS ? ", " + std::to_string(durationS) + "s" : "") << "\n";
+    if (!fleet.start()) {
+        std::cerr << "No controller could be started\n";
+        return 1;
+    }
+    std::signal(SIGINT, stop_fleet);
+    std::signal(SIGTERM, stop_fleet);
+    auto start = std::chrono::steady_clock::now();
+    auto nextStatus = start + std::chrono::seconds(10);
+    while (!fleetInterrupted) {
+        auto now = std::chrono::steady_clock::now();
+        if (durationS && now - start >= std::chrono::seconds(durationS)) break;
+        if (now >= nextStatus) {
+            const Json::Value t = fleet.report()["totals"];
+            std::cout << "[fleet] connected " << t["connected"].asUInt64() << "/" << t["devices"].asUInt64()
+                      << " requests=" << t["requests"].asUInt64() << " completed=" << t["sessions_completed"].asUInt64()
+                      << " errors=" << t["rpc_errors"].asUInt64() + t["client_errors"].asUInt64() << "\n";
+            nextStatus += std::chrono::seconds(10);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    fleet.stop();
+    log_flush();
+    fleet.printReport(std::cout);
+    write_report(reportFile, fleet.report());
+    return 0;
+}
+
+// non-interactive: offer opts.rate requests/s for the duration, one status line per second
+static int run_load(const std::string &controllerUrl, const LoadOptions &opts, const std::string &reportFile) {
+    LoadGenerator load(controllerUrl, opts);
+    std::cout << "Load " << opts.method << " on " << controllerUrl << ": " << opts.rate << "/s, "
+              << opts.workers << " workers, " << opts.durationS << "s\n";
+    runningLoad = &load;
+    std::signal(SIGINT, stop_load);
+    std::signal(SIGTERM, stop_load);
+    std::string error;
+    bool ok = load.run(error, [](const Json::Value &iv){
+        const Json::Value &l = iv["latency_us"];
+        std::ostringstream line;
+        line.setf(std::ios::fixed);
+        line.precision(1);
+        line << "[load] t=" << iv["t_s"].asDouble() << "s sent=" << iv["sent"].asUInt64() << " ok=" << iv["ok"].asUInt64()
+             << " err=" << iv["errors"].asUInt64() << " rate=" << iv["rate"].asDouble()
+             << "/s p50=" << l["p50"].asUInt64() / 1000.0 << " p99=" << l["p99"].asUInt64() / 1000.0
+             << " p99.9=" << l["p999"].asUInt64() / 1000.0 << " max=" << l["max"].asUInt64() / 1000.0
+             << "ms in_flight=" << iv["in_flight"].asUInt() << " behind=" << iv["behind_ms"].asDouble() << "ms\n";
+        std::cout << line.str() << std::flush;
+    });
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    runningLoad = nullptr;
+    log_flush();
+    if (!ok) {
+        std::cerr << "Load: " << error << "\n";
+        return 1;
+    }
+    load.printReport(std::cout);
+    write_report(reportFile, load.report());
+    const Json::Value r = load.report();
+    return r["errors"].asUInt64() == 0 && r["unsent"].asUInt64() == 0 ? 0 : 1;
+}
+
+static void print_replay_stats(const ReplayStats &st) {
+    std::cout << "replayed frames=" << st.frames << " bytes=" << st.bytes << " dropped=" << st.dropped
+              << " elapsed=" << st.elapsedS << "s (" << (long)(st.elapsedS > 0 ? st.frames / st.elapsedS : 0) << " frames/s)"
+              << " max_lag=" << st.maxLagUs << "us\n";
+}
+
+static bool parse_overflow(const std::string &v, DispatchOptions::Overflow &out) {
+    if (v == "drop-oldest") out = DispatchOptions::Overflow::DropOldest;
+    else if (v == "drop-newest") out = DispatchOptions::Overflow::DropNewest;
+    else if (v == "block") out = DispatchOptions::Overflow::Block;
+    else return false;
+    return true;
+}
+
+static void print_dispatch_stats(const DispatchStats &st) {
+    std::cout << "events received=" << st.received << " dispatched=" << st.dispatched
+              << " dropped=" << st.dropped << " parse_errors=" << st.parseErrors << " handler_errors=" << st.handlerErrors
+              << " queue_depth=" << st.queueDepth << " max_depth=" << st.maxQueueDepth
+              << " avg_latency=" << (long)st.avgLatencyUs << "us max_latency=" << st.maxLatencyUs << "us\n";
+}
+
+static void handle_auto_command(AutoAcceptor &acceptor, const std::vector<std::string> &tokens) {
+    std::string sub = tokens.size() > 1 ? tokens[1] : "stats";
+    AutoAcceptRules rules = acceptor.getRules();
+    try {
+        if (sub == "on" || sub == "off") {
+            acceptor.setEnabled(sub == "on");
+        } else if (sub == "allow" && tokens.size() == 3) {
+            rules.allow.push_back(tokens[2]);
+        } else if (sub == "deny" && tokens.size() == 3) {
+            rules.deny.push_back(tokens[2]);
+        } else if (sub == "max" && tokens.size() == 3) {
+            rules.maxSessions = (unsigned)std::stoul(tokens[2]);
+        } else if (sub == "rate" && tokens.size() == 3) {
+            rules.ratePerSec = std::stod(tokens[2]);
+        } else if (sub == "clear") {
+            rules = AutoAcceptRules();
+        } else if (sub == "stats") {
+            AutoAcceptStats st = acceptor.getStats();
+            std::cout << "auto-accept " << (acceptor.isEnabled() ? "on" : "off")
+                      << " accepted=" << st.accepted << " rejected=" << st.rejected << " failed=" << st.failed
+                      << " active=" << st.activeSessions << " request->accept min/p50/p99/max="
+                      << st.minUs << "/" << st.p50Us << "/" << st.p99Us << "/" << st.maxUs << "us\n";
+            return;
+        } else {
+            std::cerr << "Usage: auto on|off|stats|clear | auto allow|deny <pattern> | auto max <n> | auto rate <per_sec>\n";
+            return;
         }
-    } else if (j.isArray()) {
-        for (const auto &el : j) if (find_mac_name(el, mac, name)) return true;
+    } catch (...) {
+        std::cerr << "Invalid number\n";
+        return;
+    }
+    acceptor.setRules(rules);
+}
+
+static Json::Value callsign_params(const char *callsign) {
+    Json::Value params;
+    params["callsign"] = callsign;
+    return params;
+}
+
+static Json::Value enable_params(bool enabled) {
+    Json::Value params;
+    params["enabled"] = enabled;
+    return params;
+}
+
+// activate/deactivate both plugins and setEnable, in bring up (or reverse) order
+static std::vector<RpcCall> bring_up_calls(bool up) {
+    if (up) {
+        return {{"Controller.activate", callsign_params("org.rdk.MiracastService")},
+                {"Controller.activate", callsign_params("org.rdk.MiracastPlayer")},
+                {"org.rdk.MiracastService.setEnable", enable_params(true)}};
+    }
+    return {{"org.rdk.MiracastService.setEnable", enable_params(false)},
+            {"Controller.deactivate", callsign_params("org.rdk.MiracastPlayer")},
+            {"Controller.deactivate", callsign_params("org.rdk.MiracastService")}};
+}
+
+static void print_jobs(const CommandRunner &runner) {
+    auto jobs = runner.list();
+    if (jobs.empty()) {
+        std::cout << "no commands running\n";
+        return;
+    }
+    for (const auto &j : jobs) {
+        std::cout << "#" << j.id << " " << j.label << " " << j.elapsedUs / 1000 << "/" << j.timeoutMs << "ms";
+        if (j.steps > 1) std::cout << " step " << j.step + 1 << "/" << j.steps;
+        std::cout << "\n";
     }
-    return false;
 }
 
 int main(int argc, char **argv) {
     std::string controllerUrl;
-    if (argc > 1) {
-        controllerUrl = argv[1];
-    } else {
+    DispatchOptions dispatch;
+    bool printEvents = false;
+    ReconnectOptions reconnect;
+    TlsOptions tls;
+    bool autoAccept = false;
+    AutoAcceptRules acceptRules;
+    std::string acceptLog;
+    std::string statsOut;
+    std::string scenarioFile;
+    std::string reportFile;
+    std::string captureFile;
+    std::string replayFile;
+    double replaySpeed = 1.0;
+    std::vector<std::string> targets;
+    FleetOptions fleetOpts;
+    unsigned durationS = 0;
+    std::string fleetReport;
+    long rpcTimeoutMs = 6000;
+    std::string daemonSocket;
+    LogOptions logOpts;
+    bool logLevelSet = false;
+    bool soak = false;
+    SoakOptions soakOpts;
+    LoadOptions loadOpts;
+    bool rectStress = false;
+    RectStressOptions rectOpts;
+    unsigned stateSyncS = 60;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        try {
+            if (a == "-h" || a == "--help") { print_usage(argv[0]); return 0; }
+            else if (a == "--workers" && hasValue) dispatch.workers = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--queue" && hasValue) dispatch.queueCapacity = std::stoul(argv[++i]);
+            else if (a == "--print-events") printEvents = true;
+            else if (a == "--no-reconnect") reconnect.enabled = false;
+            else if (a == "--ca-file" && hasValue) tls.caFile = argv[++i];
+            else if (a == "--insecure") tls.verifyPeer = false;
+            else if (a == "--no-tls-resume") tls.sessionResumption = false;
+            else if (a == "--max-backoff-ms" && hasValue) reconnect.maxBackoffMs = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--auto-accept") autoAccept = true;
+            else if (a == "--allow" && hasValue) acceptRules.allow.push_back(argv[++i]);
+            else if (a == "--deny" && hasValue) acceptRules.deny.push_back(argv[++i]);
+            else if (a == "--max-sessions" && hasValue) acceptRules.maxSessions = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--accept-rate" && hasValue) acceptRules.ratePerSec = std::stod(argv[++i]);
+            else if (a == "--accept-log" && hasValue) acceptLog = argv[++i];
+            else if (a == "--stats-out" && hasValue) statsOut = argv[++i];
+            else if (a == "--scenario" && hasValue) scenarioFile = argv[++i];
+            else if (a == "--report" && hasValue) reportFile = argv[++i];
+            else if (a == "--capture" && hasValue) captureFile = argv[++i];
+            else if (a == "--replay" && hasValue) replayFile = argv[++i];
+            else if (a == "--replay-speed" && hasValue) replaySpeed = std::stod(argv[++i]);
+            else if (a == "--target" && hasValue) targets.push_back(argv[++i]);
+            else if (a == "--fleet" && hasValue) {
+                if (!read_targets(argv[++i], targets)) { std::cerr << "Cannot read " << argv[i] << "\n"; return 1; }
+            }
+            else if (a == "--duration" && hasValue) durationS = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--hold-ms" && hasValue) fleetOpts.holdMs = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--sessions" && hasValue) fleetOpts.maxSessions = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--no-bringup") fleetOpts.bringUp = false;
+            else if (a == "--fleet-report" && hasValue) fleetReport = argv[++i];
+            else if (a == "--rpc-timeout-ms" && hasValue) rpcTimeoutMs = std::stol(argv[++i]);
+            else if (a == "--daemon" && hasValue) daemonSocket = argv[++i];
+            else if (a == "--log-level" && hasValue) {
+                if (!parse_log_level(argv[++i], logOpts.level)) { print_usage(argv[0]); return 1; }
+                logLevelSet = true;
+            }
+            else if (a == "--log-file" && hasValue) logOpts.file = argv[++i];
+            else if (a == "--soak" && hasValue) { soak = true; soakOpts.iterations = (unsigned)std::stoul(argv[++i]); }
+            else if (a == "--soak-series" && hasValue) soakOpts.seriesFile = argv[++i];
+            else if (a == "--soak-sample" && hasValue) soakOpts.sampleEvery = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--soak-hold-ms" && hasValue) soakOpts.holdMs = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--soak-client" && hasValue) soakOpts.client = argv[++i];
+            else if (a == "--soak-growth-pct" && hasValue) soakOpts.growthPct = std::stod(argv[++i]);
+            else if (a == "--load" && hasValue) loadOpts.method = argv[++i];
+            else if (a == "--load-params" && hasValue) {
+                if (!decode_rpc_response(argv[++i], loadOpts.params)) { std::cerr << "Invalid --load-params\n"; return 1; }
+            }
+            else if (a == "--load-rate" && hasValue) loadOpts.rate = std::stod(argv[++i]);
+            else if (a == "--load-workers" && hasValue) loadOpts.workers = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--load-timeout-ms" && hasValue) loadOpts.timeoutMs = std::stol(argv[++i]);
+            else if (a == "--state-sync" && hasValue) stateSyncS = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--rect-stress" && hasValue) { rectStress = true; rectOpts.changes = (unsigned)std::stoul(argv[++i]); }
+            else if (a == "--rect-pattern" && hasValue) {
+                std::string error;
+                if (!parse_rect_pattern(argv[++i], rectOpts, error)) { std::cerr << "Rect pattern: " << error << "\n"; return 1; }
+            }
+            else if (a == "--rect-rate" && hasValue) rectOpts.rate = std::stod(argv[++i]);
+            else if (a == "--rect-inflight" && hasValue) rectOpts.maxInFlight = (unsigned)std::stoul(argv[++i]);
+            else if (a == "--rect-screen" && hasValue) {
+                std::string v = argv[++i];
+                size_t x = v.find('x');
+                if (x == std::string::npos) { print_usage(argv[0]); return 1; }
+                rectOpts.screenW = std::stoi(v.substr(0, x));
+                rectOpts.screenH = std::stoi(v.substr(x + 1));
+            }
+            else if (a == "--rect-client" && hasValue) rectOpts.client = argv[++i];
+            else if (a == "--rect-log" && hasValue) rectOpts.changesFile = argv[++i];
+            else if (a == "--rect-timeout-ms" && hasValue) rectOpts.timeoutMs = std::stol(argv[++i]);
+            else if (a == "--client" && hasValue) {
+                // everything after the socket is the command
+                std::string socketPath = argv[++i];
+                return run_client(socketPath, std::vector<std::string>(argv + i + 1, argv + argc));
+            }
+            else if (a == "--overflow" && hasValue) {
+                if (!parse_overflow(argv[++i], dispatch.overflow)) { print_usage(argv[0]); return 1; }
+            }
+            else if (a.rfind("--", 0) == 0) { print_usage(argv[0]); return 1; }
+            else controllerUrl = a;
+        } catch (...) { print_usage(argv[0]); return 1; }
+    }
+    // only the interactive prompt needs redrawing after asynchronous output
+    if (targets.empty() && scenarioFile.empty() && replayFile.empty() && daemonSocket.empty() && !soak && loadOpts.method.empty() && !rectStress) logOpts.prompt = "> ";
+    // thousands of cycles: keep the per-RPC lines out unless asked for
+    if (soak && !logLevelSet) logOpts.level = LogLevel::Warn;
+    {
+        std::string error;
+        if (!log_start(logOpts, error)) { std::cerr << "Log file: " << error << "\n"; return 1; }
+    }
+    if (!targets.empty()) {
+        if (!controllerUrl.empty()) targets.push_back(controllerUrl);
+        fleetOpts.workers = dispatch.workers;
+        return run_fleet(targets, fleetOpts, durationS, fleetReport);
+    }
+    if (controllerUrl.empty()) {
 #ifdef THUNDER_JSONRPC_URL
         controllerUrl = std::string(THUNDER_JSONRPC_URL);
 #else
         controllerUrl = "http://127.0.0.1:9998/jsonrpc";
 #endif
     }
+    if (!loadOpts.method.empty()) {
+        if (loadOpts.method.find('.') == std::string::npos) loadOpts.method = std::string(kMiracastService) + "." + loadOpts.method;
+        if (durationS) loadOpts.durationS = durationS;
+        return run_load(controllerUrl, loadOpts, reportFile);
+    }
     std::string wsUrl = http_to_ws(controllerUrl);
 
+    Scenario scenario;
+    if (!scenarioFile.empty()) {
+        std::string error;
+        if (!scenario.load(scenarioFile, error)) { std::cerr << "Scenario: " << error << "\n"; return 1; }
+    }
+
     std::cout << "Miracast CLI w/ events\nController HTTP JSON-RPC URL: " << controllerUrl << "\n";
     std::cout << "WebSocket event URL (derived): " << wsUrl << "\n";
-    print_help();
-
-    // last seen client (from events)
-    std::string last_mac;
-    std::string last_name;
-    std::mutex last_mutex;
+    if (scenarioFile.empty() && replayFile.empty() && daemonSocket.empty() && !soak && !rectStress) print_help();
 
+    SessionTracker tracker(controllerUrl);
     EventListener listener(wsUrl);
-    listener.setNotificationCallback([&](const Json::Value &j){
-        // Print incoming notification (pretty)
-        Json::StreamWriterBuilder w;
-        w["indentation"] = "  ";
-        std::string pretty = Json::writeString(w, j);
-        std::cout << "\n[Event] " << pretty << "\n";
-
-        // Try to detect client connection request (mac/name)
-        std::string mac, name;
-        if (find_mac_name(j, mac, name)) {
-            {
-                std::lock_guard<std::mutex> g(last_mutex);
-                last_mac = mac;
-                last_name = name;
-            }
-            std::cout << "[Info] Detected client request - mac: " << mac << " name: " << name << "\n";
-            std::cout << "[Info] Use 'accept' or 'reject' to respond.\n> " << std::flush;
-        } else {
-            std::cout << "> " << std::flush;
-        }
+    AutoAcceptor acceptor(controllerUrl, acceptRules);
+    listener.setDispatchOptions(dispatch);
+    listener.setReconnectOptions(reconnect);
+    listener.setTlsOptions(tls);
+    // every raw notification, pretty printed (off by default: unrouted events are then skipped unparsed)
+    // (compact here, pretty printed by the log writer thread)
+    auto print_all_events = [](const Json::Value &j){
+        if (!log_enabled(LogLevel::Info)) return;
+        std::string text = compact_json(j);
+        log_write(LogLevel::Info, "Event", text.data(), text.size(), true);
+    };
+    if (printEvents) listener.setNotificationCallback(print_all_events);
+
+    on_client_connection_request(listener, [&](const ClientConnectionRequest &ev){
+        LogLine(LogLevel::Info, "Info") << "Detected client request - mac: " << ev.mac << " name: " << ev.name
+            << (acceptor.isEnabled() ? "" : " (use 'accept' or 'reject' to respond)");
     });
+    // handlers run in registration order, and the acceptor answers from its handler: everything that
+    // records the request must be registered before it
+    tracker.attach(listener);
+    StateCache state(controllerUrl);
+    state.attach(listener);
+    // a replay only exercises the handlers: answering its recorded requests would send real RPCs
+    if (replayFile.empty()) {
+        acceptor.attach(listener);
+        acceptor.setEnabled(autoAccept);
+    } else if (autoAccept) {
+        std::cerr << "--auto-accept is ignored with --replay\n";
+    }
+    on_client_connection_error(listener, [](const ClientConnectionError &ev){
+        LogLine(LogLevel::Info, "Event") << "onClientConnectionError mac: " << ev.mac << " name: " << ev.name
+            << " error_code: " << ev.error_code << " reason: " << ev.reason;
+    });
+    on_launch_request(listener, [](const LaunchRequest &ev){
+        LogLine(LogLevel::Info, "Event") << "onLaunchRequest source: " << ev.device.source_dev_ip << " " << ev.device.source_dev_mac
+            << " " << ev.device.source_dev_name << " sink: " << ev.device.sink_dev_ip;
+    });
+    on_player_state_change(listener, [](const PlayerStateChange &ev){
+        LogLine(LogLevel::Info, "Event") << "onStateChange mac: " << ev.mac << " state: " << ev.state
+            << " reason_code: " << ev.reason_code << " reason: " << ev.reason;
+    });
+
+    if (!scenarioFile.empty()) scenario.attach(listener);
+    soakOpts.durationS = durationS;
+    Soak soakRun(controllerUrl, soakOpts);
+    if (soak) soakRun.attach(listener);
+    rectOpts.durationS = durationS;
+    RectStress rectRun(controllerUrl, rectOpts);
+    if (rectStress) rectRun.attach(listener);
+
+    // offline: no controller, only the captured frames
+    if (!replayFile.empty()) {
+        ReplayStats st;
+        std::string error;
+        if (!listener.replay(replayFile, replaySpeed, st, error)) { std::cerr << "Replay: " << error << "\n"; return 1; }
+        log_flush();
+        print_replay_stats(st);
+        print_dispatch_stats(listener.getDispatchStats());
+        return 0;
+    }
+
+    if (!captureFile.empty()) {
+        std::string error;
+        if (!listener.startCapture(captureFile, error)) { std::cerr << "Capture: " << error << "\n"; return 1; }
+    }
 
     if (!listener.start()) {
         std::cerr << "Failed to start event listener. Exiting.\n";
@@ -106,48 +650,144 @@ int main(int argc, char **argv) {
         std::cout << "Event listener started.\n";
     }
 
+    if (!daemonSocket.empty()) {
+        Daemon daemon(controllerUrl, listener);
+        daemon.setStateCache(&state);
+        state.startReconciler(stateSyncS);
+        std::string error;
+        if (!daemon.start(daemonSocket, error)) {
+            std::cerr << "Daemon: " << error << "\n";
+            listener.stop();
+            return 1;
+        }
+        std::cout << "Serving " << daemonSocket << "\n";
+        std::signal(SIGINT, stop_daemon);
+        std::signal(SIGTERM, stop_daemon);
+        while (!daemonInterrupted && !daemon.shutdownRequested()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        daemon.stop();
+        listener.stop();
+        if (!acceptLog.empty() && !acceptor.writeRecordsCsv(acceptLog)) std::cerr << "Cannot write " << acceptLog << "\n";
+        if (!statsOut.empty() && !tracker.writeFile(statsOut)) std::cerr << "Cannot write " << statsOut << "\n";
+        return 0;
+    }
+
+    if (soak) {
+        if (soakOpts.client.empty() && !listener.waitConnected(5000)) std::cerr << "[soak] event WebSocket not connected, waits may time out\n";
+        if (fleetOpts.bringUp && !bring_up(controllerUrl)) std::cerr << "[soak] bring-up failed, continuing\n";
+        runningSoak = &soakRun;
+        std::signal(SIGINT, stop_soak);
+        std::signal(SIGTERM, stop_soak);
+        std::string error;
+        bool ok = soakRun.run(error);
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        runningSoak = nullptr;
+        log_flush();
+        if (!error.empty()) std::cerr << "Soak: " << error << "\n";
+        soakRun.printReport(std::cout);
+        write_report(reportFile, soakRun.report());
+        listener.stop();
+        if (!statsOut.empty() && !tracker.writeFile(statsOut)) std::cerr << "Cannot write " << statsOut << "\n";
+        return ok && !soakRun.trendsFlagged() ? 0 : 1;
+    }
+
+    if (rectStress) {
+        if (!listener.waitConnected(5000)) std::cerr << "[rect] event WebSocket not connected, state events will be missing\n";
+        runningRect = &rectRun;
+        std::signal(SIGINT, stop_rect);
+        std::signal(SIGTERM, stop_rect);
+        std::string error;
+        bool ok = rectRun.run(error);
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        runningRect = nullptr;
+        log_flush();
+        if (!error.empty()) std::cerr << "Rect stress: " << error << "\n";
+        rectRun.printReport(std::cout);
+        write_report(reportFile, rectRun.report());
+        listener.stop();
+        if (!statsOut.empty() && !tracker.writeFile(statsOut)) std::cerr << "Cannot write " << statsOut << "\n";
+        return ok && rectRun.report()["dropped"].asUInt64() == 0 ? 0 : 1;
+    }
+
+    if (!scenarioFile.empty()) {
+        if (!listener.waitConnected(5000)) std::cerr << "[scenario] event WebSocket not connected, waits may time out\n";
+        runningScenario = &scenario;
+        std::signal(SIGINT, stop_scenario);
+        std::signal(SIGTERM, stop_scenario);
+        bool passed = scenario.run(controllerUrl);
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        runningScenario = nullptr;
+        log_flush();
+        scenario.printReport(std::cout);
+        write_report(reportFile, scenario.report());
+        listener.stop();
+        if (!acceptLog.empty() && !acceptor.writeRecordsCsv(acceptLog)) std::cerr << "Cannot write " << acceptLog << "\n";
+        if (!statsOut.empty() && !tracker.writeFile(statsOut)) std::cerr << "Cannot write " << statsOut << "\n";
+        return passed ? 0 : 1;
+    }
+
+    state.startReconciler(stateSyncS);
+    CommandRunner runner(controllerUrl);
     std::string line;
+    bool quit = false;
     while (true) {
-        std::cout << "> " << std::flush;
+        std::cout << std::flush;
+        log_prompt(true);
         if (!std::getline(std::cin, line)) break;
+        log_prompt(false);
         auto tokens = split_tokens(line);
         if (tokens.empty()) continue;
+        long timeoutMs = rpcTimeoutMs;
+        if (!take_timeout(tokens, timeoutMs)) { std::cerr << "Invalid timeout\n"; continue; }
         std::string cmd = tokens[0];
 
         if (cmd == "help") {
             print_help();
         } else if (cmd == "1" || cmd == "activate_service") {
-            if (!activate_service(controllerUrl)) std::cerr << "activate_service failed\n";
+            runner.submit("activate_service", {{"Controller.activate", callsign_params("org.rdk.MiracastService")}}, timeoutMs);
         } else if (cmd == "deactivate_service") {
-            if (!deactivate_service(controllerUrl)) std::cerr << "deactivate_service failed\n";
+            runner.submit("deactivate_service", {{"Controller.deactivate", callsign_params("org.rdk.MiracastService")}}, timeoutMs);
         } else if (cmd == "2" || cmd == "activate_player") {
-            if (!activate_player(controllerUrl)) std::cerr << "activate_player failed\n";
+            runner.submit("activate_player", {{"Controller.activate", callsign_params("org.rdk.MiracastPlayer")}}, timeoutMs);
         } else if (cmd == "deactivate_player") {
-            if (!deactivate_player(controllerUrl)) std::cerr << "deactivate_player failed\n";
+            runner.submit("deactivate_player", {{"Controller.deactivate", callsign_params("org.rdk.MiracastPlayer")}}, timeoutMs);
         } else if (cmd == "3" || cmd == "set_enable") {
              /*if (tokens.size() != 2) { std::cerr << "Usage: set_enable true|false\n"; continue; }
             std::string v = tokens[1]; std::transform(v.begin(), v.end(), v.begin(), ::tolower);*/
             std::string v = "1";
             bool val = (v == "true" || v == "1");
-            if (!set_enable(controllerUrl, val)) std::cerr << "set_enable failed\n";
+            runner.submit("set_enable", {{"org.rdk.MiracastService.setEnable", enable_params(val)}}, timeoutMs);
         } else if (cmd == "get_enable") {
-            bool enabled;
-            if (!get_enable(controllerUrl, enabled)) std::cerr << "get_enable failed\n";
-            else std::cout << "enabled = " << (enabled ? "true" : "false") << "\n";
-        } else if (cmd == "4" || cmd == "accept") {
-            std::lock_guard<std::mutex> g(last_mutex);
-            if (last_mac.empty()) { std::cerr << "No client known from events. Wait for onClientConnectionRequest.\n"; }
-            else {
-                if (!accept_client_connection(controllerUrl, "Accept")) std::cerr << "accept failed\n";
-                else std::cout << "Sent Accept for " << last_mac << " / " << last_name << "\n";
-            }
-        } else if (cmd == "reject") {
-            std::lock_guard<std::mutex> g(last_mutex);
-            if (last_mac.empty()) { std::cerr << "No client known from events.\n"; }
-            else {
-                if (!accept_client_connection(controllerUrl, "Reject")) std::cerr << "reject failed\n";
-                else std::cout << "Sent Reject for " << last_mac << " / " << last_name << "\n";
+            auto st = state.snapshot();
+            bool fresh = tokens.size() > 1 && tokens[1] == "fresh";
+            if (!fresh && st->enabled.known && !st->stale) {
+                std::cout << "enabled = " << (st->enabled.value ? "true" : "false") << " (cached)\n";
+                continue;
             }
+            runner.submit("get_enable", {{"org.rdk.MiracastService.getEnable", Json::Value(Json::objectValue)}}, timeoutMs,
+                          [](const Json::Value &resp) {
+                const Json::Value &result = resp["result"];
+                const Json::Value &r = (result.isArray() && result.size() > 0) ? result[0] : result;
+                if (!r.isObject() || !r["enabled"].isBool()) return std::string("no enabled field in result");
+                return std::string("enabled = ") + (r["enabled"].asBool() ? "true" : "false");
+            });
+        } else if (cmd == "4" || cmd == "accept" || cmd == "reject") {
+            auto st = state.snapshot();
+            auto known = st->clients.find(st->lastClient);
+            if (known == st->clients.end()) { std::cerr << "No client known from events. Wait for onClientConnectionRequest.\n"; continue; }
+            std::string status = (cmd == "reject") ? "Reject" : "Accept";
+            Json::Value params;
+            params["requestStatus"] = status;
+            runner.submit(status == "Accept" ? "accept" : "reject", {{"org.rdk.MiracastService.acceptClientConnection", params}},
+                          timeoutMs, [status, client = known->second](const Json::Value &) {
+                return "Sent " + status + " for " + client.mac + " / " + client.name;
+            });
         } else if (cmd == "play") {
             if (tokens.size() < 9) { std::cerr << "Usage: play <source_ip> <source_mac> <source_name> <sink_ip> <X> <Y> <W> <H>\n"; continue; }
             DeviceParameters dp; dp.source_dev_ip = tokens[1]; dp.source_dev_mac = tokens[2];
@@ -155,27 +795,187 @@ int main(int argc, char **argv) {
             VideoRectangle rect;
             try { rect.X = std::stoi(tokens[5]); rect.Y = std::stoi(tokens[6]); rect.W = std::stoi(tokens[7]); rect.H = std::stoi(tokens[8]); }
             catch(...) { std::cerr << "Invalid numbers\n"; continue; }
-            if (!player_play_request(controllerUrl, dp, rect)) std::cerr << "playRequest failed\n";
-            else std::cout << "playRequest sent\n";
+            runner.submit("play", {{"org.rdk.MiracastPlayer.playRequest", play_request_params(dp, rect)}}, timeoutMs);
+        } else if (cmd == "rect") {
+            if (tokens.size() != 5) { std::cerr << "Usage: rect <X> <Y> <W> <H>\n"; continue; }
+            VideoRectangle rect;
+            try { rect.X = std::stoi(tokens[1]); rect.Y = std::stoi(tokens[2]); rect.W = std::stoi(tokens[3]); rect.H = std::stoi(tokens[4]); }
+            catch(...) { std::cerr << "Invalid numbers\n"; continue; }
+            runner.submit("rect", {{"org.rdk.MiracastPlayer.setVideoRectangle", video_rectangle_params(rect)}}, timeoutMs);
         } else if (cmd == "stop") {
             if (tokens.size() != 4) { std::cerr << "Usage: stop <mac> <name> <reason_code>\n"; continue; }
-            if (!player_stop_request(controllerUrl, tokens[1], tokens[2], std::stoi(tokens[3]))) std::cerr << "stopRequest failed\n";
+            Json::Value params;
+            params["mac"] = tokens[1];
+            params["name"] = tokens[2];
+            try { params["reason_code"] = std::stoi(tokens[3]); } catch(...) { std::cerr << "Invalid reason_code\n"; continue; }
+            runner.submit("stop", {{"org.rdk.MiracastPlayer.stopRequest", params}}, timeoutMs);
         } else if (cmd == "update") {
             if (tokens.size() < 5) { std::cerr << "Usage: update <mac> <state> <reason_code> <reason...>\n"; continue; }
             std::string mac = tokens[1]; std::string state = tokens[2]; int reason_code = 0;
             try { reason_code = std::stoi(tokens[3]); } catch(...) {}
             std::string reason;
             for (size_t i=4;i<tokens.size();++i) { if (i>4) reason += " "; reason += tokens[i]; }
-            if (!update_player_state(controllerUrl, mac, state, reason_code, reason)) std::cerr << "update failed\n";
+            runner.submit("update", {{"org.rdk.MiracastService.updatePlayerState", player_state_params(mac, state, reason_code, reason)}}, timeoutMs);
+        } else if (cmd == "jobs") {
+            print_jobs(runner);
+        } else if (cmd == "cancel") {
+            if (tokens.size() != 2) { std::cerr << "Usage: cancel <id>|all\n"; continue; }
+            if (tokens[1] == "all") {
+                std::cout << "cancelling " << runner.cancelAll() << " commands\n";
+                continue;
+            }
+            int id = 0;
+            try { id = std::stoi(tokens[1]); } catch(...) {}
+            if (!runner.cancel(id)) std::cerr << "No running command #" << tokens[1] << "\n";
+        } else if (cmd == "wait") {
+            int id = 0;
+            try { if (tokens.size() > 1) id = std::stoi(tokens[1]); } catch(...) { std::cerr << "Usage: wait [id]\n"; continue; }
+            runner.wait(id);
+        } else if (cmd == "timeout") {
+            long ms = 0;
+            try { if (tokens.size() == 2) ms = std::stol(tokens[1]); } catch(...) {}
+            if (ms <= 0) { std::cerr << "Usage: timeout <ms>\n"; continue; }
+            rpcTimeoutMs = ms;
+        } else if (cmd == "timing") {
+            int id = 0;
+            try { if (tokens.size() > 1) id = std::stoi(tokens[1]); } catch(...) { std::cerr << "Usage: timing [id]\n"; continue; }
+            RpcTiming t;
+            if (!runner.timing(id, t)) { std::cerr << (id ? "No timing for that command\n" : "No finished command\n"); continue; }
+            std::cout << "dns=" << t.dns_us << "us connect=" << t.connect_us << "us ttfb=" << t.ttfb_us
+                      << "us total=" << t.total_us << "us connection=" << (t.reused ? "reused" : "new") << "\n";
+        } else if (cmd == "transport") {
+            if (tokens.size() != 2 || (tokens[1] != "ws" && tokens[1] != "http")) { std::cerr << "Usage: transport ws|http\n"; continue; }
+            if (tokens[1] == "ws") {
+                if (!listener.waitConnected(3000)) { std::cerr << "Event WebSocket not connected\n"; continue; }
+                set_rpc_event_channel(&listener);
+            } else {
+                set_rpc_event_channel(nullptr);
+            }
+            std::cout << "RPC transport: " << tokens[1] << "\n";
+        } else if (cmd == "bringup" || cmd == "teardown") {
+            if (tokens.size() == 1) {
+                runner.submit(cmd, bring_up_calls(cmd == "bringup"), timeoutMs);
+                continue;
+            }
+            BatchMode mode = BatchMode::Batch;
+            if (tokens[1] == "pipeline") mode = BatchMode::Pipeline;
+            else if (tokens[1] != "batch") { std::cerr << "Usage: " << cmd << " [batch|pipeline]\n"; continue; }
+            bool ok = (cmd == "bringup") ? bring_up(controllerUrl, mode) : tear_down(controllerUrl, mode);
+            if (!ok) std::cerr << cmd << " failed\n";
+        } else if (cmd == "capture") {
+            if (tokens.size() != 2) { std::cerr << "Usage: capture <file>|off\n"; continue; }
+            if (tokens[1] == "off") {
+                listener.stopCapture();
+            } else {
+                std::string error;
+                if (!listener.startCapture(tokens[1], error)) std::cerr << "Capture: " << error << "\n";
+            }
+        } else if (cmd == "replay") {
+            if (tokens.size() < 2 || tokens.size() > 3) { std::cerr << "Usage: replay <file> [speed]\n"; continue; }
+            double speed = 1.0;
+            try {
+                if (tokens.size() == 3) speed = std::stod(tokens[2]);
+            } catch (...) { std::cerr << "Invalid speed\n"; continue; }
+            ReplayStats st;
+            std::string error;
+            // recorded requests must not be answered on the live device
+            bool wasAuto = acceptor.isEnabled();
+            acceptor.setEnabled(false);
+            bool ok = listener.replay(tokens[1], speed, st, error);
+            acceptor.setEnabled(wasAuto);
+            log_flush();
+            if (!ok) std::cerr << "Replay: " << error << "\n";
+            else print_replay_stats(st);
+        } else if (cmd == "evstats") {
+            print_dispatch_stats(listener.getDispatchStats());
+        } else if (cmd == "conn") {
+            ConnectionStats st = listener.getConnectionStats();
+            std::cout << "connected=" << (st.connected ? "yes" : "no") << " connects=" << st.connects
+                      << " reconnects=" << st.reconnects << " last_gap=" << st.lastGapUs / 1000 << "ms max_gap="
+                      << st.maxGapUs / 1000 << "ms total_gap=" << st.totalGapUs / 1000 << "ms";
+            if (!st.connected) std::cout << " current_gap=" << st.currentGapUs / 1000 << "ms";
+            const HandshakeTiming &h = st.lastHandshake;
+            std::cout << "\nhandshake tcp=" << h.tcpUs / 1000.0 << "ms";
+            if (st.secure) std::cout << " tls=" << h.tlsUs / 1000.0 << "ms";
+            std::cout << " ws=" << h.wsUs / 1000.0 << "ms total=" << h.totalUs / 1000.0 << "ms deflate=" << (st.deflate ? "yes" : "no");
+            if (st.secure) {
+                std::cout << " tls_full=" << st.tlsFull << " (avg " << st.tlsFullAvgUs / 1000.0 << "ms) tls_resumed="
+                          << st.tlsResumed << " (avg " << st.tlsResumedAvgUs / 1000.0 << "ms)";
+            }
+            std::cout << "\n";
+        } else if (cmd == "events") {
+            if (tokens.size() != 2 || (tokens[1] != "on" && tokens[1] != "off")) { std::cerr << "Usage: events on|off\n"; continue; }
+            if (tokens[1] == "on") listener.setNotificationCallback(print_all_events);
+            else listener.setNotificationCallback(nullptr);
+        } else if (cmd == "auto") {
+            handle_auto_command(acceptor, tokens);
+        } else if (cmd == "stats") {
+            std::string fmt = tokens.size() > 1 ? tokens[1] : "json";
+            if (fmt != "json" && fmt != "prom") { std::cerr << "Usage: stats [json|prom] [file]\n"; continue; }
+            std::string text;
+            if (fmt == "prom") {
+                text = tracker.toPrometheus();
+            } else {
+                text = pretty_json(tracker.toJson()) + "\n";
+            }
+            if (tokens.size() > 2) {
+                std::ofstream out(tokens[2]);
+                if (!(out << text)) std::cerr << "Cannot write " << tokens[2] << "\n";
+            } else {
+                std::cout << text;
+            }
+        } else if (cmd == "state") {
+            std::string sub = tokens.size() > 1 ? tokens[1] : "";
+            if (sub == "sync") {
+                if (!state.reconcile()) std::cerr << "Reconcile failed\n";
+            } else if (sub == "json") {
+                std::cout << pretty_json(state.toJson()) << "\n";
+                continue;
+            } else if (!sub.empty()) {
+                std::cerr << "Usage: state [json|sync]\n";
+                continue;
+            }
+            auto st = state.snapshot();
+            auto known = [](const KnownBool &k, const char *yes, const char *no) { return k.known ? (k.value ? yes : no) : "?"; };
+            std::cout << "service=" << known(st->serviceActive, "active", "inactive")
+                      << " player=" << known(st->playerActive, "active", "inactive")
+                      << " enabled=" << known(st->enabled, "true", "false") << " version=" << st->version
+                      << (st->stale ? " (stale)" : "") << "\n";
+            for (const auto &kv : st->clients) {
+                const ClientState &c = kv.second;
+                std::cout << "  " << (kv.first == st->lastClient ? "* " : "  ") << c.mac << " " << c.name << " phase=" << c.phase
+                          << " player=" << (c.playerState.empty() ? "-" : c.playerState)
+                          << (c.reason.empty() ? "" : " reason=" + c.reason) << "\n";
+            }
+        } else if (cmd == "log") {
+            LogLevel level;
+            if (tokens.size() == 3 && tokens[1] == "level" && parse_log_level(tokens[2], level)) {
+                log_set_level(level);
+            } else if (tokens.size() == 2 && tokens[1] == "stats") {
+                LogStats st = log_stats();
+                std::cout << "log level=" << log_level_name(log_level()) << " written=" << st.written
+                          << " dropped=" << st.dropped << " threads=" << st.threads << "\n";
+            } else {
+                std::cerr << "Usage: log level error|warn|info|debug|trace | log stats\n";
+            }
         } else if (cmd == "5" || cmd == "quit" || cmd == "exit") {
+            quit = true;
             break;
         } else {
             std::cerr << "Unknown command\n";
         }
     }
 
+    // end of piped input: let running commands finish; quit abandons them
+    if (quit) runner.cancelAll();
+    runner.wait(0);
+    log_prompt(false);
+    log_flush();
     std::cout << "Shutting down event listener...\n";
+    set_rpc_event_channel(nullptr);
     listener.stop();
+    if (!acceptLog.empty() && !acceptor.writeRecordsCsv(acceptLog)) std::cerr << "Cannot write " << acceptLog << "\n";
+    if (!statsOut.empty() && !tracker.writeFile(statsOut)) std::cerr << "Cannot write " << statsOut << "\n";
     std::cout << "Exit\n";
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+// Auto-accept path: connection requests replayed through the listener, answered by AutoAcceptor
+// against a local JSON-RPC stub, with SessionTracker and StateCache attached the way main does.
+#include <gtest/gtest.h>
+#include "AutoAccept.h"
+#include "EventListener.h"
+#include "EventLog.h"
+#include "Miracast.h"
+#include "SessionTracker.h"
+#include "StateCache.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// HTTP/1.1 keep-alive JSON-RPC endpoint: answers every request with an empty result
+class RpcStub {
+public:
+    RpcStub() {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(a);
+        if (fd < 0 || bind(fd, (sockaddr *)&a, len) != 0 || listen(fd, 16) != 0 || getsockname(fd, (sockaddr *)&a, &len) != 0) return;
+        port = ntohs(a.sin_port);
+        acceptor = std::thread([this]{ serve(); });
+    }
+    ~RpcStub() {
+        stopping = true;
+        shutdown(fd, SHUT_RDWR);
+        close(fd);
+        if (acceptor.joinable()) acceptor.join();
+        std::lock_guard<std::mutex> g(mtx);
+        for (int c : conns) shutdown(c, SHUT_RDWR);
+        for (auto &t : workers) t.join();
+        for (int c : conns) close(c);
+    }
+
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(port) + "/jsonrpc"; }
+    uint16_t port = 0;
+
+private:
+    void serve() {
+        while (!stopping) {
+            int c = accept(fd, nullptr, nullptr);
+            if (c < 0) return;
+            std::lock_guard<std::mutex> g(mtx);
+            conns.push_back(c);
+            workers.emplace_back([this, c]{ session(c); });
+        }
+    }
+
+    void session(int c) {
+        std::string in;
+        char buf[4096];
+        while (true) {
+            size_t end = in.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                ssize_t n = read(c, buf, sizeof(buf));
+                if (n <= 0) return;
+                in.append(buf, (size_t)n);
+                continue;
+            }
+            size_t cl = in.find("Content-Length:");
+            if (cl == std::string::npos || cl > end) cl = in.find("content-length:");
+            size_t bodyLen = (cl != std::string::npos && cl < end) ? std::stoul(in.substr(cl + 15)) : 0;
+            while (in.size() < end + 4 + bodyLen) {
+                ssize_t n = read(c, buf, sizeof(buf));
+                if (n <= 0) return;
+                in.append(buf, (size_t)n);
+            }
+            in.erase(0, end + 4 + bodyLen);
+            std::string body = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":null}";
+            std::string resp = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\n\r\n" + body;
+            if (write(c, resp.data(), resp.size()) != (ssize_t)resp.size()) return;
+        }
+    }
+
+    int fd = -1;
+    std::atomic<bool> stopping{false};
+    std::thread acceptor;
+    std::mutex mtx;
+    std::vector<int> conns;
+    std::vector<std::thread> workers;
+};
+
+static std::string request_frame(const std::string &mac, const std::string &name) {
+    return "{\"jsonrpc\":\"2.0\",\"method\":\"org.rdk.MiracastService.onClientConnectionRequest\",\"params\":{\"mac\":\"" + mac +
+           "\",\"name\":\"" + name + "\"}}";
+}
+
+// three requests 150 ms apart, each answered before the next arrives
+static bool write_requests(const std::string &path, const std::vector<std::string> &macs) {
+    EventLogWriter w;
+    std::string error;
+    if (!w.open(path, error)) return false;
+    for (size_t i = 0; i < macs.size(); ++i) {
+        std::string f = request_frame(macs[i], "Source-" + std::to_string(i));
+        if (!w.append((uint64_t)i * 150000000ull, f.data(), f.size())) return false;
+    }
+    return true;
+}
+
+TEST(AutoAccept, AcceptsAreChargedToTheirOwnRequest) {
+    RpcStub rpc;
+    ASSERT_NE(rpc.port, 0);
+    char path[] = "/tmp/mcasttest-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    unlink(path);
+    std::vector<std::string> macs = {"02:00:00:00:00:01", "02:00:00:00:00:02", "02:00:00:00:00:03"};
+    ASSERT_TRUE(write_requests(path, macs));
+
+    EventListener listener("ws://127.0.0.1:9/jsonrpc");
+    SessionTracker tracker(rpc.url());
+    AutoAcceptor acceptor(rpc.url(), AutoAcceptRules());
+    StateCache state(rpc.url());
+    // main's order: everything that records the request before the acceptor answers it
+    tracker.attach(listener);
+    state.attach(listener);
+    acceptor.attach(listener);
+    acceptor.setEnabled(true);
+
+    ReplayStats st;
+    std::string error;
+    ASSERT_TRUE(listener.replay(path, 1.0, st, error)) << error;
+    unlink(path);
+    EXPECT_EQ(st.frames, macs.size());
+
+    // the last answer may still be in flight
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (acceptor.getStats().accepted + acceptor.getStats().failed < macs.size() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    AutoAcceptStats stats = acceptor.getStats();
+    EXPECT_EQ(stats.accepted, macs.size());
+    EXPECT_EQ(stats.failed, 0u);
+
+    auto snap = state.snapshot();
+    EXPECT_TRUE(snap->pendingClient.empty());
+    for (const auto &mac : macs) {
+        auto it = snap->clients.find(mac);
+        ASSERT_NE(it, snap->clients.end()) << mac;
+        EXPECT_EQ(it->second.phase, "accepted") << mac;
+    }
+
+    const LatencyHistogram *toAccept = tracker.phase("request_to_accept");
+    ASSERT_NE(toAccept, nullptr);
+    EXPECT_EQ(toAccept->count(), macs.size());
+}
+
+TEST(AutoAccept, AnswerWithoutPendingRequestIsIgnored) {
+    RpcStub rpc;
+    ASSERT_NE(rpc.port, 0);
+    char path[] = "/tmp/mcasttest-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    unlink(path);
+    ASSERT_TRUE(write_requests(path, {"02:00:00:00:00:01"}));
+
+    EventListener listener("ws://127.0.0.1:9/jsonrpc");
+    SessionTracker tracker(rpc.url());
+    AutoAcceptor acceptor(rpc.url(), AutoAcceptRules());
+    StateCache state(rpc.url());
+    tracker.attach(listener);
+    state.attach(listener);
+    acceptor.attach(listener);
+    acceptor.setEnabled(true);
+
+    ReplayStats st;
+    std::string error;
+    ASSERT_TRUE(listener.replay(path, 0, st, error)) << error;
+    unlink(path);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (acceptor.getStats().accepted < 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // a second, manual answer: nothing is pending, so no client changes and no latency is recorded
+    Json::Value params;
+    params["requestStatus"] = "Reject";
+    Json::Value resp;
+    EXPECT_TRUE(json_rpc_call(rpc.url(), "org.rdk.MiracastService.acceptClientConnection", params, resp));
+    auto snap = state.snapshot();
+    EXPECT_EQ(snap->clients.at("02:00:00:00:00:01").phase, "accepted");
+    EXPECT_EQ(tracker.phase("request_to_accept")->count(), 1u);
+}
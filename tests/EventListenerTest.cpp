@@ -0,0 +1,51 @@
+// Dispatch pipeline, driven through replay() so no Thunder is needed.
+#include <gtest/gtest.h>
+#include "EventListener.h"
+#include "EventLog.h"
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+static std::string write_frames(unsigned n) {
+    char path[] = "/tmp/mcasttest-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return "";
+    close(fd);
+    EventLogWriter w;
+    std::string error;
+    if (!w.open(path, error)) return "";
+    std::string f = "{\"jsonrpc\":\"2.0\",\"method\":\"org.rdk.MiracastPlayer.onStateChange\",\"params\":{\"state\":\"PLAYING\"}}";
+    for (unsigned i = 0; i < n; ++i) {
+        if (!w.append((uint64_t)i, f.data(), f.size())) return "";
+    }
+    return path;
+}
+
+TEST(EventListener, ThrowingHandlerIsCountedAndDispatchGoesOn) {
+    std::string path = write_frames(4);
+    ASSERT_FALSE(path.empty());
+    EventListener listener("ws://127.0.0.1:9/jsonrpc");
+    std::atomic<unsigned> calls(0), seen(0);
+    listener.addEventHandler("org.rdk.MiracastPlayer", "onStateChange", [&](const Json::Value &params, EventTime) {
+        ++calls;
+        params["state"].asInt();  // a string: jsoncpp throws
+    });
+    listener.setNotificationCallback([&](const Json::Value&) {
+        ++seen;
+        throw std::runtime_error("catch-all");
+    });
+
+    ReplayStats st;
+    std::string error;
+    ASSERT_TRUE(listener.replay(path, 0, st, error)) << error;
+    // the listener is still usable afterwards
+    ASSERT_TRUE(listener.replay(path, 0, st, error)) << error;
+    unlink(path.c_str());
+
+    EXPECT_EQ(calls.load(), 8u);
+    EXPECT_EQ(seen.load(), 8u);
+    DispatchStats d = listener.getDispatchStats();
+    EXPECT_EQ(d.handlerErrors, 16u);
+    EXPECT_EQ(d.dispatched, 8u);
+}